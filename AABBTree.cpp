@@ -0,0 +1,409 @@
+#include "AABBTree.h"
+#include <algorithm>
+
+int AABBTree::allocateNode()
+{
+    int nodeIdx;
+    if (!m_freeNodes.empty())
+    {
+        nodeIdx = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    }
+    else
+    {
+        nodeIdx = m_nodes.size();
+        m_nodes.emplace_back();
+    }
+    m_nodes[nodeIdx] = node{};
+    m_nodes[nodeIdx].height = 0;
+    return nodeIdx;
+}
+
+void AABBTree::freeNode(int nodeIdx)
+{
+    m_nodes[nodeIdx].height = -1;
+    m_freeNodes.push_back(nodeIdx);
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+    if (m_root == NULL_NODE)
+    {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // find the best sibling: go down where the surface area grows the least
+    COLLISION::aabb leafBox{m_nodes[leaf].box};
+    int index{m_root};
+    while (!m_nodes[index].isLeaf())
+    {
+        const node& current = m_nodes[index];
+        float area = COLLISION::perimeter(current.box);
+        float combinedArea = COLLISION::perimeter(COLLISION::merge(current.box, leafBox));
+
+        // cost of a new parent for this node and the leaf
+        float cost = 2.f * combinedArea;
+        // the minimum cost of pushing the leaf further down, every parent grows with it
+        float inheritanceCost = 2.f * (combinedArea - area);
+
+        auto childCost = [&](int child)
+        {
+            const node& c = m_nodes[child];
+            float merged = COLLISION::perimeter(COLLISION::merge(c.box, leafBox));
+            if (c.isLeaf())
+                return merged + inheritanceCost;
+            return merged - COLLISION::perimeter(c.box) + inheritanceCost;
+        };
+        float cost1 = childCost(current.child1);
+        float cost2 = childCost(current.child2);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+        index = (cost1 < cost2) ? current.child1 : current.child2;
+    }
+
+    int sibling{index};
+    int oldParent{m_nodes[sibling].parent};
+    int newParent{allocateNode()};
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].box = COLLISION::merge(leafBox, m_nodes[sibling].box);
+    m_nodes[newParent].height = m_nodes[sibling].height + 1;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent != NULL_NODE)
+    {
+        if (m_nodes[oldParent].child1 == sibling)
+            m_nodes[oldParent].child1 = newParent;
+        else
+            m_nodes[oldParent].child2 = newParent;
+    }
+    else
+    {
+        m_root = newParent;
+    }
+
+    refitUpwards(m_nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+    if (leaf == m_root)
+    {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    int parent{m_nodes[leaf].parent};
+    int grandParent{m_nodes[parent].parent};
+    int sibling{m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1};
+
+    // the sibling takes the place of the parent
+    if (grandParent != NULL_NODE)
+    {
+        if (m_nodes[grandParent].child1 == parent)
+            m_nodes[grandParent].child1 = sibling;
+        else
+            m_nodes[grandParent].child2 = sibling;
+        m_nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitUpwards(grandParent);
+    }
+    else
+    {
+        m_root = sibling;
+        m_nodes[sibling].parent = NULL_NODE;
+        freeNode(parent);
+    }
+}
+
+void AABBTree::refitUpwards(int nodeIdx)
+{
+    while (nodeIdx != NULL_NODE)
+    {
+        nodeIdx = balance(nodeIdx);
+        node& current = m_nodes[nodeIdx];
+        const node& child1 = m_nodes[current.child1];
+        const node& child2 = m_nodes[current.child2];
+        current.height = 1 + std::max(child1.height, child2.height);
+        current.box = COLLISION::merge(child1.box, child2.box);
+        nodeIdx = current.parent;
+    }
+}
+
+int AABBTree::balance(int iA)
+{
+    // the same rotations as in an AVL tree: a child that is more than one level higher is rotated up
+    node& A = m_nodes[iA];
+    if (A.isLeaf() || A.height < 2)
+        return iA;
+
+    int iB{A.child1};
+    int iC{A.child2};
+    node& B = m_nodes[iB];
+    node& C = m_nodes[iC];
+    int diff{C.height - B.height};
+
+    // rotate C up
+    if (diff > 1)
+    {
+        int iF{C.child1};
+        int iG{C.child2};
+        node& F = m_nodes[iF];
+        node& G = m_nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+        if (C.parent != NULL_NODE)
+        {
+            if (m_nodes[C.parent].child1 == iA)
+                m_nodes[C.parent].child1 = iC;
+            else
+                m_nodes[C.parent].child2 = iC;
+        }
+        else
+        {
+            m_root = iC;
+        }
+
+        // the higher grandchild stays under C, the other one goes to A
+        if (F.height > G.height)
+        {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.box = COLLISION::merge(B.box, G.box);
+            C.box = COLLISION::merge(A.box, F.box);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }
+        else
+        {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.box = COLLISION::merge(B.box, F.box);
+            C.box = COLLISION::merge(A.box, G.box);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+        return iC;
+    }
+
+    // rotate B up
+    if (diff < -1)
+    {
+        int iD{B.child1};
+        int iE{B.child2};
+        node& D = m_nodes[iD];
+        node& E = m_nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+        if (B.parent != NULL_NODE)
+        {
+            if (m_nodes[B.parent].child1 == iA)
+                m_nodes[B.parent].child1 = iB;
+            else
+                m_nodes[B.parent].child2 = iB;
+        }
+        else
+        {
+            m_root = iB;
+        }
+
+        if (D.height > E.height)
+        {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.box = COLLISION::merge(C.box, E.box);
+            B.box = COLLISION::merge(A.box, D.box);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }
+        else
+        {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.box = COLLISION::merge(C.box, D.box);
+            B.box = COLLISION::merge(A.box, E.box);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+        return iB;
+    }
+
+    return iA;
+}
+
+void AABBTree::removeId(int leaf)
+{
+    removeLeaf(leaf);
+    m_idToLeaf.erase(m_nodes[leaf].id);
+    freeNode(leaf);
+}
+
+void AABBTree::update(size_t id, const COLLISION::aabb& box)
+{
+    auto it = m_idToLeaf.find(id);
+    if (it == m_idToLeaf.end())
+    {
+        int leaf{allocateNode()};
+        m_nodes[leaf].id = id;
+        m_nodes[leaf].tight = box;
+        m_nodes[leaf].box = COLLISION::expand(box, m_margin);
+        m_nodes[leaf].syncStamp = m_syncStamp;
+        m_idToLeaf.insert({id, leaf});
+        insertLeaf(leaf);
+        return;
+    }
+
+    int leaf{it->second};
+    m_nodes[leaf].tight = box;
+    m_nodes[leaf].syncStamp = m_syncStamp;
+
+    // still inside the fat box, and the fat box is not much bigger than needed (e.g. after a scale down): nothing to do
+    const COLLISION::aabb& fat = m_nodes[leaf].box;
+    if (COLLISION::contains(fat, box) && COLLISION::contains(COLLISION::expand(box, 4.f * m_margin), fat))
+        return;
+
+    removeLeaf(leaf);
+    m_nodes[leaf].box = COLLISION::expand(box, m_margin);
+    insertLeaf(leaf);
+}
+
+void AABBTree::remove(size_t id)
+{
+    auto it = m_idToLeaf.find(id);
+    if (it != m_idToLeaf.end())
+        removeId(it->second);
+}
+
+void AABBTree::removeStale()
+{
+    for (int i = 0; i < (int)m_nodes.size(); i++)
+    {
+        if (m_nodes[i].height == 0 && m_nodes[i].syncStamp != m_syncStamp)
+            removeId(i);
+    }
+    m_syncStamp++;
+}
+
+void AABBTree::clear()
+{
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_idToLeaf.clear();
+    m_root = NULL_NODE;
+}
+
+void AABBTree::query(const COLLISION::aabb& box, std::vector<size_t>& res)
+{
+    if (m_root == NULL_NODE)
+        return;
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty())
+    {
+        const node& current = m_nodes[m_stack.back()];
+        m_stack.pop_back();
+        if (!COLLISION::overlap(current.box, box))
+            continue;
+        if (current.isLeaf())
+        {
+            if (COLLISION::overlap(current.tight, box))
+                res.push_back(current.id);
+            continue;
+        }
+        m_stack.push_back(current.child1);
+        m_stack.push_back(current.child2);
+    }
+}
+
+void AABBTree::queryPoint(const MATH::Vec2& point, std::vector<size_t>& res)
+{
+    if (m_root == NULL_NODE)
+        return;
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty())
+    {
+        const node& current = m_nodes[m_stack.back()];
+        m_stack.pop_back();
+        if (!COLLISION::pointInside(point, current.box))
+            continue;
+        if (current.isLeaf())
+        {
+            if (COLLISION::pointInside(point, current.tight))
+                res.push_back(current.id);
+            continue;
+        }
+        m_stack.push_back(current.child1);
+        m_stack.push_back(current.child2);
+    }
+}
+
+void AABBTree::raycast(const MATH::Vec2& from, const MATH::Vec2& to, std::vector<size_t>& res)
+{
+    if (m_root == NULL_NODE)
+        return;
+    MATH::Vec2 delta{to - from};
+    m_rayHits.clear();
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while (!m_stack.empty())
+    {
+        const node& current = m_nodes[m_stack.back()];
+        m_stack.pop_back();
+        float time;
+        if (!COLLISION::raycast(from, delta, current.box, time))
+            continue;
+        if (current.isLeaf())
+        {
+            if (COLLISION::raycast(from, delta, current.tight, time))
+                m_rayHits.push_back({time, current.id});
+            continue;
+        }
+        m_stack.push_back(current.child1);
+        m_stack.push_back(current.child2);
+    }
+
+    std::sort(m_rayHits.begin(), m_rayHits.end());
+    for (auto& hit: m_rayHits)
+        res.push_back(hit.second);
+}
+
+void AABBTree::findPairs(std::vector<idPair>& res)
+{
+    // every leaf queries the tree with its real box, the pair is added by the one with the smaller id
+    for (const auto& leaf: m_nodes)
+    {
+        if (leaf.height != 0)
+            continue;
+        m_stack.clear();
+        m_stack.push_back(m_root);
+        while (!m_stack.empty())
+        {
+            const node& current = m_nodes[m_stack.back()];
+            m_stack.pop_back();
+            if (!COLLISION::overlap(current.box, leaf.tight))
+                continue;
+            if (current.isLeaf())
+            {
+                if (current.id > leaf.id && COLLISION::overlap(current.tight, leaf.tight))
+                    res.push_back(idPair{leaf.id, current.id});
+                continue;
+            }
+            m_stack.push_back(current.child1);
+            m_stack.push_back(current.child2);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+/// used sources from the internet:
+/// https://box2d.org/files/ErinCatto_DynamicBVH_GDC2019.pdf
+/// https://github.com/erincatto/box2d/blob/main/src/collision/b2_dynamic_tree.cpp
+/// https://www.azurefromthetrenches.com/introductory-guide-to-aabb-tree-collision-detection/
+
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "Broadphase.h"
+
+// dynamic bounding volume tree, works with any mix of box sizes
+// the leaves store a fat box (the real box + margin), so an entity moving a bit does not change the tree
+// after an insert or remove the parents are refitted and rotated, so the height stays about log(n)
+class AABBTree: public Broadphase
+{
+private:
+    static constexpr int NULL_NODE{-1};
+
+    struct node
+    {
+        COLLISION::aabb box{}; // fat box for the leaves, the merged children for the inner nodes
+        COLLISION::aabb tight{}; // the real box, only for the leaves
+        size_t id{0};
+        int parent{NULL_NODE};
+        int child1{NULL_NODE};
+        int child2{NULL_NODE};
+        int height{-1}; // 0 for a leaf, -1 for a free node
+        uint32_t syncStamp{0};
+
+        bool isLeaf() const { return child1 == NULL_NODE; };
+    };
+
+    std::vector<node> m_nodes;
+    std::vector<int> m_freeNodes;
+    std::unordered_map<size_t, int> m_idToLeaf;
+    int m_root{NULL_NODE};
+    float m_margin{4.f};
+    uint32_t m_syncStamp{1};
+
+    std::vector<int> m_stack; // for the traversals, so they do not allocate every time
+    std::vector<std::pair<float, size_t>> m_rayHits;
+
+    int allocateNode();
+    void freeNode(int nodeIdx);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    void removeId(int leaf);
+    // refits the parents of the node up to the root and rotates where the children heights differ too much
+    void refitUpwards(int nodeIdx);
+    int balance(int nodeIdx);
+
+public:
+    AABBTree() {};
+    AABBTree(float margin): m_margin(margin) {};
+
+    void update(size_t id, const COLLISION::aabb& box) override;
+    void remove(size_t id) override;
+    void removeStale() override;
+    void clear() override;
+    int size() override { return m_idToLeaf.size(); };
+
+    void query(const COLLISION::aabb& box, std::vector<size_t>& res) override;
+    void queryPoint(const MATH::Vec2& point, std::vector<size_t>& res) override;
+    void raycast(const MATH::Vec2& from, const MATH::Vec2& to, std::vector<size_t>& res) override;
+    void findPairs(std::vector<idPair>& res) override;
+
+    int getHeight() { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; };
+
+};
+
+#endif
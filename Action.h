@@ -1,24 +1,58 @@
 #ifndef ACTION_H
 #define ACTION_H
 
-#include <string>
-#include <SDL.h>
+#include <cstdint>
+
+// the actions are small numbers instead of strings, the scenes can switch on them and the key tables are plain arrays
+namespace ACTION
+{
+    enum class id : uint8_t
+    {
+        NONE = 0,
+        UP,
+        DOWN,
+        LEFT,
+        RIGHT,
+        USE,
+        VOLUMEUP,
+        VOLUMEDOWN,
+        LEFTMOUSE,
+        RIGHTMOUSE,
+        MOUSECLICK,
+        MOUSEMOTION,
+        FINDPATH,
+        GENERATEMAZE,
+        BAKEDWALLS,
+        FOGOFWAR,
+        COUNT
+    };
+
+    enum class type : uint8_t
+    {
+        START = 0,
+        END
+    };
+}
 
 class Action
 {
 private:
-    const std::string m_name = "NONE";
-    const std::string m_type = "NONE";
-    const SDL_Event m_event;
+    ACTION::id m_name{ACTION::id::NONE};
+    ACTION::type m_type{ACTION::type::START};
+    int m_x{0}, m_y{0}; // mouse position, only for the mouse actions
+    uint64_t m_timestamp{0}; // performance counter ticks when the input happened
 
 public:
-    Action() = delete;
-    Action(const std::string& name, const std::string& type, SDL_Event& event): m_name(name), m_type(type), m_event(event) {};
+    Action() {};
+    Action(ACTION::id name, ACTION::type type, uint64_t timestamp, int x = 0, int y = 0): m_name(name), m_type(type), m_x(x), m_y(y), m_timestamp(timestamp) {};
 
-    const std::string& name() const { return m_name; };
-    const std::string& type() const { return m_type; };
-    const SDL_Event& event() const { return m_event; };
+    ACTION::id name() const { return m_name; };
+    ACTION::type type() const { return m_type; };
+    bool isStart() const { return m_type == ACTION::type::START; };
+    int x() const { return m_x; };
+    int y() const { return m_y; };
+    uint64_t timestamp() const { return m_timestamp; };
 
 };
 
-#endif
\ No newline at end of file
+#endif
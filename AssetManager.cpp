@@ -3,21 +3,26 @@
 #include "Animation.h"
 #include "VulkanRenderer.h"
 #include "Logger.h"
+#include "JobSystem.h"
+#include "TextureAtlas.h"
 
 #include <SDL.h>
 #include <SDL_image.h>
 #include <iostream>
+#include <algorithm>
 
 AssetManager::AssetManager(GameEngine* ge)
 {
     m_ge = ge;
 
     // hardcode the assets we are going to load and stuff
-    AddTexture("steam", "textures/steam_logo.png");
-    AddTexture("plane", "textures/red_plane.png");
-    AddTexture("brick", "textures/brick_bg.png");
-    AddTexture("startButton", "textures/start_button.png");
-    AddTexture("exitButton", "textures/exit_button.png");
+    AddTextures({
+        {"steam", "textures/steam_logo.png"},
+        {"plane", "textures/red_plane.png"},
+        {"brick", "textures/brick_bg.png"},
+        {"startButton", "textures/start_button.png"},
+        {"exitButton", "textures/exit_button.png"}
+    });
 
     // and animations
     AddAnimation("walkDown", 150, std::vector<std::pair<int,int>>{std::pair{0, 0}, std::pair{0, 1}, std::pair{0, 2}, std::pair{0, 3}});
@@ -79,32 +84,178 @@ AssetManager::~AssetManager()
         val = nullptr;
     }
     m_fonts.clear();
-    for (auto& [key, val]: m_vertexBuffers)
+    for (auto& val: m_vertexBuffers)
     {
-        m_ge->vulkanRenderer()->freeBuffer(val.buffer, val.bufferMemory);
+        if (val.buffer != VK_NULL_HANDLE)
+            m_ge->vulkanRenderer()->freeBuffer(val.buffer, val.bufferMemory);
     }
     m_vertexBuffers.clear();
-    for (auto& [key, val]: m_indexBuffers)
+    m_vertexBufferHandles.clear();
+    for (auto& val: m_indexBuffers)
     {
-        m_ge->vulkanRenderer()->freeBuffer(val.buffer, val.bufferMemory);
+        if (val.buffer != VK_NULL_HANDLE)
+            m_ge->vulkanRenderer()->freeBuffer(val.buffer, val.bufferMemory);
     }
     m_indexBuffers.clear();
-    for (auto& [key, val]: m_vulkanTextures)
+    m_indexBufferHandles.clear();
+    for (auto& val: m_vulkanTextures)
     {
-        m_ge->vulkanRenderer()->destroyImage(val.image, val.imageMemory, val.imageView);
+        // the atlas textures have no image, their page destroys it
+        if (m_ge->vulkanRenderer() && val.image != VK_NULL_HANDLE)
+            m_ge->vulkanRenderer()->destroyImage(val.image, val.imageMemory, val.imageView, val.arrayIndex);
     }
     m_vulkanTextures.clear();
+    m_vulkanTextureHandles.clear();
 }
 
 void AssetManager::AddTexture(const std::string &name, const std::string &pathToFile)
 {
-    if (m_ge->isSDL())
+    createTexture(name, pathToFile, IMG_Load(pathToFile.c_str()));
+}
+
+void AssetManager::AddTextures(const std::vector<std::pair<std::string, std::string>>& textures)
+{
+    // the files are decoded on the worker threads, the renderer only gets them on the main thread
+    JobSystem* jobSystem{m_ge->jobSystem()};
+    JobSystem::counter done{0};
+    if (m_ge->isHeadless() || m_ge->isSDL())
+    {
+        for (const auto& texture: textures)
+        {
+            jobSystem->run([this, jobSystem, &done, texture]()
+            {
+                SDL_Surface* image = IMG_Load(texture.second.c_str());
+                jobSystem->runOnMainThread([this, texture, image]() { createTexture(texture.first, texture.second, image); }, &done);
+            }, &done);
+        }
+        jobSystem->wait(done);
+        return;
+    }
+
+    // the atlas needs every image before it can place them, they are converted to the format of the pages on the workers too
+    std::vector<SDL_Surface*> images(textures.size(), nullptr);
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        jobSystem->run([&images, &textures, i]()
+        {
+            SDL_Surface* image = IMG_Load(textures[i].second.c_str());
+            if (!image)
+                return;
+            images[i] = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+            SDL_FreeSurface(image);
+        }, &done);
+    }
+    jobSystem->wait(done);
+    createAtlasTextures(textures, images);
+}
+
+// copies the image to its place on the page, the edge pixels are repeated into the padding around it
+static void copyToAtlasPage(std::vector<uint32_t>& page, int pageWidth, const SDL_Surface* image, const TextureAtlas::rect& r, int padding)
+{
+    for (int y = -padding; y < r.height + padding; y++)
+    {
+        const uint32_t* source = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(image->pixels) + std::clamp(y, 0, r.height - 1) * image->pitch);
+        uint32_t* target = page.data() + (size_t)(r.y + y) * pageWidth + r.x;
+        for (int x = -padding; x < r.width + padding; x++)
+            target[x] = source[std::clamp(x, 0, r.width - 1)];
+    }
+}
+
+void AssetManager::createAtlasTextures(const std::vector<std::pair<std::string, std::string>>& textures, std::vector<SDL_Surface*>& images)
+{
+    // the tallest first, the skyline stays flatter that way
+    std::vector<size_t> order;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        if (images[i])
+            order.push_back(i);
+        else
+            Logger::Instance()->logError("AssetManager: cannot load image from: " + textures[i].second);
+    }
+    std::sort(order.begin(), order.end(), [&images](size_t a, size_t b)
+    {
+        return images[a]->h != images[b]->h ? images[a]->h > images[b]->h : images[a]->w > images[b]->w;
+    });
+
+    TextureAtlas atlas{m_atlasPageSize, m_atlasPadding};
+    std::vector<TextureAtlas::rect> rects(textures.size());
+    for (size_t i: order)
+    {
+        if (atlas.insert(images[i]->w, images[i]->h, rects[i]))
+            continue;
+        createTexture(textures[i].first, textures[i].second, images[i]);
+        images[i] = nullptr;
+    }
+
+    std::vector<uint32_t> pageHandles;
+    for (uint32_t page = 0; page < atlas.pageCount(); page++)
+    {
+        int width{atlas.pageWidth(page)};
+        int height{atlas.pageHeight(page)};
+        std::vector<uint32_t> pixels((size_t)width * height, 0);
+        for (size_t i: order)
+        {
+            if (images[i] && rects[i].page == page)
+                copyToAtlasPage(pixels, width, images[i], rects[i], m_atlasPadding);
+        }
+
+        textureData pageTexture{};
+        pageTexture.width = width;
+        pageTexture.height = height;
+        m_ge->vulkanRenderer()->loadTexture(pageTexture, pixels.data(), width * height * 4, width, height);
+        std::string name{"atlasPage" + std::to_string(m_atlasPageCount++)};
+        addVulkanTexture(name, pageTexture);
+        pageHandles.push_back(GetVulkanTextureHandle(name));
+        Logger::Instance()->logInfo("AssetManager: " + name + " " + std::to_string(width) + "x" + std::to_string(height) +
+            " occupancy " + std::to_string((int)(atlas.occupancy(page) * 100.0)) + "%");
+    }
+
+    // the packed textures only point into their page
+    size_t packed{0};
+    for (size_t i: order)
+    {
+        if (!images[i])
+            continue;
+        const textureData& page = m_vulkanTextures[pageHandles[rects[i].page]];
+        textureData textureToAdd{};
+        textureToAdd.set = page.set;
+        textureToAdd.arrayIndex = page.arrayIndex;
+        textureToAdd.imageHandle = pageHandles[rects[i].page];
+        textureToAdd.uvRect = atlas.uvRect(rects[i]);
+        textureToAdd.width = images[i]->w;
+        textureToAdd.height = images[i]->h;
+        addVulkanTexture(textures[i].first, textureToAdd);
+        SDL_FreeSurface(images[i]);
+        images[i] = nullptr;
+        packed++;
+    }
+    Logger::Instance()->logInfo("AssetManager: " + std::to_string(packed) + " textures packed on " + std::to_string(atlas.pageCount()) +
+        " atlas pages, occupancy " + std::to_string((int)(atlas.occupancy() * 100.0)) + "%");
+}
+
+void AssetManager::createTexture(const std::string& name, const std::string& pathToFile, SDL_Surface* image)
+{
+    if (!image)
+    {
+        Logger::Instance()->logError("AssetManager: cannot load image from: " + pathToFile + " With SDL_Error: " + SDL_GetError());
+        return;
+    }
+
+    if (m_ge->isHeadless())
+    {
+        // only the size, the scenes lay out their buttons with it
+        textureData textureToAdd{};
+        textureToAdd.width = image->w;
+        textureToAdd.height = image->h;
+        addVulkanTexture(name, textureToAdd);
+    }
+    else if (m_ge->isSDL())
     {
-        SDL_Texture* textureToAdd{nullptr};
-        textureToAdd = IMG_LoadTexture(m_ge->renderer(), pathToFile.c_str());
+        SDL_Texture* textureToAdd{SDL_CreateTextureFromSurface(m_ge->renderer(), image)};
         if (!textureToAdd)
         {
-            printf("IMG_LoadTexture failed! Cannot load image from: %s\nWith SDL_Error: %s\n", pathToFile.c_str(), SDL_GetError());
+            printf("SDL_CreateTextureFromSurface failed! Cannot load image from: %s\nWith SDL_Error: %s\n", pathToFile.c_str(), SDL_GetError());
+            SDL_FreeSurface(image);
             return;
         }
         m_textures.insert({name, textureToAdd});
@@ -113,9 +264,7 @@ void AssetManager::AddTexture(const std::string &name, const std::string &pathTo
     {
         textureData textureToAdd{};
 
-        void* pixels{nullptr};
-        SDL_Surface* image = IMG_Load(pathToFile.c_str());
-        pixels = image->pixels;
+        void* pixels{image->pixels};
         int size = image->h * image->pitch;// in bytes
         textureToAdd.height = image->h;
         textureToAdd.width = image->w;
@@ -123,14 +272,30 @@ void AssetManager::AddTexture(const std::string &name, const std::string &pathTo
         if(!pixels)
         {
             Logger::Instance()->logError("AssetManager: cannot load texture to vulkanTexture: " + pathToFile);
+            SDL_FreeSurface(image);
             return;
         }
 
         m_ge->vulkanRenderer()->loadTexture(textureToAdd, pixels, size, image->w, image->h);
 
-        m_vulkanTextures.insert({name, textureToAdd});
-        SDL_FreeSurface(image);
+        addVulkanTexture(name, textureToAdd);
     }
+    SDL_FreeSurface(image);
+}
+
+void AssetManager::addVulkanTexture(const std::string& name, const textureData& texture)
+{
+    if (m_vulkanTextureHandles.find(name) != m_vulkanTextureHandles.end())
+    {
+        Logger::Instance()->logWarning("AssetManager: there is already a texture named: " + name);
+        return;
+    }
+    if (m_vulkanTextures.size() == (size_t)RENDER::sortKeyTextureMask + 1)
+        Logger::Instance()->logWarning("AssetManager: more textures than the sort key holds, the draws of " + name + " and the later ones batch less");
+    m_vulkanTextureHandles.insert({name, (uint32_t)m_vulkanTextures.size()});
+    m_vulkanTextures.push_back(texture);
+    if (m_vulkanTextures.back().imageHandle == UINT32_MAX)
+        m_vulkanTextures.back().imageHandle = (uint32_t)m_vulkanTextures.size() - 1;
 }
 
 void AssetManager::AddAnimation(const std::string &name, int animSpeed, const std::vector<std::pair<int, int>> &sequence)
@@ -170,12 +335,21 @@ SDL_Texture* AssetManager::GetTexture(const std::string &name)
 
 VkDescriptorSet &AssetManager::GetVulkanTexture(const std::string &name)
 {
-    return m_vulkanTextures[name].set;
+    return m_vulkanTextures[GetVulkanTextureHandle(name)].set;
+}
+
+uint32_t AssetManager::GetVulkanTextureHandle(const std::string &name)
+{
+    auto it = m_vulkanTextureHandles.find(name);
+    if (it == m_vulkanTextureHandles.end())
+        throw std::out_of_range("AssetManager: cannot get texture asset named: " + name);
+    return it->second;
 }
 
 MATH::Vec2 AssetManager::GetVulkanTextureSize(const std::string &name)
 {
-    return MATH::Vec2{m_vulkanTextures[name].width, m_vulkanTextures[name].height};
+    auto& texture = m_vulkanTextures[GetVulkanTextureHandle(name)];
+    return MATH::Vec2{texture.width, texture.height};
 }
 
 std::shared_ptr<Animation> AssetManager::GetAnimation(const std::string &name)
@@ -210,46 +384,103 @@ TTF_Font *AssetManager::GetFont(const std::string &name)
     return m_fonts[name];
 }
 
+uint32_t AssetManager::bufferHandle(std::map<std::string, uint32_t>& handles, std::vector<vulkanBufferData>& buffers, const std::string& name)
+{
+    auto it = handles.find(name);
+    if (it != handles.end())
+        return it->second;
+    if (buffers.size() == (size_t)RENDER::sortKeyBufferMask + 1)
+        Logger::Instance()->logWarning("AssetManager: more buffers than the sort key holds, the draws of " + name + " and the later ones batch less");
+    buffers.push_back(vulkanBufferData{VK_NULL_HANDLE, VK_NULL_HANDLE, 0});
+    handles.insert({name, (uint32_t)buffers.size() - 1});
+    return (uint32_t)buffers.size() - 1;
+}
+
 void AssetManager::AddVertexBuffer(const std::string& name, const std::string& pathToFile)
 {
-    if (m_vertexBuffers.find(name)!=m_vertexBuffers.end())
+    if (!m_ge->vulkanRenderer())
+        return;
+    if (m_vertexBufferHandles.find(name) != m_vertexBufferHandles.end())
         return;
 
     VkBuffer buffer;
     VkDeviceMemory bufferMemory;
     if (m_ge->vulkanRenderer()->load2dVertexBuffer(pathToFile, buffer, bufferMemory))
-        m_vertexBuffers.insert({name, vulkanBufferData{buffer, bufferMemory, 0}});
+        m_vertexBuffers[bufferHandle(m_vertexBufferHandles, m_vertexBuffers, name)] = vulkanBufferData{buffer, bufferMemory, 0};
+}
+
+void AssetManager::SetVertexBuffer(const std::string& name, const std::vector<MATH::Vec4>& vertices, bool hostVisible)
+{
+    if (!m_ge->vulkanRenderer())
+        return;
+    auto& data = m_vertexBuffers[bufferHandle(m_vertexBufferHandles, m_vertexBuffers, name)];
+    if (data.buffer != VK_NULL_HANDLE)
+        m_ge->vulkanRenderer()->freeBuffer(data.buffer, data.bufferMemory);
+    data = vulkanBufferData{VK_NULL_HANDLE, VK_NULL_HANDLE, 0};
+
+    VkBuffer buffer;
+    VkDeviceMemory bufferMemory;
+    if (m_ge->vulkanRenderer()->create2dVertexBuffer(vertices, buffer, bufferMemory, hostVisible))
+        data = vulkanBufferData{buffer, bufferMemory, 0};
 }
 
 VkBuffer &AssetManager::GetVertexBuffer(const std::string& name)
 {
-    if (m_vertexBuffers.find(name) == m_vertexBuffers.end())
+    return m_vertexBuffers[GetVertexBufferHandle(name)].buffer;
+}
+
+uint32_t AssetManager::GetVertexBufferHandle(const std::string& name)
+{
+    auto it = m_vertexBufferHandles.find(name);
+    if (it == m_vertexBufferHandles.end() || m_vertexBuffers[it->second].buffer == VK_NULL_HANDLE)
         throw std::out_of_range("AssetManager: cannot get vertex asset named: " + name);
-    return m_vertexBuffers[name].buffer;
+    return it->second;
 }
 
 int AssetManager::GetIndexSize(const std::string& name)
 {
-    if (m_indexBuffers.find(name) == m_indexBuffers.end())
-        throw std::out_of_range("AssetManager: cannot get index asset named: " + name);
-    return m_indexBuffers[name].size;
+    return m_indexBuffers[GetIndexBufferHandle(name)].size;
 }
 
 void AssetManager::AddIndexBuffer(const std::string& name, const std::string& pathToFile)
 {
-    if (m_indexBuffers.find(name)!=m_indexBuffers.end())
+    if (!m_ge->vulkanRenderer())
+        return;
+    if (m_indexBufferHandles.find(name) != m_indexBufferHandles.end())
         return;
 
     VkBuffer buffer;
     VkDeviceMemory bufferMemory;
     int size{0};
     if (m_ge->vulkanRenderer()->loadIndexBuffer(pathToFile, buffer, bufferMemory, size))
-        m_indexBuffers.insert({name, vulkanBufferData{buffer, bufferMemory, size}});
+        m_indexBuffers[bufferHandle(m_indexBufferHandles, m_indexBuffers, name)] = vulkanBufferData{buffer, bufferMemory, size};
+}
+
+void AssetManager::SetIndexBuffer(const std::string& name, const std::vector<uint32_t>& indices, bool hostVisible)
+{
+    if (!m_ge->vulkanRenderer())
+        return;
+    auto& data = m_indexBuffers[bufferHandle(m_indexBufferHandles, m_indexBuffers, name)];
+    if (data.buffer != VK_NULL_HANDLE)
+        m_ge->vulkanRenderer()->freeBuffer(data.buffer, data.bufferMemory);
+    data = vulkanBufferData{VK_NULL_HANDLE, VK_NULL_HANDLE, 0};
+
+    VkBuffer buffer;
+    VkDeviceMemory bufferMemory;
+    int size{0};
+    if (m_ge->vulkanRenderer()->createIndexBuffer(indices, buffer, bufferMemory, size, hostVisible))
+        data = vulkanBufferData{buffer, bufferMemory, size};
 }
 
 VkBuffer &AssetManager::GetIndexBuffer(const std::string& name)
 {
-    if (m_indexBuffers.find(name) == m_indexBuffers.end())
+    return m_indexBuffers[GetIndexBufferHandle(name)].buffer;
+}
+
+uint32_t AssetManager::GetIndexBufferHandle(const std::string& name)
+{
+    auto it = m_indexBufferHandles.find(name);
+    if (it == m_indexBufferHandles.end() || m_indexBuffers[it->second].buffer == VK_NULL_HANDLE)
         throw std::out_of_range("AssetManager: cannot get index asset named: " + name);
-    return m_indexBuffers[name].buffer;
+    return it->second;
 }
@@ -37,18 +37,40 @@ private:
     std::map<std::string, Mix_Chunk*> m_sounds;
     std::map<std::string, Mix_Music*> m_musics;
     std::map<std::string, TTF_Font*> m_fonts;
-    std::map<std::string, vulkanBufferData> m_vertexBuffers;
-    std::map<std::string, vulkanBufferData> m_indexBuffers;
-    std::map<std::string, textureData> m_vulkanTextures;
+    // the vulkan assets are stored by handle, the names are only looked up once to get the handle
+    // a replaced buffer keeps its handle, so the components can keep it too
+    std::map<std::string, uint32_t> m_vertexBufferHandles;
+    std::map<std::string, uint32_t> m_indexBufferHandles;
+    std::map<std::string, uint32_t> m_vulkanTextureHandles;
+    std::vector<vulkanBufferData> m_vertexBuffers;
+    std::vector<vulkanBufferData> m_indexBuffers;
+    std::vector<textureData> m_vulkanTextures;
 
     int m_initFontSize{50};
 
+    // the textures of one AddTextures call are packed on atlas pages, a page is a texture too
+    const int m_atlasPageSize{2048};
+    const int m_atlasPadding{2};
+    uint32_t m_atlasPageCount{0};
+
+    // takes the decoded image and frees it, only on the main thread
+    void createTexture(const std::string& name, const std::string& pathToFile, SDL_Surface* image);
+    // takes the RGBA images and frees them, the ones larger than a page get their own texture
+    void createAtlasTextures(const std::vector<std::pair<std::string, std::string>>& textures, std::vector<SDL_Surface*>& images);
+    void addVulkanTexture(const std::string& name, const textureData& texture);
+    // the handle of the name, a new one if it has none yet
+    uint32_t bufferHandle(std::map<std::string, uint32_t>& handles, std::vector<vulkanBufferData>& buffers, const std::string& name);
+
 public:
     AssetManager() = delete;
     AssetManager(GameEngine* ge);
     ~AssetManager();
 
     void AddTexture(const std::string& name, const std::string& pathToFile);
+    /// @brief Load more textures at once, the files are decoded in parallel on the job system. Only call it from the main thread.
+    /// With vulkan they are packed on atlas pages, so the draws with different textures of the same call can be batched.
+    /// @param textures Pairs of the unique name and the full path to the image file
+    void AddTextures(const std::vector<std::pair<std::string, std::string>>& textures);
     void AddAnimation(
         const std::string& name,
         int animSpeed,
@@ -67,6 +89,11 @@ public:
 
     SDL_Texture* GetTexture(const std::string& name);
     VkDescriptorSet& GetVulkanTexture(const std::string& name);
+    /// @brief The handle of a loaded vulkan texture, for the draws that should not look up the name every frame
+    uint32_t GetVulkanTextureHandle(const std::string& name);
+    VkDescriptorSet& GetVulkanTexture(uint32_t handle) { return m_vulkanTextures[handle].set; };
+    /// @brief Everything the renderer needs from the texture: its own descriptor set or its index in the texture array
+    const textureData& GetVulkanTextureData(uint32_t handle) { return m_vulkanTextures[handle]; };
     MATH::Vec2 GetVulkanTextureSize(const std::string& name);
     std::shared_ptr<Animation> GetAnimation(const std::string& name);
     Mix_Chunk* GetSound(const std::string& name);
@@ -76,11 +103,30 @@ public:
     TTF_Font* GetFont(const std::string& name);
 
     void AddVertexBuffer(const std::string& name, const std::string& pathToFile);
+    /// @brief Create a vertex buffer from generated data, an existing buffer with the same name is replaced. Only call it from the main thread.
+    /// The replaced buffer is destroyed when the frames drawing it finished, the rendering does not stop for it.
+    /// @param name Unique name of the vertex buffer
+    /// @param vertices Vertices in the same format as the 2d vertex files: position and texture coordinate
+    /// @param hostVisible Written directly instead of copied to the GPU on the queue, for the meshes that are replaced often
+    void SetVertexBuffer(const std::string& name, const std::vector<MATH::Vec4>& vertices, bool hostVisible = false);
     VkBuffer &GetVertexBuffer(const std::string& name);
+    /// @brief The handle of a loaded vertex buffer, it stays the same when the buffer is replaced with SetVertexBuffer
+    uint32_t GetVertexBufferHandle(const std::string& name);
+    VkBuffer &GetVertexBuffer(uint32_t handle) { return m_vertexBuffers[handle].buffer; };
 
     void AddIndexBuffer(const std::string& name, const std::string& pathToFile);
+    /// @brief Create an index buffer from generated data, an existing buffer with the same name is replaced. Only call it from the main thread.
+    /// The replaced buffer is destroyed when the frames drawing it finished, the rendering does not stop for it.
+    /// @param name Unique name of the index buffer
+    /// @param indices Triangle list indices
+    /// @param hostVisible Written directly instead of copied to the GPU on the queue, for the meshes that are replaced often
+    void SetIndexBuffer(const std::string& name, const std::vector<uint32_t>& indices, bool hostVisible = false);
     VkBuffer &GetIndexBuffer(const std::string& name);
     int GetIndexSize(const std::string& name);
+    /// @brief The handle of a loaded index buffer, it stays the same when the buffer is replaced with SetIndexBuffer
+    uint32_t GetIndexBufferHandle(const std::string& name);
+    VkBuffer &GetIndexBuffer(uint32_t handle) { return m_indexBuffers[handle].buffer; };
+    int GetIndexSize(uint32_t handle) { return m_indexBuffers[handle].size; };
 
 };
 
@@ -0,0 +1,567 @@
+#include "Benchmarks.h"
+#include "SpatialHash.h"
+#include "AABBTree.h"
+#include "SimdKernels.h"
+#include "WallCollision.h"
+#include "Grid.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+#include "TextureAtlas.h"
+#include "FieldOfView.h"
+#include "MazeMesh.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+
+namespace BENCHMARK
+{
+    using clock = std::chrono::steady_clock;
+
+    static double elapsedMs(clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    void broadphase(const std::string& name, Broadphase& broadphase, int count, int frames, bool mixedSizes)
+    {
+        std::mt19937 generator{42};
+        float worldSize = std::sqrt((float)count) * 48.f;
+        std::uniform_real_distribution<float> position{0.f, worldSize};
+        std::uniform_real_distribution<float> halfSize{4.f, 16.f};
+        std::uniform_real_distribution<float> bigHalfSize{100.f, 400.f};
+        std::uniform_real_distribution<float> velocity{-2.f, 2.f};
+
+        std::vector<MATH::Vec2> pos(count), half(count), vel(count);
+        for (int i = 0; i < count; i++)
+        {
+            pos[i] = MATH::Vec2{position(generator), position(generator)};
+            half[i] = MATH::Vec2{halfSize(generator), halfSize(generator)};
+            if (mixedSizes && i % 50 == 0)
+                half[i] = MATH::Vec2{bigHalfSize(generator), bigHalfSize(generator)};
+            vel[i] = MATH::Vec2{velocity(generator), velocity(generator)};
+        }
+
+        broadphase.clear();
+        std::vector<Broadphase::idPair> pairs;
+        std::vector<size_t> queryRes;
+        double updateMs{0}, pairsMs{0}, queryMs{0};
+        size_t pairCount{0}, queryHits{0};
+
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                pos[i] = pos[i] + vel[i];
+                if (pos[i].x < 0.f || pos[i].x > worldSize)
+                    vel[i].x *= -1;
+                if (pos[i].y < 0.f || pos[i].y > worldSize)
+                    vel[i].y *= -1;
+            }
+
+            auto start = clock::now();
+            for (int i = 0; i < count; i++)
+                broadphase.update(i, COLLISION::makeAABB(pos[i], half[i]));
+            broadphase.removeStale();
+            updateMs += elapsedMs(start);
+
+            pairs.clear();
+            start = clock::now();
+            broadphase.findPairs(pairs);
+            pairsMs += elapsedMs(start);
+            pairCount = pairs.size();
+
+            // one query per 10 boxes, about the size of a player
+            start = clock::now();
+            for (int i = 0; i < count; i += 10)
+            {
+                queryRes.clear();
+                broadphase.query(COLLISION::makeAABB(pos[i], MATH::Vec2{20.f, 20.f}), queryRes);
+                queryHits += queryRes.size();
+            }
+            queryMs += elapsedMs(start);
+        }
+
+        const char* sizes{mixedSizes ? "mixed" : "small"};
+        printf("%-12s %7d %s boxes: update %8.3f ms, pairs %8.3f ms (%zu pairs), %d queries %8.3f ms (%zu hits) per frame\n",
+            name.c_str(), count, sizes, updateMs / frames, pairsMs / frames, pairCount, (count + 9) / 10, queryMs / frames, queryHits / frames);
+
+        // every pair with every other for the last frame, only where it finishes in reasonable time
+        if (count > 10000)
+            return;
+        auto start = clock::now();
+        size_t bruteCount{0};
+        for (int i = 0; i < count; i++)
+        {
+            COLLISION::aabb one{COLLISION::makeAABB(pos[i], half[i])};
+            for (int j = i + 1; j < count; j++)
+            {
+                if (COLLISION::overlap(one, COLLISION::makeAABB(pos[j], half[j])))
+                    bruteCount++;
+            }
+        }
+        printf("%-12s %7d %s boxes: every pair %8.3f ms (%zu pairs, %s)\n",
+            name.c_str(), count, sizes, elapsedMs(start), bruteCount, bruteCount == pairCount ? "same" : "DIFFERENT");
+    }
+
+    void simdKernels(int count, int frames)
+    {
+        std::mt19937 generator{42};
+        float worldSize = std::sqrt((float)count) * 48.f;
+        std::uniform_real_distribution<float> position{0.f, worldSize};
+        std::uniform_real_distribution<float> halfSize{4.f, 16.f};
+        std::uniform_real_distribution<float> velocity{-2.f, 2.f};
+
+        SIMD::boxes start;
+        start.reserve(count);
+        for (int i = 0; i < count; i++)
+        {
+            start.add(i,
+                MATH::Vec2{position(generator), position(generator)},
+                MATH::Vec2{velocity(generator), velocity(generator)},
+                MATH::Vec2{halfSize(generator), halfSize(generator)});
+        }
+
+        SIMD::level best{SIMD::detect()};
+        SIMD::boxes scalarData;
+        std::vector<uint32_t> scalarHits;
+        std::vector<SIMD::indexPair> scalarPairs;
+
+        for (int lvl = (int)SIMD::level::SCALAR; lvl <= (int)best; lvl++)
+        {
+            SIMD::setLevel((SIMD::level)lvl);
+            SIMD::boxes data{start};
+            std::vector<uint32_t> hits;
+            std::vector<SIMD::indexPair> pairs;
+
+            auto begin = clock::now();
+            for (int frame = 0; frame < frames; frame++)
+                SIMD::integrate(data, 1.f / 60.f);
+            double integrateMs = elapsedMs(begin) / frames;
+
+            // queries about the size of a player, the first one is not timed so the result vector is already allocated
+            int queries{std::min(count / 10, 1000)};
+            int step{count / queries};
+            SIMD::overlapOne(data, COLLISION::makeAABB(MATH::Vec2{data.posX[0], data.posY[0]}, MATH::Vec2{20.f, 20.f}), hits);
+            hits.clear();
+            begin = clock::now();
+            for (int i = 0; i < count; i += step)
+            {
+                MATH::Vec2 center{data.posX[i], data.posY[i]};
+                SIMD::overlapOne(data, COLLISION::makeAABB(center, MATH::Vec2{20.f, 20.f}), hits);
+            }
+            double overlapOneMs = elapsedMs(begin);
+
+            // every pair, only where it finishes in reasonable time
+            double overlapAllMs{0};
+            if (count <= 10000)
+            {
+                begin = clock::now();
+                SIMD::overlapAll(data, pairs);
+                overlapAllMs = elapsedMs(begin);
+            }
+
+            const char* same{"-"};
+            if (lvl == (int)SIMD::level::SCALAR)
+            {
+                scalarData = data;
+                scalarHits = hits;
+                scalarPairs = pairs;
+            }
+            else
+            {
+                bool equal = data.posX == scalarData.posX && data.posY == scalarData.posY && hits == scalarHits && pairs == scalarPairs;
+                same = equal ? "same as scalar" : "DIFFERENT from scalar";
+            }
+
+            printf("simd %-6s %7d boxes: integrate %8.4f ms, %d overlap queries %8.3f ms (%zu hits), every pair %9.3f ms (%zu pairs), %s\n",
+                SIMD::levelName((SIMD::level)lvl), count, integrateMs, queries, overlapOneMs, hits.size(), overlapAllMs, pairs.size(), same);
+        }
+        SIMD::setLevel(best);
+    }
+
+    void continuousCollision(int count, int frames)
+    {
+        // the same maze size as VulkanScene1 in a 1280x720 window, every wall is there with 50% chance
+        const int rowNumber{40}, columnNumber{20};
+        const float cellWidth{32.f}, cellHeight{36.f};
+        std::mt19937 generator{42};
+        std::uniform_int_distribution<int> wallBits{0, Grid::WALL_NORTH | Grid::WALL_WEST};
+        std::vector<uint8_t> walls(rowNumber * columnNumber);
+        for (auto& cell: walls)
+            cell = wallBits(generator);
+        WallCollision wallCollision{};
+        wallCollision.build(walls, rowNumber, columnNumber, cellWidth, cellHeight);
+
+        // 8 pixel boxes with up to 40 pixels per step, the walls are 1.6 pixels thick
+        std::uniform_real_distribution<float> positionX{0.f, rowNumber * cellWidth};
+        std::uniform_real_distribution<float> positionY{0.f, columnNumber * cellHeight};
+        std::uniform_real_distribution<float> velocity{-40.f, 40.f};
+        const MATH::Vec2 half{4.f, 4.f};
+        std::vector<MATH::Vec2> pos, vel;
+        while ((int)pos.size() < count)
+        {
+            MATH::Vec2 start{positionX(generator), positionY(generator)};
+            if (wallCollision.overlaps(COLLISION::makeAABB(start, half)))
+                continue;
+            pos.push_back(start);
+            vel.push_back(MATH::Vec2{velocity(generator), velocity(generator)});
+        }
+
+        SpatialHash hash{64.f};
+        std::vector<size_t> queryRes;
+        std::vector<MATH::Vec2> delta(count), nextVel(count);
+        size_t entityHits{0}, wallHits{0}, insideWall{0};
+        auto begin = clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            float maxStepDistance{0.f};
+            for (int i = 0; i < count; i++)
+            {
+                hash.update(i, COLLISION::makeAABB(pos[i], half));
+                maxStepDistance = std::max(maxStepDistance, MATH::VMath::mag(vel[i]));
+            }
+            hash.removeStale();
+
+            // every movement is decided from the start of the step, so the order does not matter
+            for (int i = 0; i < count; i++)
+            {
+                COLLISION::aabb box{COLLISION::makeAABB(pos[i], half)};
+                COLLISION::aabb swept{COLLISION::merge(box, COLLISION::aabb{box.min + vel[i], box.max + vel[i]})};
+                queryRes.clear();
+                hash.query(COLLISION::expand(swept, maxStepDistance), queryRes);
+
+                COLLISION::sweepHit first{};
+                for (auto other: queryRes)
+                {
+                    if (other == (size_t)i)
+                        continue;
+                    COLLISION::sweepHit hit{COLLISION::sweep(box, vel[i] - vel[other], COLLISION::makeAABB(pos[other], half))};
+                    if (hit.hit && hit.time < first.time)
+                        first = hit;
+                }
+                delta[i] = vel[i];
+                nextVel[i] = vel[i];
+                if (first.hit)
+                {
+                    // stop at the contact and bounce back like the enemies do
+                    delta[i] = vel[i] * first.time + first.normal * 0.01f;
+                    if (first.normal.x != 0.f)
+                        nextVel[i].x *= -1;
+                    else
+                        nextVel[i].y *= -1;
+                    entityHits++;
+                }
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                auto res = wallCollision.sweep(pos[i], half, delta[i]);
+                pos[i] = pos[i] + res.delta;
+                vel[i] = nextVel[i];
+                if (res.blockedX || res.blockedY)
+                    wallHits++;
+                if (res.blockedX)
+                    vel[i].x *= -1;
+                if (res.blockedY)
+                    vel[i].y *= -1;
+                if (wallCollision.overlaps(COLLISION::makeAABB(pos[i], half)))
+                    insideWall++;
+            }
+        }
+
+        printf("ccd %7d projectiles: %8.3f ms per step, %zu entity and %zu wall hits per step, %zu ended inside a wall\n",
+            count, elapsedMs(begin) / frames, entityHits / frames, wallHits / frames, insideWall);
+    }
+
+    // true if the masked wall is there exactly when the wall is there and one of its two cells is explored
+    static bool checkExploredWall(const FieldOfView& fieldOfView, uint8_t wall, uint8_t masked, uint8_t bit, int idx, int neighbour)
+    {
+        bool seen = fieldOfView.isExplored(idx) || (neighbour >= 0 && fieldOfView.isExplored(neighbour));
+        return ((masked & bit) != 0) == ((wall & bit) && seen);
+    }
+
+    void fogOfWar(int steps)
+    {
+        // two cells with the wall between them stored on the unexplored one, it must stay in the mask
+        std::vector<uint8_t> pair{Grid::WALL_NORTH | Grid::WALL_WEST, Grid::WALL_NORTH | Grid::WALL_WEST};
+        FieldOfView pairView{};
+        pairView.build(pair, 2, 1);
+        pairView.update(0, 0);
+        std::vector<uint8_t> pairMask;
+        pairView.exploredWalls(pair, pairMask);
+        bool pairOk = !pairView.isExplored(1) && pairMask[0] == pair[0] && pairMask[1] == Grid::WALL_WEST;
+
+        // the same maze size as VulkanScene1, the player walks to a random cell in every step
+        const int rowNumber{40}, columnNumber{20};
+        std::mt19937 generator{42};
+        std::uniform_int_distribution<int> wallBits{0, Grid::WALL_NORTH | Grid::WALL_WEST};
+        std::uniform_int_distribution<int> cellX{0, rowNumber - 1};
+        std::uniform_int_distribution<int> cellY{0, columnNumber - 1};
+        std::vector<uint8_t> walls(rowNumber * columnNumber);
+        for (auto& cell: walls)
+            cell = wallBits(generator);
+        FieldOfView fieldOfView{};
+        fieldOfView.build(walls, rowNumber, columnNumber);
+        std::vector<uint8_t> mask;
+        MazeMesh mesh{};
+
+        size_t wrongWalls{0}, triangles{0};
+        double bakeMs{0};
+        for (int step = 0; step < steps; step++)
+        {
+            fieldOfView.update(cellX(generator), cellY(generator));
+            auto begin = clock::now();
+            fieldOfView.exploredWalls(walls, mask);
+            mesh.bake(mask, rowNumber, columnNumber, 32.f, 36.f);
+            bakeMs += elapsedMs(begin);
+            triangles = mesh.getTriangleCount();
+
+            for (int y = 0; y < columnNumber; y++)
+            {
+                for (int x = 0; x < rowNumber; x++)
+                {
+                    int idx = x + y * rowNumber;
+                    if (!checkExploredWall(fieldOfView, walls[idx], mask[idx], Grid::WALL_NORTH, idx, y > 0 ? idx - rowNumber : -1))
+                        wrongWalls++;
+                    if (!checkExploredWall(fieldOfView, walls[idx], mask[idx], Grid::WALL_WEST, idx, x > 0 ? idx - 1 : -1))
+                        wrongWalls++;
+                }
+            }
+        }
+
+        printf("fog of war %5d steps: explored walls and bake %8.4f ms per step, %zu triangles at the end, %zu wrong walls, shared wall %s\n",
+            steps, bakeMs / steps, triangles, wrongWalls, pairOk ? "kept" : "LOST");
+    }
+
+    // some work for a leaf job that the compiler can not remove
+    static double leafWork(int seed)
+    {
+        double res{0.0};
+        for (int i = 1; i <= 2000; i++)
+            res += std::sqrt((double)(i + seed));
+        return res;
+    }
+
+    void jobSystem(int workerCount, int parents, int children)
+    {
+        std::vector<double> serialRes(parents);
+        auto begin = clock::now();
+        for (int p = 0; p < parents; p++)
+        {
+            for (int c = 0; c < children; c++)
+                serialRes[p] += leafWork(p * children + c);
+        }
+        double serialMs = elapsedMs(begin);
+
+        JobSystem jobs{workerCount};
+        std::vector<double> res(parents);
+        std::atomic<int> mainThreadJobs{0}, wrongThread{0};
+        JobSystem::counter done{0};
+        begin = clock::now();
+        for (int p = 0; p < parents; p++)
+        {
+            jobs.run([&, p]()
+            {
+                // the results of the children go to the allocator of the thread, the parent adds them up after the wait
+                double* childRes = (double*)jobs.allocate(sizeof(double) * children, alignof(double));
+                JobSystem::counter childrenDone{0};
+                for (int c = 0; c < children; c++)
+                    jobs.run([&, childRes, p, c]() { childRes[c] = leafWork(p * children + c); }, &childrenDone);
+                jobs.runOnMainThread([&]()
+                {
+                    mainThreadJobs++;
+                    if (!jobs.isMainThread())
+                        wrongThread++;
+                }, &childrenDone);
+                jobs.wait(childrenDone);
+                for (int c = 0; c < children; c++)
+                    res[p] += childRes[c];
+            }, &done);
+        }
+        jobs.wait(done);
+        double jobsMs = elapsedMs(begin);
+        jobs.resetAllocators();
+
+        // a thread of its own like the render thread: it is no worker, its wait runs the jobs too
+        std::vector<double> helperRes(parents);
+        std::atomic<int> helperJobs{0};
+        std::thread helper([&]()
+        {
+            std::thread::id id{std::this_thread::get_id()};
+            JobSystem::counter helperDone{0};
+            for (int p = 0; p < parents; p++)
+            {
+                jobs.run([&, id, p]()
+                {
+                    for (int c = 0; c < children; c++)
+                        helperRes[p] += leafWork(p * children + c);
+                    if (std::this_thread::get_id() == id)
+                        helperJobs++;
+                }, &helperDone);
+            }
+            jobs.wait(helperDone);
+        });
+        helper.join();
+
+        printf("jobs %2d workers %5d parents x %3d children: %8.3f ms, one thread %8.3f ms, %d main thread jobs (%d elsewhere), %s, %s, %d on the helper thread\n",
+            jobs.getWorkerCount(), parents, children, jobsMs, serialMs, mainThreadJobs.load(), wrongThread.load(),
+            res == serialRes ? "same result" : "DIFFERENT result", helperRes == serialRes ? "same helper result" : "DIFFERENT helper result",
+            helperJobs.load());
+    }
+
+    void renderQueue(int count, int frames)
+    {
+        std::mt19937 rng{42};
+        std::uniform_int_distribution<int> layerDist(0, 2), textureDist(0, 4), meshDist(0, 15);
+        const std::string names[16]{"rectangleVertex", "wallsVertex", "xarrowVertex", "wallsMeshVertex",
+            "rectangleIndex", "triangleIndex", "wallsNoneIndex", "wallsWestIndex", "wallsNorthIndex", "wallsNorthWestIndex",
+            "rightArrow", "leftArrow", "downArrow", "upArrow", "newformIndex", "wallsMeshIndex"};
+
+        std::vector<RENDER::shape2dInstance> instances(count);
+        std::vector<std::string> vertexNames(count), indexNames(count), textureNames(count);
+        for (int i = 0; i < count; i++)
+        {
+            int layer{layerDist(rng)}, texture{textureDist(rng)}, vertex{meshDist(rng) % 4}, index{meshDist(rng)};
+            auto pipe = texture ? RENDER::pipeline::SHAPE2D_TEXTURE : RENDER::pipeline::SHAPE2D;
+            instances[i].sortKey = RENDER::shape2dSortKey((uint16_t)layer, pipe, texture, vertex, index);
+            vertexNames[i] = names[vertex];
+            indexNames[i] = names[4 + index % 12];
+            textureNames[i] = texture ? "texture" + std::to_string(texture) : "";
+        }
+
+        RenderQueue queue;
+        std::vector<RenderQueue::entry> sorted;
+        auto begin = clock::now();
+        for (int f = 0; f < frames; f++)
+            sorted = queue.sort(instances);
+        double radixMs = elapsedMs(begin) / frames;
+
+        std::vector<RenderQueue::entry> reference(count);
+        begin = clock::now();
+        for (int f = 0; f < frames; f++)
+        {
+            for (int i = 0; i < count; i++)
+                reference[i] = RenderQueue::entry{instances[i].sortKey, (uint32_t)i};
+            std::stable_sort(reference.begin(), reference.end(), [](const auto& a, const auto& b) { return a.key < b.key; });
+        }
+        double stdMs = elapsedMs(begin) / frames;
+
+        // the string key of every draw and a lookup in the map of the batches
+        std::map<std::string, std::vector<uint32_t>> batches;
+        begin = clock::now();
+        for (int f = 0; f < frames; f++)
+        {
+            for (auto& [key, value]: batches)
+                value.clear();
+            for (int i = 0; i < count; i++)
+                batches[vertexNames[i] + indexNames[i] + textureNames[i]].push_back((uint32_t)i);
+        }
+        double mapMs = elapsedMs(begin) / frames;
+
+        bool same{true};
+        size_t batchCount{0};
+        for (int i = 0; i < count; i++)
+        {
+            same = same && sorted[i].key == reference[i].key && sorted[i].index == reference[i].index;
+            if (i == 0 || sorted[i].key != sorted[i - 1].key)
+                batchCount++;
+        }
+
+        printf("render queue %7d draws %4zu batches: radix sort %8.4f ms, std::stable_sort %8.4f ms, string map %8.4f ms per frame, %s\n",
+            count, batchCount, radixMs, stdMs, mapMs, same ? "same order" : "DIFFERENT order");
+    }
+
+    void atlasPacking(int count, int padding)
+    {
+        const int pageSize{2048};
+        std::mt19937 rng{42};
+        // mostly small sprites and buttons, a few large backgrounds
+        std::uniform_int_distribution<int> smallDist(8, 200), largeDist(200, 700), kindDist(0, 9);
+        std::vector<std::pair<int, int>> sizes(count);
+        for (auto& size: sizes)
+        {
+            bool large{kindDist(rng) == 0};
+            size = large ? std::pair{largeDist(rng), largeDist(rng)} : std::pair{smallDist(rng), smallDist(rng) / 4 + 8};
+        }
+        std::sort(sizes.begin(), sizes.end(), [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : a.first > b.first; });
+
+        TextureAtlas atlas{pageSize, padding};
+        TextureAtlas::rect r;
+        auto begin = clock::now();
+        for (const auto& size: sizes)
+            atlas.insert(size.first, size.second, r);
+        double skylineMs = elapsedMs(begin);
+
+        // the shelves: a row as high as its first sprite, a new row when the next one does not fit next to the last one
+        int shelfPages{1}, shelfX{0}, shelfY{0}, shelfHeight{0};
+        double shelfArea{0.0}, shelfUsed{0.0};
+        begin = clock::now();
+        for (const auto& size: sizes)
+        {
+            int w{size.first + 2 * padding}, h{size.second + 2 * padding};
+            if (shelfX + w > pageSize)
+            {
+                shelfY += shelfHeight;
+                shelfX = 0;
+                shelfHeight = 0;
+            }
+            if (shelfY + h > pageSize)
+            {
+                shelfArea += (double)pageSize * pageSize;
+                shelfPages++;
+                shelfX = shelfY = shelfHeight = 0;
+            }
+            shelfHeight = std::max(shelfHeight, h);
+            shelfX += w;
+            shelfUsed += (double)size.first * size.second;
+        }
+        // the last page is cut to its rows like the skyline pages
+        shelfArea += (double)pageSize * (shelfY + shelfHeight);
+        double shelfMs = elapsedMs(begin);
+
+        printf("atlas %5d sprites padding %d: skyline %2zu pages %5.1f%% used in %8.4f ms, shelves %2d pages %5.1f%% used in %8.4f ms\n",
+            count, padding, atlas.pageCount(), atlas.occupancy() * 100.0, skylineMs, shelfPages, shelfUsed / shelfArea * 100.0, shelfMs);
+    }
+
+    void run()
+    {
+        fogOfWar(1000);
+
+        atlasPacking(100, 2);
+        atlasPacking(1000, 2);
+        atlasPacking(1000, 0);
+
+        renderQueue(1000, 1000);
+        renderQueue(10000, 100);
+        renderQueue(100000, 10);
+
+        jobSystem(0, 64, 64);
+        jobSystem(0, 1024, 8);
+
+        continuousCollision(100, 1000);
+        continuousCollision(500, 1000);
+        continuousCollision(2000, 200);
+
+        simdKernels(1000, 1000);
+        simdKernels(10000, 100);
+        simdKernels(100000, 10);
+
+        SpatialHash hash{64.f};
+        AABBTree tree{4.f};
+        for (bool mixedSizes: {false, true})
+        {
+            broadphase("spatial hash", hash, 1000, 100, mixedSizes);
+            broadphase("aabb tree", tree, 1000, 100, mixedSizes);
+            broadphase("spatial hash", hash, 10000, 50, mixedSizes);
+            broadphase("aabb tree", tree, 10000, 50, mixedSizes);
+            broadphase("spatial hash", hash, 100000, 10, mixedSizes);
+            broadphase("aabb tree", tree, 100000, 10, mixedSizes);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <string>
+
+class Broadphase;
+
+// measurements without a window, started with the --benchmark argument
+// the results are written to the console
+namespace BENCHMARK
+{
+    // moving boxes in a world that grows with the count, so the density stays the same
+    // the updates, pair finding and queries are timed, checking every pair is timed for the smaller counts
+    // mixedSizes: a few boxes are a lot bigger than the rest, like the map and the buttons next to the markers
+    void broadphase(const std::string& name, Broadphase& broadphase, int count, int frames, bool mixedSizes);
+    // the SIMD kernels on every level the CPU supports, each result is compared with the scalar one
+    void simdKernels(int count, int frames);
+    // projectiles that move further in one step than their size and the wall thickness, in a random maze
+    // they are swept against the walls and each other, at the end none of them may be inside a wall
+    void continuousCollision(int count, int frames);
+    // the player looks around from random cells of a random maze, the walls seen from the explored cells are baked every step
+    // each wall is checked against its two cells, and a wall stored on the unexplored side of an explored cell has to stay
+    void fogOfWar(int steps);
+    // jobs that start smaller jobs and wait for them, many more than the workers, compared with the same work on one thread
+    // every leaf job also sends one job to the main thread, they must all run there
+    void jobSystem(int workerCount, int parents, int children);
+    // draws with random layers, textures and meshes: the radix sorted keys against std::stable_sort on the same keys,
+    // and against batching them by a name string in a std::map like before the sort keys; the orders have to be the same
+    void renderQueue(int count, int frames);
+    // random sprite sizes packed on atlas pages with the skyline packer and with simple shelves, tallest first for both
+    // the pages, the occupancy of the used part of the pages and the time of the packing are compared
+    void atlasPacking(int count, int padding);
+
+    void run();
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "Collision.h"
+
+// finds the boxes that can touch, so the exact collision check only runs on these instead of every pair
+// the boxes are identified with the entity id
+class Broadphase
+{
+public:
+    using idPair = std::pair<size_t, size_t>;
+
+    virtual ~Broadphase() {};
+
+    // inserts the id if it is not in yet, otherwise moves its box
+    virtual void update(size_t id, const COLLISION::aabb& box) = 0;
+    virtual void remove(size_t id) = 0;
+    // removes every id that was not updated since the last call, e.g. destroyed entities
+    virtual void removeStale() = 0;
+    virtual void clear() = 0;
+    virtual int size() = 0;
+
+    // every id with a box overlapping the given one, once
+    virtual void query(const COLLISION::aabb& box, std::vector<size_t>& res) = 0;
+    virtual void queryPoint(const MATH::Vec2& point, std::vector<size_t>& res) = 0;
+    // every id with a box hit by the segment, the closest first
+    virtual void raycast(const MATH::Vec2& from, const MATH::Vec2& to, std::vector<size_t>& res) = 0;
+    // every overlapping pair once, the smaller id first
+    virtual void findPairs(std::vector<idPair>& res) = 0;
+
+};
+
+#endif
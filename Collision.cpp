@@ -0,0 +1,143 @@
+#include "Collision.h"
+#include <algorithm>
+#include <cmath>
+
+namespace COLLISION
+{
+    aabb makeAABB(const MATH::Vec2& center, const MATH::Vec2& halfSize)
+    {
+        return aabb{center - halfSize, center + halfSize};
+    }
+
+    bool overlap(const aabb& one, const aabb& two)
+    {
+        return one.min.x < two.max.x && one.max.x > two.min.x
+            && one.min.y < two.max.y && one.max.y > two.min.y;
+    }
+
+    bool pointInside(const MATH::Vec2& point, const aabb& box)
+    {
+        return point.x >= box.min.x && point.x <= box.max.x
+            && point.y >= box.min.y && point.y <= box.max.y;
+    }
+
+    aabb merge(const aabb& one, const aabb& two)
+    {
+        return aabb{
+            MATH::Vec2{std::min(one.min.x, two.min.x), std::min(one.min.y, two.min.y)},
+            MATH::Vec2{std::max(one.max.x, two.max.x), std::max(one.max.y, two.max.y)}
+            };
+    }
+
+    aabb expand(const aabb& box, float margin)
+    {
+        return aabb{
+            MATH::Vec2{box.min.x - margin, box.min.y - margin},
+            MATH::Vec2{box.max.x + margin, box.max.y + margin}
+            };
+    }
+
+    bool contains(const aabb& outer, const aabb& inner)
+    {
+        return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y
+            && outer.max.x >= inner.max.x && outer.max.y >= inner.max.y;
+    }
+
+    float perimeter(const aabb& box)
+    {
+        return 2.f * ((box.max.x - box.min.x) + (box.max.y - box.min.y));
+    }
+
+    bool raycast(const MATH::Vec2& origin, const MATH::Vec2& delta, const aabb& box, float& time)
+    {
+        // slab test, the segment is inside both the x and the y slab between entry and exit
+        float entry{0.f}, exit{1.f};
+        float start[2]{origin.x, origin.y};
+        float dir[2]{delta.x, delta.y};
+        float min[2]{box.min.x, box.min.y};
+        float max[2]{box.max.x, box.max.y};
+
+        for (int i = 0; i < 2; i++)
+        {
+            if (dir[i] == 0.f)
+            {
+                if (start[i] < min[i] || start[i] > max[i])
+                    return false;
+                continue;
+            }
+            float t1 = (min[i] - start[i]) / dir[i];
+            float t2 = (max[i] - start[i]) / dir[i];
+            if (t1 > t2)
+                std::swap(t1, t2);
+            entry = std::max(entry, t1);
+            exit = std::min(exit, t2);
+            if (entry > exit)
+                return false;
+        }
+
+        time = entry;
+        return true;
+    }
+
+    sweepHit sweep(const aabb& moving, const MATH::Vec2& delta, const aabb& target)
+    {
+        sweepHit res{};
+
+        if (overlap(moving, target))
+            return res;
+
+        // Minkowski sum: the target grows with the moving box, so the moving box becomes a ray from its min corner
+        float entryX, exitX, entryY, exitY;
+        if (delta.x > 0.f)
+        {
+            entryX = (target.min.x - moving.max.x) / delta.x;
+            exitX = (target.max.x - moving.min.x) / delta.x;
+        }
+        else if (delta.x < 0.f)
+        {
+            entryX = (target.max.x - moving.min.x) / delta.x;
+            exitX = (target.min.x - moving.max.x) / delta.x;
+        }
+        else
+        {
+            if (moving.max.x <= target.min.x || moving.min.x >= target.max.x)
+                return res;
+            entryX = -INFINITY;
+            exitX = INFINITY;
+        }
+
+        if (delta.y > 0.f)
+        {
+            entryY = (target.min.y - moving.max.y) / delta.y;
+            exitY = (target.max.y - moving.min.y) / delta.y;
+        }
+        else if (delta.y < 0.f)
+        {
+            entryY = (target.max.y - moving.min.y) / delta.y;
+            exitY = (target.min.y - moving.max.y) / delta.y;
+        }
+        else
+        {
+            if (moving.max.y <= target.min.y || moving.min.y >= target.max.y)
+                return res;
+            entryY = -INFINITY;
+            exitY = INFINITY;
+        }
+
+        float entry = std::max(entryX, entryY);
+        float exit = std::min(exitX, exitY);
+
+        // touching is not a hit, only the case when the boxes would overlap after the contact
+        if (entry >= exit || entry < 0.f || entry > 1.f)
+            return res;
+
+        res.hit = true;
+        res.time = entry;
+        if (entryX > entryY)
+            res.normal.x = (delta.x > 0.f) ? -1.f : 1.f;
+        else
+            res.normal.y = (delta.y > 0.f) ? -1.f : 1.f;
+
+        return res;
+    }
+}
@@ -0,0 +1,42 @@
+/// used sources from the internet:
+/// https://www.gamedev.net/tutorials/programming/general-and-gameplay-programming/swept-aabb-collision-detection-and-response-r3084/
+/// https://noonat.github.io/intersect/
+
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "Vector.h"
+
+namespace COLLISION
+{
+    struct aabb
+    {
+        MATH::Vec2 min{};
+        MATH::Vec2 max{};
+    };
+
+    struct sweepHit
+    {
+        bool hit{false};
+        float time{1.f}; // fraction of the movement until the first contact, 0..1
+        MATH::Vec2 normal{0.f, 0.f}; // points out of the hit box, towards the moving box
+    };
+
+    aabb makeAABB(const MATH::Vec2& center, const MATH::Vec2& halfSize);
+    bool overlap(const aabb& one, const aabb& two);
+    bool pointInside(const MATH::Vec2& point, const aabb& box);
+    aabb merge(const aabb& one, const aabb& two);
+    aabb expand(const aabb& box, float margin);
+    bool contains(const aabb& outer, const aabb& inner);
+    float perimeter(const aabb& box);
+
+    // the segment from origin to origin + delta against the box, time is the fraction of the segment at the entry
+    // a segment starting inside the box hits it at 0
+    bool raycast(const MATH::Vec2& origin, const MATH::Vec2& delta, const aabb& box, float& time);
+
+    // moves the box "moving" with "delta" and returns the first contact with the static box "target"
+    // boxes that already overlap at the start are not reported, so an entity stuck inside can move out
+    sweepHit sweep(const aabb& moving, const MATH::Vec2& delta, const aabb& target);
+}
+
+#endif
@@ -24,18 +24,25 @@ class CTransform : public Component
 {
 public:
     CTransform() {};
-    CTransform(MATH::Vec2 startingPos) : pos(startingPos), cameraViewPos(startingPos) {};
+    CTransform(MATH::Vec2 startingPos) : pos(startingPos), prevPos(startingPos), cameraViewPos(startingPos) {};
     CTransform(MATH::Vec2 startingPos, MATH::Vec2 startingVel, double angleInit, double turnSpeedInit, int moveSpeedInit)
-        : pos(startingPos), cameraViewPos(startingPos), vel(startingVel), angle(angleInit), turnSpeed(turnSpeedInit), maxTurnSpeed(turnSpeedInit), moveSpeed(moveSpeedInit), maxMoveSpeed(moveSpeedInit) {};
+        : pos(startingPos), prevPos(startingPos), cameraViewPos(startingPos), vel(startingVel), angle(angleInit), turnSpeed(turnSpeedInit), maxTurnSpeed(turnSpeedInit), moveSpeed(moveSpeedInit), maxMoveSpeed(moveSpeedInit) {};
+
+    // position between the previous and the current simulation step, alpha is 0..1
+    MATH::Vec2 renderPos(float alpha) { return prevPos + (pos - prevPos) * alpha; };
+    // jump without interpolation, e.g. respawn
+    void teleport(const MATH::Vec2& newPos) { pos = newPos; prevPos = newPos; };
 
     MATH::Vec2 pos{0.f, 0.f};
+    MATH::Vec2 prevPos{0.f, 0.f}; // pos before the last simulation step
     MATH::Vec2 cameraViewPos{0.f, 0.f};
-    MATH::Vec2 vel{0.f, 0.f};
+    MATH::Vec2 vel{0.f, 0.f}; // the direction, the length scales the speed
     double angle{0};
     int turnDirection{1};
-    double turnSpeed{0};
+    // the speeds are per second, the movement systems scale them with the simulation step
+    double turnSpeed{0}; // degrees
     double maxTurnSpeed{0};
-    int moveSpeed{0};
+    float moveSpeed{0}; // pixels along vel
     int maxMoveSpeed{0};
 
 };
@@ -74,6 +81,8 @@ public:
     bool turning{false};
     bool moving{false};
     bool cameraIndependent{false};
+    bool hidden{false}; // not drawn, e.g. out of the field of view
+    bool fast{false}; // can move through a whole entity in one step, it is swept against the other entities too
 
 };
 
@@ -134,6 +143,7 @@ public:
     CTexture(const std::string& theName) : name(theName) {};
 
     std::string name{""};
+    uint32_t handle{UINT32_MAX}; // of the vulkan texture, the scene looks it up at the first draw
 
 };
 
@@ -141,11 +151,20 @@ class CShape2d : public Component
 {
 public:
     CShape2d() {};
-    CShape2d(const std::string& vertName, const std::string& indName)
-        : vertexName(vertName), indexName(indName) {};
+    CShape2d(const std::string& vertName, const std::string& indName, uint16_t drawLayer = 1, bool staticLayer = false)
+        : vertexName(vertName), indexName(indName), layer(drawLayer), isStatic(staticLayer) {};
+
+    // the handle is looked up again for the new name
+    void setIndexName(const std::string& name) { indexName = name; indexHandle = UINT32_MAX; };
 
     std::string vertexName{""};
     std::string indexName{""};
+    uint16_t layer{1}; // drawn from the lowest layer, 0 is the background
+    // drawn with the static layer under every other shape, the scene has to invalidate the layer after changing it
+    bool isStatic{false};
+    // the handles of the assetmanager, the scene looks them up at the first draw
+    uint32_t vertexHandle{UINT32_MAX};
+    uint32_t indexHandle{UINT32_MAX};
 
 };
 
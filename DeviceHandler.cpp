@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <string>
 #include <set>
+#include <algorithm>
 #include <SDL_vulkan.h>
 
 #include <optional>
@@ -31,6 +32,10 @@ DeviceHandler::DeviceHandler(SDL_Window* window)
     Logger::Instance()->logVerbose("DeviceHandler createSurface done");
     pickPhysicalDevice();
     Logger::Instance()->logVerbose("DeviceHandler pickPhysicalDevice done");
+    queryDescriptorIndexing();
+    Logger::Instance()->logVerbose("DeviceHandler queryDescriptorIndexing done");
+    queryGpuCulling();
+    Logger::Instance()->logVerbose("DeviceHandler queryGpuCulling done");
     createLogicalDevice();
     Logger::Instance()->logVerbose("DeviceHandler createLogicalDevice done");
     createSwapchain();
@@ -47,6 +52,8 @@ DeviceHandler::DeviceHandler(SDL_Window* window)
     Logger::Instance()->logVerbose("DeviceHandler createCommandBuffer done");
     createSyncObjects();
     Logger::Instance()->logVerbose("DeviceHandler createSyncObjects done");
+    createTimestampPool();
+    Logger::Instance()->logVerbose("DeviceHandler createTimestampPool done");
     createTextureSampler();
     Logger::Instance()->logVerbose("DeviceHandler createTextureSampler done");
     Logger::Instance()->log("DeviceHandler Constructor end");
@@ -59,12 +66,16 @@ DeviceHandler::~DeviceHandler()
     Logger::Instance()->logVerbose("DeviceHandler vkDeviceWaitIdle done");
     vkDestroySampler(m_logicalDevice, m_sampler, VK_NULL_HANDLE);
     Logger::Instance()->logVerbose("DeviceHandler vkDestroySampler done");
-    vkDestroyFence(m_logicalDevice, m_renderFinishedFence, VK_NULL_HANDLE);
-    Logger::Instance()->logVerbose("DeviceHandler vkDestroyFence done");
-    vkDestroySemaphore(m_logicalDevice, m_renderFinishedSemaphore, VK_NULL_HANDLE);
-    Logger::Instance()->logVerbose("DeviceHandler vkDestroySemaphore done");
-    vkDestroySemaphore(m_logicalDevice, m_imageAvailableSemaphore, VK_NULL_HANDLE);
-    Logger::Instance()->logVerbose("DeviceHandler vkDestroySemaphore done");
+    if (m_timestampPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(m_logicalDevice, m_timestampPool, VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < m_concurrentFrames; i++)
+    {
+        vkDestroyFence(m_logicalDevice, m_inFlightFences[i], VK_NULL_HANDLE);
+        vkDestroySemaphore(m_logicalDevice, m_imageAvailableSemaphores[i], VK_NULL_HANDLE);
+    }
+    for (auto semaphore: m_renderFinishedSemaphores)
+    { vkDestroySemaphore(m_logicalDevice, semaphore, VK_NULL_HANDLE); }
+    Logger::Instance()->logVerbose("DeviceHandler vkDestroyFence and vkDestroySemaphore done");
     vkDestroyCommandPool(m_logicalDevice, m_commandPool, VK_NULL_HANDLE);
     Logger::Instance()->logVerbose("DeviceHandler vkDestroyCommandPool done");
     for (auto f: m_swapChainFrameBuffers)
@@ -276,6 +287,73 @@ void DeviceHandler::pickPhysicalDevice() {
     Logger::Instance()->logVerbose("Vulkan: pickPhysicalDevice 5");
 }
 
+void DeviceHandler::queryDescriptorIndexing()
+{
+    // the extension is core only from vulkan 1.2, we stay on 1.0 and ask for it the old way
+    if (!IsExtensionSupported(m_info.physicalDeviceExtensionProperties, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+        !IsExtensionSupported(m_info.physicalDeviceExtensionProperties, VK_KHR_MAINTENANCE3_EXTENSION_NAME) ||
+        !IsExtensionSupported(m_info.supportedInstanceExtensions, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+    {
+        Logger::Instance()->logInfo("Vulkan: no descriptor indexing, the textures are bound one by one");
+        return;
+    }
+
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2KHR");
+    auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceProperties2KHR");
+    if (getFeatures2 == nullptr || getProperties2 == nullptr)
+        return;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT};
+    VkPhysicalDeviceFeatures2KHR features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR};
+    features.pNext = &supported;
+    getFeatures2(m_physicalDevice, &features);
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT};
+    VkPhysicalDeviceProperties2KHR properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR};
+    properties.pNext = &limits;
+    getProperties2(m_physicalDevice, &properties);
+
+    // one array of combined image samplers, indexed per instance, partly filled, and its unused elements written while the frames in flight use it
+    if (!supported.shaderSampledImageArrayNonUniformIndexing || !supported.runtimeDescriptorArray ||
+        !supported.descriptorBindingPartiallyBound || !supported.descriptorBindingSampledImageUpdateAfterBind ||
+        !supported.descriptorBindingUpdateUnusedWhilePending)
+    {
+        Logger::Instance()->logInfo("Vulkan: descriptor indexing misses features, the textures are bound one by one");
+        return;
+    }
+
+    m_descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    m_descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    m_descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    m_descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    m_descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    m_info.requiredPhysicalDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    m_info.requiredPhysicalDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+    // a combined image sampler counts as a sampler and as a sampled image too
+    m_maxTextureArraySize = std::min({
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        limits.maxDescriptorSetUpdateAfterBindSamplers,
+        limits.maxDescriptorSetUpdateAfterBindSampledImages
+    });
+    m_descriptorIndexing = m_maxTextureArraySize > 0;
+    Logger::Instance()->logInfo("Vulkan: descriptor indexing with at most " + std::to_string(m_maxTextureArraySize) + " textures in one array");
+}
+
+void DeviceHandler::queryGpuCulling()
+{
+    // the culling runs on the graphics queue before the render pass, and the indirect draws start at the first instance of their batch
+    const auto& queueFamily = m_info.physicalDeviceQueueFamilyProperties[m_info.graphicsQueueIndex.value()];
+    if (!(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) || !m_info.physicalDeviceFeatures.drawIndirectFirstInstance)
+    {
+        Logger::Instance()->logInfo("Vulkan: no compute on the graphics queue or no indirect first instance, the instances are culled on the CPU only");
+        return;
+    }
+    m_gpuCulling = true;
+    Logger::Instance()->logInfo("Vulkan: the instances are culled on the GPU and drawn indirect");
+}
+
 bool DeviceHandler::isDeviceGoodForUs(const VkPhysicalDevice& device)
 {
     bool boolRes{true};
@@ -417,16 +495,33 @@ void DeviceHandler::createSwapchainFramebuffers()
 }
 
 void DeviceHandler::createCommandPool()
+{
+    createCommandPool(m_commandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+}
+
+void DeviceHandler::createCommandPool(VkCommandPool& pool, VkCommandPoolCreateFlags flags)
 {
     VkCommandPoolCreateInfo commandPoolCreateInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
-    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolCreateInfo.flags = flags;
     /*
     VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: Hint that command buffers are rerecorded with new commands very often (may change memory allocation behavior)
     VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: Allow command buffers to be rerecorded individually, without this flag they all have to be reset together
     */
     commandPoolCreateInfo.queueFamilyIndex = m_info.graphicsQueueIndex.value();
 
-    checkVkResult(vkCreateCommandPool(m_logicalDevice, &commandPoolCreateInfo, nullptr, &m_commandPool));
+    checkVkResult(vkCreateCommandPool(m_logicalDevice, &commandPoolCreateInfo, nullptr, &pool));
+}
+
+void DeviceHandler::resetCommandPool(VkCommandPool& pool)
+{
+    // every buffer of the pool goes back to the initial state at once, the memory is kept for the next recording
+    checkVkResult(vkResetCommandPool(m_logicalDevice, pool, 0));
+}
+
+void DeviceHandler::destroyCommandPool(VkCommandPool& pool)
+{
+    vkDestroyCommandPool(m_logicalDevice, pool, VK_NULL_HANDLE);
+    pool = VK_NULL_HANDLE;
 }
 
 void DeviceHandler::createCommandBuffer(VkCommandBuffer& buffer, VkCommandBufferLevel level)
@@ -444,9 +539,14 @@ void DeviceHandler::createCommandBuffer(VkCommandBuffer& buffer, VkCommandBuffer
 }
 
 void DeviceHandler::createCommandBuffer(std::vector<VkCommandBuffer>& buffer, VkCommandBufferLevel level)
+{
+    createCommandBuffer(buffer, level, m_commandPool);
+}
+
+void DeviceHandler::createCommandBuffer(std::vector<VkCommandBuffer>& buffer, VkCommandBufferLevel level, VkCommandPool pool)
 {
     VkCommandBufferAllocateInfo createInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
-    createInfo.commandPool = m_commandPool;
+    createInfo.commandPool = pool;
     createInfo.level = level;
     /*
     VK_COMMAND_BUFFER_LEVEL_PRIMARY: Can be submitted to a queue for execution, but cannot be called from other command buffers.
@@ -463,9 +563,36 @@ void DeviceHandler::createSyncObjects()
     VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    checkVkResult(vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &m_imageAvailableSemaphore));
-    checkVkResult(vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &m_renderFinishedSemaphore));
-    checkVkResult(vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &m_renderFinishedFence));
+    m_imageAvailableSemaphores.resize(m_concurrentFrames);
+    m_inFlightFences.resize(m_concurrentFrames);
+    for (uint32_t i = 0; i < m_concurrentFrames; i++)
+    {
+        checkVkResult(vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]));
+        checkVkResult(vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &m_inFlightFences[i]));
+    }
+    // the present waits on it, it can only be signaled again when the same image is acquired again
+    m_renderFinishedSemaphores.resize(m_swapChainImages.size());
+    for (auto& semaphore: m_renderFinishedSemaphores)
+    {
+        checkVkResult(vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &semaphore));
+    }
+}
+
+void DeviceHandler::createTimestampPool()
+{
+    m_timestampsWritten.assign(m_concurrentFrames, false);
+    const auto& queueFamily = m_info.physicalDeviceQueueFamilyProperties[m_info.graphicsQueueIndex.value()];
+    if (queueFamily.timestampValidBits == 0 || m_info.physicalDeviceProperties.limits.timestampPeriod <= 0.f)
+    {
+        Logger::Instance()->logInfo("DeviceHandler: the graphics queue has no timestamps, the GPU time is not measured");
+        return;
+    }
+    m_timestampPeriod = m_info.physicalDeviceProperties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * m_concurrentFrames;
+    checkVkResult(vkCreateQueryPool(m_logicalDevice, &queryPoolInfo, nullptr, &m_timestampPool));
 }
 
 void DeviceHandler::recordCommand(VkCommandBuffer buffer, uint32_t imageIndex)
@@ -511,10 +638,11 @@ void DeviceHandler::createLogicalDevice() {
     queueCreateInfo[0].pQueuePriorities = &prio;
 
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.drawIndirectFirstInstance = m_gpuCulling ? VK_TRUE : VK_FALSE;
 
     VkDeviceCreateInfo deviceCreateInfo{};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceCreateInfo.pNext = NULL;
+    deviceCreateInfo.pNext = m_descriptorIndexing ? &m_descriptorIndexingFeatures : NULL;
     deviceCreateInfo.queueCreateInfoCount = 1;
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfo;
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
@@ -651,34 +779,51 @@ void DeviceHandler::createRenderPass()
     checkVkResult(vkCreateRenderPass(m_logicalDevice, &renderPassCreateInfo, nullptr, &m_renderPass));
 }
 
-void DeviceHandler::drawFrame(VkCommandBuffer& buffer)
+uint32_t DeviceHandler::beginFrame()
 {
-    vkWaitForFences(m_logicalDevice, 1, &m_renderFinishedFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(m_logicalDevice, 1, &m_renderFinishedFence);
+    // only this frame's previous use has to be finished, the other frame in flight can still be on the GPU
+    uint64_t waitStart{SDL_GetPerformanceCounter()};
+    vkWaitForFences(m_logicalDevice, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+    m_frameFinishedTime = SDL_GetPerformanceCounter();
+    m_fenceWaitMs = (m_frameFinishedTime - waitStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    if (m_timestampsWritten[m_currentFrame])
+    {
+        uint64_t timestamps[2]{};
+        if (vkGetQueryPoolResults(m_logicalDevice, m_timestampPool, 2 * m_currentFrame, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+            m_gpuMs = (timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6;
+    }
 
     vkAcquireNextImageKHR(
         m_logicalDevice,
         m_swapchain,
         UINT64_MAX,
-        m_imageAvailableSemaphore,
+        m_imageAvailableSemaphores[m_currentFrame],
         VK_NULL_HANDLE,
         &m_currentImageIndex
         );
+    vkResetFences(m_logicalDevice, 1, &m_inFlightFences[m_currentFrame]);
+
+    return m_currentFrame;
+}
 
+void DeviceHandler::submitFrame(VkCommandBuffer& buffer)
+{
     VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
 
-    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphore};
+    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &buffer;
-    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphore};
+    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentImageIndex]};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    checkVkResult(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_renderFinishedFence));
+    checkVkResult(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]));
+    m_submitTime = SDL_GetPerformanceCounter();
 
     VkPresentInfoKHR presentInfo{VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
     presentInfo.waitSemaphoreCount = 1;
@@ -689,18 +834,35 @@ void DeviceHandler::drawFrame(VkCommandBuffer& buffer)
     presentInfo.pImageIndices = &m_currentImageIndex;
 
     checkVkResult(vkQueuePresentKHR(m_presentQueue, &presentInfo));
-    checkVkResult(vkQueueWaitIdle(m_presentQueue));
+
+    m_currentFrame = (m_currentFrame + 1) % m_concurrentFrames;
+}
+
+void DeviceHandler::waitIdle()
+{
+    checkVkResult(vkDeviceWaitIdle(m_logicalDevice));
 }
 
 void DeviceHandler::recordRenderPrimaryCommandBuffer(
     VkCommandBuffer& buffer,
-    std::vector<VkCommandBuffer>& secBuffers
+    std::vector<VkCommandBuffer>& secBuffers,
+    const std::function<void(VkCommandBuffer&)>& beforeRenderPass
     )
 {
     VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
 
     checkVkResult(vkBeginCommandBuffer(buffer, &beginInfo));
 
+    if (m_timestampPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(buffer, m_timestampPool, 2 * m_currentFrame, 2);
+        vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool, 2 * m_currentFrame);
+    }
+
+    // the compute work can not be recorded inside the render pass
+    if (beforeRenderPass)
+        beforeRenderPass(buffer);
+
     VkRenderPassBeginInfo renderPassInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
     renderPassInfo.renderPass = m_renderPass;
     renderPassInfo.framebuffer = m_swapChainFrameBuffers[m_currentImageIndex];
@@ -717,6 +879,12 @@ void DeviceHandler::recordRenderPrimaryCommandBuffer(
 
     vkCmdEndRenderPass(buffer);
 
+    if (m_timestampPool != VK_NULL_HANDLE)
+    {
+        vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool, 2 * m_currentFrame + 1);
+        m_timestampsWritten[m_currentFrame] = true;
+    }
+
     recordEndCommandBuffer(buffer);
 }
 
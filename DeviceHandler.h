@@ -5,6 +5,7 @@
 #include <SDL.h>
 #include <iostream>
 #include <optional>
+#include <functional>
 #include <vulkan/vulkan.h>
 #include "Vector.h"
 
@@ -40,7 +41,9 @@ private:
 
     gpuInfo m_info{};
 
-    const int m_concurrentFrames{2};//not used yet; maybe later
+    // the CPU records the next frame while the GPU still draws the previous one, every frame in flight has its own sync objects
+    const uint32_t m_concurrentFrames{2};
+    uint32_t m_currentFrame{0};
 
     SDL_Window* m_window{nullptr};
     VkInstance m_instance{nullptr};
@@ -54,18 +57,36 @@ private:
     std::vector<VkImageView> m_swapChainImageViews;
     std::vector<VkFramebuffer> m_swapChainFrameBuffers;
     VkCommandPool m_commandPool;
-    VkSemaphore m_imageAvailableSemaphore;
-    VkSemaphore m_renderFinishedSemaphore;
-    VkFence m_renderFinishedFence;
+    std::vector<VkSemaphore> m_imageAvailableSemaphores;
+    std::vector<VkSemaphore> m_renderFinishedSemaphores; // one per swapchain image, the others per frame in flight
+    std::vector<VkFence> m_inFlightFences;
     uint32_t m_currentImageIndex{0};
+    // performance counter ticks for the latency measurement: the last submitFrame, and when beginFrame saw the fence of the slot signalled
+    uint64_t m_submitTime{0};
+    uint64_t m_frameFinishedTime{0};
+    // how long beginFrame waited for the GPU, and how long the GPU drew the frame that used the slot before, in ms
+    double m_fenceWaitMs{0.0};
+    double m_gpuMs{0.0};
+    // two timestamps per frame in flight, read back when the frame comes again
+    VkQueryPool m_timestampPool{VK_NULL_HANDLE};
+    std::vector<bool> m_timestampsWritten;
+    double m_timestampPeriod{0.0}; // ns per tick, 0 if the queue has no timestamps
     VkRenderPass m_renderPass{};
     VkSampler m_sampler;
+    // descriptor indexing is optional, without it every texture has its own descriptor set
+    bool m_descriptorIndexing{false};
+    uint32_t m_maxTextureArraySize{0};
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT m_descriptorIndexingFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT};
+    // vulkan 1.0 core only, so it runs on the software drivers too; without it the instances are drawn directly
+    bool m_gpuCulling{false};
 
     bool IsExtensionSupported(const std::vector<VkExtensionProperties>& supportedExtensions, const char* extension);
 
     void createInstance();
     void createSurface();
     void pickPhysicalDevice();
+    void queryDescriptorIndexing();
+    void queryGpuCulling();
     void createLogicalDevice();
     void createSwapchain();
     void createSwapchainImageViews();
@@ -74,6 +95,7 @@ private:
     void createCommandPool();
     void recordCommand(VkCommandBuffer buffer, uint32_t imageIndex);
     void createSyncObjects();
+    void createTimestampPool();
     void createTextureSampler();
 
     // debugging part
@@ -106,10 +128,29 @@ public:
 
     void checkVkResult(const VkResult& res);
 
-    void drawFrame(VkCommandBuffer& buffer);
+    // waits until the GPU finished the last use of the next frame in flight and acquires the swapchain image, returns the frame index
+    uint32_t beginFrame();
+    // submits the recorded frame and presents it without waiting for the GPU, the next beginFrame moves to the next frame in flight
+    void submitFrame(VkCommandBuffer& buffer);
+    // before destroying something that a frame in flight may still use
+    void waitIdle();
+    uint32_t getFramesInFlight() { return m_concurrentFrames; };
+    uint32_t getCurrentFrame() { return m_currentFrame; };
+    uint64_t getSubmitTime() { return m_submitTime; };
+    // the frame that used the slot of the last beginFrame before was drawn by then, at the latest
+    uint64_t getFrameFinishedTime() { return m_frameFinishedTime; };
+    double getFenceWaitMs() { return m_fenceWaitMs; };
+    // 0 without timestamp support or before the first frames finished
+    double getGpuMs() { return m_gpuMs; };
     void createCommandBuffer(VkCommandBuffer& buffer, VkCommandBufferLevel level);
     void createCommandBuffer(std::vector<VkCommandBuffer>& buffer, VkCommandBufferLevel level);
-    void recordRenderPrimaryCommandBuffer(VkCommandBuffer& buffer, std::vector<VkCommandBuffer>& secBuffers);
+    // a command pool and its buffers can only be used by one thread at a time, the threads recording at once need their own pools
+    void createCommandPool(VkCommandPool& pool, VkCommandPoolCreateFlags flags);
+    void resetCommandPool(VkCommandPool& pool);
+    void destroyCommandPool(VkCommandPool& pool);
+    void createCommandBuffer(std::vector<VkCommandBuffer>& buffer, VkCommandBufferLevel level, VkCommandPool pool);
+    // beforeRenderPass records into the primary before the render pass begins, e.g. the compute work the draws depend on
+    void recordRenderPrimaryCommandBuffer(VkCommandBuffer& buffer, std::vector<VkCommandBuffer>& secBuffers, const std::function<void(VkCommandBuffer&)>& beforeRenderPass = nullptr);
     void recordRenderSecondaryCommandBufferStart(VkCommandBuffer& buffer);
     void recordOneTimerCommandBufferStart(VkCommandBuffer& buffer);
     void recordEndCommandBuffer(VkCommandBuffer& buffer);
@@ -137,6 +178,12 @@ public:
     VkQueue getPresentQueue() { return m_presentQueue; };
     VkRenderPass &getRenderPass() { return m_renderPass; };
     VkSampler &getSampler() { return m_sampler; };
+    const VkPhysicalDeviceLimits& getLimits() { return m_info.physicalDeviceProperties.limits; };
+    bool hasDescriptorIndexing() { return m_descriptorIndexing; };
+    // the most textures a bindless array can hold on this device, 0 without descriptor indexing
+    uint32_t getMaxTextureArraySize() { return m_maxTextureArraySize; };
+    // compute on the graphics queue and indirect draws that start at any instance
+    bool hasGpuCulling() { return m_gpuCulling; };
 };
 
 #endif
@@ -38,6 +38,7 @@ public:
     Entity(const std::string& tag, size_t id): m_tag(tag), m_id(id) {};
 
     const std::string& tag() { return m_tag; };
+    size_t id() { return m_id; };
     bool isActive() { return m_active; };
 
     void destroy();
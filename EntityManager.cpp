@@ -19,12 +19,21 @@ EntityVector& EntityManager::getEntities(const std::string& tag)
     return m_entityMap[tag];
 }
 
+std::shared_ptr<Entity> EntityManager::getEntity(size_t id)
+{
+    auto it = m_entityById.find(id);
+    if (it == m_entityById.end())
+        return nullptr;
+    return it->second;
+}
+
 void EntityManager::update()
 {
     for (auto entity : m_toAdd)
     {
         m_entities.push_back(entity);
         m_entityMap[entity->tag()].push_back(entity);
+        m_entityById.insert({entity->id(), entity});
     }
     EntityVector temp;
     for (auto entity : m_entities)
@@ -36,6 +45,7 @@ void EntityManager::update()
     {
         m_entityMap[entity->tag()].erase(std::find(m_entityMap[entity->tag()].begin(), m_entityMap[entity->tag()].end(), entity));
         m_entities.erase(std::find(m_entities.begin(), m_entities.end(), entity));
+        m_entityById.erase(entity->id());
     }
     m_toAdd.clear();
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <unordered_map>
 
 class Entity;
 
@@ -16,6 +17,7 @@ class EntityManager
 private:
     EntityVector m_entities;
     EntityMap m_entityMap;
+    std::unordered_map<size_t, std::shared_ptr<Entity>> m_entityById;
     size_t m_totalEntities{0};
     EntityVector m_toAdd;
 
@@ -28,6 +30,10 @@ public:
     std::shared_ptr<Entity> addEntity(const std::string& tag);
     EntityVector& getEntities();
     EntityVector& getEntities(const std::string& tag);
+    // nullptr if there is no active entity with the id
+    std::shared_ptr<Entity> getEntity(size_t id);
+    // the added entities are only in the vectors after the next update
+    bool hasPendingEntities() { return !m_toAdd.empty(); };
 
 };
 
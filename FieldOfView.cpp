@@ -0,0 +1,168 @@
+#include "FieldOfView.h"
+#include "Grid.h"
+#include <algorithm>
+
+bool FieldOfView::isOpaque(int tileX, int tileY) const
+{
+    if (tileX < 0 || tileY < 0 || tileX >= m_tileW || tileY >= m_tileH)
+        return true;
+    return m_opaque[tileX + tileY * m_tileW];
+}
+
+void FieldOfView::lightTile(int tileX, int tileY)
+{
+    // only the cell tiles are stored, the wall tiles are just blocking the light
+    if (!(tileX & 1) || !(tileY & 1))
+        return;
+    int idx = (tileX >> 1) + (tileY >> 1) * m_rowNumber;
+    uint64_t bit = 1ull << (idx & 63);
+    m_visible[idx >> 6] |= bit;
+    if (!(m_explored[idx >> 6] & bit))
+    {
+        m_explored[idx >> 6] |= bit;
+        m_exploredChanged = true;
+    }
+}
+
+void FieldOfView::castLight(int originX, int originY, int row, float startSlope, float endSlope, int xx, int xy, int yx, int yy)
+{
+    if (startSlope < endSlope)
+        return;
+
+    int radius = m_radius > 0 ? m_radius : std::max(m_tileW, m_tileH);
+    int radiusSquared = radius * radius;
+    float nextStartSlope = startSlope;
+
+    for (int distance = row; distance <= radius; distance++)
+    {
+        bool blocked = false;
+        int deltaY = -distance;
+        for (int deltaX = -distance; deltaX <= 0; deltaX++)
+        {
+            int tileX = originX + deltaX * xx + deltaY * xy;
+            int tileY = originY + deltaX * yx + deltaY * yy;
+            float leftSlope = (deltaX - 0.5f) / (deltaY + 0.5f);
+            float rightSlope = (deltaX + 0.5f) / (deltaY - 0.5f);
+
+            if (startSlope < rightSlope)
+                continue;
+            if (endSlope > leftSlope)
+                break;
+
+            if (deltaX * deltaX + deltaY * deltaY <= radiusSquared && tileX >= 0 && tileY >= 0 && tileX < m_tileW && tileY < m_tileH)
+                lightTile(tileX, tileY);
+
+            if (blocked)
+            {
+                if (isOpaque(tileX, tileY))
+                {
+                    nextStartSlope = rightSlope;
+                    continue;
+                }
+                blocked = false;
+                startSlope = nextStartSlope;
+            }
+            else if (isOpaque(tileX, tileY) && distance < radius)
+            {
+                // the shadow starts here, the part of the octant before it is scanned further with a new recursion
+                blocked = true;
+                castLight(originX, originY, distance + 1, startSlope, leftSlope, xx, xy, yx, yy);
+                nextStartSlope = rightSlope;
+            }
+        }
+        if (blocked)
+            break;
+    }
+}
+
+void FieldOfView::build(const std::vector<uint8_t>& walls, int rowNumber, int columnNumber)
+{
+    m_rowNumber = rowNumber;
+    m_columnNumber = columnNumber;
+    m_tileW = rowNumber * 2 + 1;
+    m_tileH = columnNumber * 2 + 1;
+    m_opaque.assign(m_tileW * m_tileH, 0);
+
+    for (int y = 0; y < columnNumber; y++)
+    {
+        for (int x = 0; x < rowNumber; x++)
+        {
+            uint8_t cell = walls[x + y * rowNumber];
+            if (cell & Grid::WALL_NORTH)
+                m_opaque[(2 * x + 1) + (2 * y) * m_tileW] = 1;
+            if (cell & Grid::WALL_WEST)
+                m_opaque[(2 * x) + (2 * y + 1) * m_tileW] = 1;
+        }
+    }
+    // the east and south border of the grid
+    for (int y = 0; y < m_tileH; y++)
+        m_opaque[(m_tileW - 1) + y * m_tileW] = 1;
+    for (int x = 0; x < m_tileW; x++)
+        m_opaque[x + (m_tileH - 1) * m_tileW] = 1;
+    // the corners between the walls are blocking if any wall touches them, so the light cannot leak through diagonally
+    for (int y = 0; y < m_tileH; y += 2)
+    {
+        for (int x = 0; x < m_tileW; x += 2)
+        {
+            bool wallNear = (x > 0 && m_opaque[(x - 1) + y * m_tileW])
+                || (x + 1 < m_tileW && m_opaque[(x + 1) + y * m_tileW])
+                || (y > 0 && m_opaque[x + (y - 1) * m_tileW])
+                || (y + 1 < m_tileH && m_opaque[x + (y + 1) * m_tileW]);
+            if (wallNear)
+                m_opaque[x + y * m_tileW] = 1;
+        }
+    }
+
+    size_t words = (rowNumber * columnNumber + 63) / 64;
+    m_visible.assign(words, 0);
+    m_explored.assign(words, 0);
+    m_originCell = -1;
+    m_exploredChanged = false;
+}
+
+bool FieldOfView::update(int cellX, int cellY)
+{
+    m_exploredChanged = false;
+    int cell = cellX + cellY * m_rowNumber;
+    if (cell == m_originCell || m_opaque.empty())
+        return false;
+    m_originCell = cell;
+
+    std::fill(m_visible.begin(), m_visible.end(), 0);
+
+    int originX = cellX * 2 + 1;
+    int originY = cellY * 2 + 1;
+    lightTile(originX, originY);
+
+    // the 8 octants as transformations of the first one
+    static const int multipliers[4][8] = {
+        {1, 0, 0, -1, -1, 0, 0, 1},
+        {0, 1, -1, 0, 0, -1, 1, 0},
+        {0, 1, 1, 0, 0, -1, -1, 0},
+        {1, 0, 0, 1, -1, 0, 0, -1}
+    };
+    for (int octant = 0; octant < 8; octant++)
+    {
+        castLight(originX, originY, 1, 1.f, 0.f,
+            multipliers[0][octant], multipliers[1][octant], multipliers[2][octant], multipliers[3][octant]);
+    }
+
+    return true;
+}
+
+void FieldOfView::exploredWalls(const std::vector<uint8_t>& walls, std::vector<uint8_t>& res) const
+{
+    res.assign(walls.size(), 0);
+    for (int y = 0; y < m_columnNumber; y++)
+    {
+        for (int x = 0; x < m_rowNumber; x++)
+        {
+            int idx = x + y * m_rowNumber;
+            bool explored = isExplored(idx);
+            if ((walls[idx] & Grid::WALL_NORTH) && (explored || (y > 0 && isExplored(idx - m_rowNumber))))
+                res[idx] |= Grid::WALL_NORTH;
+            if ((walls[idx] & Grid::WALL_WEST) && (explored || (x > 0 && isExplored(idx - 1))))
+                res[idx] |= Grid::WALL_WEST;
+        }
+    }
+}
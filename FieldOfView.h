@@ -0,0 +1,58 @@
+/// used sources from the internet:
+/// https://www.roguebasin.com/index.php/FOV_using_recursive_shadowcasting
+/// https://www.albertford.com/shadowcasting/
+
+#ifndef FIELDOFVIEW_H
+#define FIELDOFVIEW_H
+
+#include <vector>
+#include <cstdint>
+
+// line of sight over the maze grid with recursive shadowcasting
+// the thin walls of the maze are turned into a tile map twice the size of the grid:
+// cells are on the odd tiles, the walls between them on the even ones, so the walls can block the light like blocks
+// the result is a visible and an explored bit per cell, indexed like the CNode id
+class FieldOfView
+{
+private:
+    std::vector<uint8_t> m_opaque;
+    std::vector<uint64_t> m_visible;
+    std::vector<uint64_t> m_explored;
+
+    int m_rowNumber{0}; // cells on the x axis, same naming as in the Grid
+    int m_columnNumber{0}; // cells on the y axis
+    int m_tileW{0};
+    int m_tileH{0};
+    int m_radius{0}; // in tiles, 0 means the whole grid
+
+    int m_originCell{-1};
+    bool m_exploredChanged{false};
+
+    bool isOpaque(int tileX, int tileY) const;
+    void lightTile(int tileX, int tileY);
+    void castLight(int originX, int originY, int row, float startSlope, float endSlope, int xx, int xy, int yx, int yy);
+
+public:
+    FieldOfView() {};
+
+    void build(const std::vector<uint8_t>& walls, int rowNumber, int columnNumber);
+    // in cells, 0 is unlimited
+    void setRadius(int radius) { m_radius = radius * 2; };
+
+    // recomputes the visible cells if the origin moved to another cell, returns true if it did
+    bool update(int cellX, int cellY);
+
+    bool isVisible(int idx) const { return m_visible[idx >> 6] & (1ull << (idx & 63)); };
+    bool isExplored(int idx) const { return m_explored[idx >> 6] & (1ull << (idx & 63)); };
+    // true if the last update found new cells
+    bool exploredChanged() const { return m_exploredChanged; };
+    // the walls seen from an explored cell: a wall is stored on one of its two cells only (north and west),
+    // so it is kept if that cell or the neighbour on the other side is explored
+    void exploredWalls(const std::vector<uint8_t>& walls, std::vector<uint8_t>& res) const;
+
+    const std::vector<uint64_t>& getVisible() { return m_visible; };
+    const std::vector<uint64_t>& getExplored() { return m_explored; };
+
+};
+
+#endif
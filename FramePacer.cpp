@@ -0,0 +1,112 @@
+#include "FramePacer.h"
+#include <SDL.h>
+#include <algorithm>
+#include <cmath>
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+FramePacer::FramePacer(size_t historySize)
+    : m_spinSeconds(m_minSpinSeconds), m_frameTimes(std::max<size_t>(historySize, 1), 0.0)
+{
+    m_frequency = SDL_GetPerformanceFrequency();
+}
+
+void FramePacer::setTargetFps(double fps)
+{
+    m_targetFps = std::max(fps, 0.0);
+    m_period = (m_targetFps > 0.0) ? (uint64_t)(m_frequency / m_targetFps) : 0;
+    // the new rate counts from the current frame
+    m_deadline = m_frameStart + m_period;
+}
+
+void FramePacer::start()
+{
+    m_frameStart = SDL_GetPerformanceCounter();
+    m_deadline = m_frameStart + m_period;
+}
+
+void FramePacer::sleepUntil(uint64_t deadline)
+{
+    while (true)
+    {
+        uint64_t now{SDL_GetPerformanceCounter()};
+        if (now >= deadline)
+            return;
+        double remaining{toSeconds(deadline - now)};
+        if (remaining <= m_spinSeconds)
+            continue;
+
+        double sleepSeconds{remaining - m_spinSeconds};
+#ifdef _WIN32
+        SDL_Delay((Uint32)(sleepSeconds * 1000.0));
+#else
+        timespec duration{};
+        duration.tv_sec = (time_t)sleepSeconds;
+        duration.tv_nsec = (long)((sleepSeconds - std::floor(sleepSeconds)) * 1e9);
+        clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, nullptr);
+#endif
+        // how late the sleep was, the busy loop starts earlier if the OS keeps oversleeping
+        double late{toSeconds(SDL_GetPerformanceCounter() - now) - sleepSeconds};
+        m_oversleep = std::max(late, m_oversleep * 0.95);
+        m_spinSeconds = std::clamp(m_oversleep, m_minSpinSeconds, m_maxSpinSeconds);
+    }
+}
+
+double FramePacer::endFrame()
+{
+    if (m_period > 0)
+    {
+        sleepUntil(m_deadline);
+        // the next deadline follows the previous one so the rate does not drift, after a long frame it starts again from now
+        uint64_t now{SDL_GetPerformanceCounter()};
+        m_deadline += m_period;
+        if (m_deadline < now)
+            m_deadline = now + m_period;
+    }
+
+    uint64_t now{SDL_GetPerformanceCounter()};
+    double frameSeconds{toSeconds(now - m_frameStart)};
+    m_frameStart = now;
+
+    m_frameTimes[m_nextFrame] = frameSeconds * 1000.0;
+    m_nextFrame = (m_nextFrame + 1) % m_frameTimes.size();
+    m_frameCount = std::min(m_frameCount + 1, m_frameTimes.size());
+
+    return frameSeconds;
+}
+
+FramePacer::frameStats FramePacer::getStats() const
+{
+    frameStats res{};
+    if (m_frameCount == 0)
+        return res;
+
+    std::vector<double> sorted(m_frameTimes.begin(), m_frameTimes.begin() + m_frameCount);
+    std::sort(sorted.begin(), sorted.end());
+    double sum{0.0};
+    for (auto frameTime: sorted)
+        sum += frameTime;
+
+    // nearest rank percentile
+    auto percentile = [&](double p)
+    {
+        size_t rank = (size_t)std::ceil(p * sorted.size());
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    };
+
+    res.count = sorted.size();
+    res.average = sum / sorted.size();
+    res.min = sorted.front();
+    res.max = sorted.back();
+    res.p50 = percentile(0.50);
+    res.p95 = percentile(0.95);
+    res.p99 = percentile(0.99);
+    return res;
+}
+
+void FramePacer::resetStats()
+{
+    m_nextFrame = 0;
+    m_frameCount = 0;
+}
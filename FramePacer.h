@@ -0,0 +1,75 @@
+/// used sources from the internet:
+/// https://blog.bearcats.nl/perfect-sleep-function/
+/// https://man7.org/linux/man-pages/man2/clock_nanosleep.2.html
+/// https://wiki.libsdl.org/SDL2/SDL_GetPerformanceCounter
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// keeps the frames at a target rate with the high resolution counter instead of the 1 ms SDL ticks
+// the wait is a sleep until shortly before the end of the frame and a busy loop for the rest, the OS sleep can oversleep but the loop can not
+// the length of the last frames is stored, so the percentiles show the stutters that the average hides
+class FramePacer
+{
+public:
+    struct frameStats
+    {
+        size_t count{0};
+        double average{0.0}; // ms
+        double min{0.0};
+        double max{0.0};
+        double p50{0.0};
+        double p95{0.0};
+        double p99{0.0};
+    };
+
+private:
+    double m_targetFps{0.0}; // 0: no limit
+    uint64_t m_frequency{1};
+    uint64_t m_period{0}; // counter ticks per frame, 0 without a limit
+    uint64_t m_frameStart{0};
+    uint64_t m_deadline{0};
+
+    // the busy loop takes over this long before the deadline, it grows if the sleeps are late more than this
+#ifdef _WIN32
+    const double m_minSpinSeconds{0.002}; // SDL_Delay has 1 ms steps on windows
+#else
+    const double m_minSpinSeconds{0.0005};
+#endif
+    const double m_maxSpinSeconds{0.004}; // one preempted sleep should not make every frame spin long
+    double m_spinSeconds{0.0};
+    double m_oversleep{0.0};
+
+    std::vector<double> m_frameTimes; // ms, ring buffer
+    size_t m_nextFrame{0};
+    size_t m_frameCount{0};
+
+    double toSeconds(uint64_t ticks) const { return (double)ticks / m_frequency; };
+    void sleepUntil(uint64_t deadline);
+
+public:
+    FramePacer(size_t historySize = 1024);
+
+    // 0 or less: no limit
+    void setTargetFps(double fps);
+    double getTargetFps() const { return m_targetFps; };
+    // performance counter ticks when the current frame started
+    uint64_t frameStart() const { return m_frameStart; };
+    uint64_t toTicks(double seconds) const { return (uint64_t)(seconds * m_frequency); };
+
+    // starts measuring from now, call it once before the first frame
+    void start();
+    // waits until the end of the frame with the target rate, then the next frame starts
+    // returns the length of the frame in seconds, the waiting included
+    double endFrame();
+
+    // over the stored frames, the oldest ones are dropped after historySize frames
+    frameStats getStats() const;
+    void resetStats();
+};
+
+#endif
@@ -8,9 +8,14 @@
 #include "Action.h"
 #include "AssetManager.h"
 #include <iostream>
+#include <algorithm>
+#include <cstdio>
 
 #include "Logger.h"
 #include "VulkanRenderer.h"
+#include "JobSystem.h"
+#include "LatencyTracker.h"
+#include "Replay.h"
 
 void GameEngine::init()
 {
@@ -24,7 +29,16 @@ void GameEngine::init()
     }
 
     Logger::Instance()->logVerbose("GameEngine init 1");
-    if (SDLRenderer)
+    // a replay sets the seed of the recording later, before the first scene
+    setSeed((uint32_t)std::chrono::system_clock::now().time_since_epoch().count());
+    m_startScene = m_headless ? "VulkanScene1" : "VulkanSceneMenu";
+    m_latencyTracker = std::make_unique<LatencyTracker>();
+    if (m_headless)
+    {
+        // no window and no renderer, the scenes are only simulated
+        Logger::Instance()->logVerbose("GameEngine init headless, no window");
+    }
+    else if (SDLRenderer)
     {
         Logger::Instance()->logVerbose("GameEngine init SDL window create");
         m_window = SDL_CreateWindow("GameSDL", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, m_windowX, m_windowY, 0);
@@ -48,6 +62,7 @@ void GameEngine::init()
             Logger::Instance()->logCritical(strcat("SDL Window with Vulkan creation failed! With SDL_Error: ", SDL_GetError()));
         }
         m_vulkanRenderer = new VulkanRenderer(m_window);
+        m_vulkanRenderer->setLatencyTracker(m_latencyTracker.get());
     }
 
     Logger::Instance()->logVerbose("GameEngine init 2");
@@ -57,7 +72,7 @@ void GameEngine::init()
     }
 
     Logger::Instance()->logVerbose("GameEngine init 3");
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 8, 2048) < 0)
+    if (!m_headless && Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 8, 2048) < 0)
     {
         Logger::Instance()->logCritical(strcat("MIX_openAudio failed! With SDL_Error: ", SDL_GetError()));
     }
@@ -75,13 +90,29 @@ void GameEngine::init()
     }
 
     Logger::Instance()->logVerbose("GameEngine init 6");
+    m_jobSystem = std::make_unique<JobSystem>();
+    if (m_vulkanRenderer)
+        m_vulkanRenderer->setJobSystem(m_jobSystem.get());
     m_am = std::make_shared<AssetManager>(this);
     Logger::Instance()->log("GameEngine init End");
 }
 
+GameEngine::~GameEngine()
+{
+    quit();
+}
+
 void GameEngine::quit()
 {
+    // the render thread presents to the window, it stops before anything is destroyed
+    if (m_vulkanRenderer)
+        m_vulkanRenderer->stopRenderThread();
     m_am.reset();
+    m_replay.close((uint32_t)m_stepCount);
+    if (m_vulkanRenderer)
+        m_vulkanRenderer->setJobSystem(nullptr);
+    // waits for the jobs still running
+    m_jobSystem.reset();
 
     Logger::Instance()->log("GameEngine quit Start");
     for (auto& [key, value] : m_scenes)
@@ -109,87 +140,244 @@ void GameEngine::quit()
 
 void GameEngine::updateFPS(const double frameLength)
 {
-    FPS = std::min(MAXFPS, 1000.0 / frameLength);
+    FPS = 1000.0 / std::max(frameLength, 0.001);
     TICKS_PER_FRAME = 1000.0 / FPS;
 }
 
+void GameEngine::nextTargetFps()
+{
+    auto stats = m_framePacer.getStats();
+    Logger::Instance()->logInfo("GameEngine target fps " + std::to_string(m_framePacer.getTargetFps())
+        + " frame ms average: " + std::to_string(stats.average) + " p50: " + std::to_string(stats.p50)
+        + " p95: " + std::to_string(stats.p95) + " p99: " + std::to_string(stats.p99) + " max: " + std::to_string(stats.max));
+
+    auto current = std::find(TARGET_FPS_OPTIONS.begin(), TARGET_FPS_OPTIONS.end(), m_framePacer.getTargetFps());
+    if (current == TARGET_FPS_OPTIONS.end() || ++current == TARGET_FPS_OPTIONS.end())
+        current = TARGET_FPS_OPTIONS.begin();
+    m_framePacer.setTargetFps(*current);
+    m_framePacer.resetStats();
+}
+
 void GameEngine::run()
 {
     Logger::Instance()->log("GameEngine run Start");
-    changeScene("VulkanSceneMenu");
+    if (m_headless)
+    {
+        runHeadless();
+        return;
+    }
+    changeScene(m_startScene);
 
-    SDL_Event event;
+    m_runStart = SDL_GetPerformanceCounter();
+    m_framePacer.start();
 
     while(m_running)
     {
-        auto startTick = SDL_GetTicks();
+        sUserInput();
+        // the jobs that had to wait for the main thread, like the texture uploads
+        m_jobSystem->runMainThreadJobs();
 
-        while (SDL_PollEvent(&event))
+        // update the current scene after input handling, as many fixed steps as the elapsed time covers
+        // every step gets the input that happened before its end, the time until the frame start is in the accumulator
+        while (m_running && m_accumulator >= SIMULATION_STEP)
         {
-            if (event.type == SDL_QUIT)
-                m_running = false;
-            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(m_window))
-                m_running = false;
-            if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_Q)
-                m_running = false;
-            
-            if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
-            {
-                Logger::Instance()->log("SDL Key event Start");
-                Logger::Instance()->logVerbose("SDL_EventType = " + std::to_string(event.type));
-                Logger::Instance()->logVerbose("SDL_Scancode = " + std::to_string(event.key.keysym.scancode));
-                if(event.key.repeat)
-                {
-                    Logger::Instance()->log("SDL Key event Repeat");
-                    continue;
-                }
-                if (currentScene()->getActionMap().find(event.key.keysym.scancode) == currentScene()->getActionMap().end())
-                {
-                    Logger::Instance()->log("SDL Key event NotFound");
-                    continue;
-                }
-                const std::string type = (event.type == SDL_KEYDOWN) ? "START" : "END";
-                currentScene()->doAction(Action(currentScene()->getActionMap()[(event.key.keysym.scancode)], type, event));
-                Logger::Instance()->log("SDL Key event End");
-            }
-            else if (event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_MOUSEBUTTONUP)
-            {
-                Logger::Instance()->log("SDL Mouse Button event Start");
-                Logger::Instance()->logVerbose("SDL_EventType = " + std::to_string(event.type));
-                Logger::Instance()->logVerbose("SDL_MouseButtonEvent = " + std::to_string(event.button.button));
-                if (currentScene()->getActionMap().find(event.button.button) == currentScene()->getActionMap().end())
-                {
-                    Logger::Instance()->log("SDL Mouse Button event NotFound");
-                    continue;
-                }
-                const std::string type = (event.type == SDL_MOUSEBUTTONDOWN) ? "START" : "END";
-                currentScene()->doAction(Action(currentScene()->getActionMap()[(event.button.button)], type, event));
-                Logger::Instance()->log("SDL Mouse Button event End");
-            }
-            else if (event.type == SDL_MOUSEMOTION)
-            {
-                if (currentScene()->getActionMap().find(event.motion.type) == currentScene()->getActionMap().end())
-                {
-                    continue;
-                }
-                const std::string type = "START";
-                currentScene()->doAction(Action(currentScene()->getActionMap()[(event.motion.type)], type, event));
-            }
+            dispatchInput(m_framePacer.frameStart() - m_framePacer.toTicks(m_accumulator - SIMULATION_STEP));
+            step();
+            m_accumulator -= SIMULATION_STEP;
         }
 
-        // update the current scene after input handling
-        currentScene()->update();
+        // the leftover time is drawn as a blend of the last two steps
+        uint64_t renderStart{SDL_GetPerformanceCounter()};
+        currentScene()->sRender((float)(m_accumulator / SIMULATION_STEP));
+        m_renderTicks += SDL_GetPerformanceCounter() - renderStart;
+
+        // wait for the target frame rate, the simulation steps over the whole frame time in the next frame
+        double frameSeconds = m_framePacer.endFrame();
+        m_accumulator += std::min(frameSeconds, MAX_STEPS_PER_FRAME * SIMULATION_STEP);
+        updateFPS(frameSeconds * 1000.0);
+        m_frameCount++;
+    }
+    printRunSummary();
+    Logger::Instance()->log("GameEngine run End");
+}
+
+void GameEngine::runHeadless()
+{
+    // the steps follow each other without waiting and without drawing
+    changeScene(m_startScene);
+    m_runStart = SDL_GetPerformanceCounter();
 
-        // check deltaTime, so we can force the FPS
-        auto endTick = SDL_GetTicks();
-        auto frameLength{endTick - startTick};
-        updateFPS(frameLength);
-        if (frameLength < TICKS_PER_FRAME)
-            SDL_Delay(TICKS_PER_FRAME - (frameLength));
+    while (m_running && (m_stepLimit == 0 || m_stepCount < m_stepLimit))
+    {
+        dispatchInput(UINT64_MAX);
+        step();
     }
+
+    printRunSummary();
     Logger::Instance()->log("GameEngine run End");
 }
 
+void GameEngine::step()
+{
+    uint64_t updateStart{SDL_GetPerformanceCounter()};
+    currentScene()->sSavePreviousState();
+    currentScene()->update();
+    m_updateTicks += SDL_GetPerformanceCounter() - updateStart;
+    m_stepCount++;
+
+    // the input of this step is drawn in this frame, the renderer stamps the rest of the way
+    uint64_t simulated{SDL_GetPerformanceCounter()};
+    for (auto& sample: m_steppedInputs)
+    {
+        sample.time[(int)LATENCY::stage::SIMULATED] = simulated;
+        if (m_vulkanRenderer)
+            m_vulkanRenderer->addInputLatency(sample);
+    }
+    m_steppedInputs.clear();
+
+    if (m_replay.isPlaying() && m_replay.isFinished((uint32_t)m_stepCount))
+        m_running = false;
+}
+
+void GameEngine::printRunSummary()
+{
+    // only for the measured runs, the console is not used otherwise
+    if (!m_headless && m_replay.getMode() == Replay::mode::NONE)
+        return;
+
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    double seconds = (SDL_GetPerformanceCounter() - m_runStart) / frequency;
+    const char* mode{m_replay.isPlaying() ? "replay" : (m_replay.isRecording() ? "record" : "run")};
+    printf("%s %s: %llu steps in %.3f s, %.0f steps per second, %.1f x real time, update %.4f ms per step",
+        m_headless ? "headless" : "window", mode, (unsigned long long)m_stepCount, seconds,
+        m_stepCount / std::max(seconds, 1e-9), m_stepCount * SIMULATION_STEP / std::max(seconds, 1e-9),
+        m_updateTicks * 1000.0 / frequency / std::max<uint64_t>(m_stepCount, 1));
+    if (m_frameCount > 0)
+    {
+        auto stats = m_framePacer.getStats();
+        printf(", render %.4f ms per frame, frame ms p50 %.3f p95 %.3f p99 %.3f",
+            m_renderTicks * 1000.0 / frequency / m_frameCount, stats.p50, stats.p95, stats.p99);
+        auto culling = currentScene()->getCullingStats();
+        printf(", %.1f entities drawn and %.1f culled per frame", culling.submitted, culling.culled);
+    }
+    if (m_vulkanRenderer)
+    {
+        // the cpu and the gpu overlap when the gpu time is not spent waiting for the fence
+        auto times = m_vulkanRenderer->getAverageFrameTimes();
+        printf(", draw %.3f ms waiting for the gpu %.3f ms, gpu %.3f ms, uploaded %.0f bytes per frame, static layer recorded in %.1f%% of the frames, %.1f recorded parts",
+            times.draw, times.fenceWait, times.gpu, times.uploadedBytes, times.staticRecords * 100.0, times.parts);
+    }
+    printf("\n");
+}
+
+bool GameEngine::recordReplay(const std::string& pathToFile)
+{
+    return m_replay.startRecording(pathToFile, m_seed, SIMULATION_HZ, m_startScene);
+}
+
+bool GameEngine::playReplay(const std::string& pathToFile)
+{
+    if (!m_replay.startPlaying(pathToFile))
+        return false;
+    if (m_replay.getSimulationHz() != SIMULATION_HZ)
+        Logger::Instance()->logWarning("GameEngine the replay was recorded with " + std::to_string(m_replay.getSimulationHz())
+            + " steps per second, it will not be the same game");
+    setSeed(m_replay.getSeed());
+    m_startScene = m_replay.getStartScene();
+    return true;
+}
+
+void GameEngine::setSeed(uint32_t seed)
+{
+    m_seed = seed;
+    m_generator.seed(seed);
+}
+
+void GameEngine::sUserInput()
+{
+    SDL_Event event;
+    // SDL stamps the events in ms when they arrive, they are moved to the performance counter so they can be compared with the steps
+    uint64_t now{SDL_GetPerformanceCounter()};
+    Uint32 nowMs{SDL_GetTicks()};
+
+    while (SDL_PollEvent(&event))
+    {
+        if (event.type == SDL_QUIT)
+            m_running = false;
+        if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(m_window))
+            m_running = false;
+        if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_Q)
+            m_running = false;
+        if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_P && !event.key.repeat)
+            nextTargetFps();
+        if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_L && !event.key.repeat)
+        {
+            m_latencyTracker->logReport();
+            m_latencyTracker->reset();
+        }
+
+        ACTION::id name{ACTION::id::NONE};
+        ACTION::type type{ACTION::type::START};
+        int x{0}, y{0};
+        if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
+        {
+            if (event.key.repeat)
+                continue;
+            name = currentScene()->getKeyAction(event.key.keysym.scancode);
+            type = (event.type == SDL_KEYDOWN) ? ACTION::type::START : ACTION::type::END;
+        }
+        else if (event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_MOUSEBUTTONUP)
+        {
+            name = currentScene()->getMouseAction(event.button.button);
+            type = (event.type == SDL_MOUSEBUTTONDOWN) ? ACTION::type::START : ACTION::type::END;
+            x = event.button.x;
+            y = event.button.y;
+        }
+        else if (event.type == SDL_MOUSEMOTION)
+        {
+            name = currentScene()->getMouseMotionAction();
+            x = event.motion.x;
+            y = event.motion.y;
+        }
+        if (name == ACTION::id::NONE)
+            continue;
+
+        Uint32 ageMs{nowMs - event.common.timestamp};
+        if (ageMs > 1000)
+            ageMs = 0;
+        if (!m_inputEvents.push(Action(name, type, now - m_framePacer.toTicks(ageMs / 1000.0), x, y)))
+            Logger::Instance()->logWarning("GameEngine input buffer is full, action dropped");
+    }
+}
+
+void GameEngine::dispatchInput(uint64_t until)
+{
+    // the actions after the end of this step wait for the next one
+    Action action{};
+    if (m_replay.isPlaying())
+    {
+        // the recorded actions of this step instead of the live input
+        while (m_inputEvents.pop(action)) {}
+        while (m_replay.next((uint32_t)m_stepCount, action))
+            currentScene()->doAction(action);
+        return;
+    }
+
+    while (const Action* oldest = m_inputEvents.front())
+    {
+        if (oldest->timestamp() > until)
+            break;
+        m_inputEvents.pop(action);
+        m_replay.record((uint32_t)m_stepCount, action);
+        currentScene()->doAction(action);
+
+        LATENCY::sample sample{};
+        sample.action = action.name();
+        sample.time[(int)LATENCY::stage::INPUT] = action.timestamp();
+        m_steppedInputs.push_back(sample);
+    }
+}
+
 void GameEngine::changeScene(std::string newScene)
 {
     Logger::Instance()->log("GameEngine changeScene Start");
@@ -198,6 +386,9 @@ void GameEngine::changeScene(std::string newScene)
     if (m_currentScene == newScene)
         return;
 
+    // the input is mapped to the actions of the old scene
+    m_inputEvents.clear();
+
     // if we delete here the shared ptr, it will call the destructor of the scene
     Logger::Instance()->logVerbose("GameEngine changeScene 1");
     m_scenes.erase(m_currentScene);
@@ -238,6 +429,8 @@ void GameEngine::changeScene(std::string newScene)
 
 void GameEngine::playSound(const std::string& name)
 {
+    if (m_headless)
+        return;
     Logger::Instance()->log("GameEngine playSound Start");
     Logger::Instance()->logVerbose("sound's name = " + name);
     Mix_Volume(-1, m_soundVolume);
@@ -247,6 +440,8 @@ void GameEngine::playSound(const std::string& name)
 
 void GameEngine::playMusic(const std::string& name)
 {
+    if (m_headless)
+        return;
     Logger::Instance()->log("GameEngine playMusic Start");
     Logger::Instance()->logVerbose("music's name = " + name);
     Mix_VolumeMusic(m_musicVolume);
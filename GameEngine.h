@@ -10,27 +10,49 @@
 #include <string>
 #include <chrono>
 #include <random>
+#include <vector>
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include "Vector.h"
+#include "FramePacer.h"
+#include "Action.h"
+#include "RingBuffer.h"
+#include "Structs.h"
+#include "Replay.h"
 
 class Scene;
 class AssetManager;
 class VulkanRenderer;
+class JobSystem;
+class LatencyTracker;
 
 class GameEngine
 {
 private:
-    double MAXFPS = 60.0;
-    double FPS = MAXFPS;
+    // the P key steps through these, 0: no limit, the FIFO swapchain waits for the vsync anyway
+    const std::vector<double> TARGET_FPS_OPTIONS{0.0, 30.0, 60.0, 120.0, 144.0};
+    FramePacer m_framePacer{};
+    double FPS = 60.0;
     double TICKS_PER_FRAME = 1000.0 / FPS;
+
+    // the scenes are updated with a fixed step, independent of the frame rate; the rendering interpolates between the last two steps
+    double SIMULATION_HZ = 120.0;
+    double SIMULATION_STEP = 1.0 / SIMULATION_HZ;
+    int MAX_STEPS_PER_FRAME = 8; // after a very long frame the simulation drops the time instead of trying to catch up
+    double m_accumulator{0.0};
+    // the input between the polling and the simulation steps, each with its time
+    RingBuffer<Action, 256> m_inputEvents{};
+    // the input handled by the current step, it goes with the frame to the screen; the L key logs the latencies
+    std::vector<LATENCY::sample> m_steppedInputs;
+    std::unique_ptr<LatencyTracker> m_latencyTracker{nullptr};
     int m_windowX{1600}, m_windowY{800};
 
     // main game variables
     bool m_running{true};
     std::map<std::string, std::shared_ptr<Scene>> m_scenes;
     std::shared_ptr<AssetManager> m_am{nullptr};
+    std::unique_ptr<JobSystem> m_jobSystem{nullptr};
     std::string m_currentScene = "NONE";
 
     // SDL variables
@@ -41,13 +63,26 @@ private:
     VulkanRenderer* m_vulkanRenderer{nullptr};
 
     bool SDLRenderer{false};
+    // no window, renderer and audio: the scenes are stepped as fast as the CPU can, for the tests without a display or GPU
+    bool m_headless{false};
+    uint64_t m_stepLimit{0}; // 0: until the game stops
+    uint64_t m_stepCount{0};
+    std::string m_startScene{"VulkanSceneMenu"};
+
+    // the same seed and the same actions in the same steps give the same game again, the timings can be compared
+    Replay m_replay{};
+    uint32_t m_seed{0};
+    uint64_t m_runStart{0}; // performance counter ticks
+    uint64_t m_updateTicks{0};
+    uint64_t m_renderTicks{0};
+    uint64_t m_frameCount{0};
 
     // audio part
     int m_soundVolume{0};
     int m_musicVolume{0};
 
     // random number generators;
-    std::mt19937 m_generator{std::chrono::system_clock::now().time_since_epoch().count()};
+    std::mt19937 m_generator{};
     std::uniform_real_distribution<float> m_uniformDistribution{0.0f, 1.0f};
     std::normal_distribution<float> m_normalDistribution{0.0f, 1.0f};
     std::uniform_real_distribution<float> m_uniformDistributionNegative{-1.0f, 1.0f};
@@ -58,15 +93,23 @@ private:
     std::shared_ptr<Scene> currentScene() { return m_scenes[m_currentScene]; };
     void quit();
     void updateFPS(const double frameLength);
+    void nextTargetFps();
+    void runHeadless();
+    // one simulation step of the current scene
+    void step();
+    void printRunSummary();
 
     // systems
     void sUserInput();
+    // the actions that happened until the given performance counter time go to the current scene
+    void dispatchInput(uint64_t until);
 
 public:
-    GameEngine(){ init(); };
-    ~GameEngine(){ quit(); };
+    GameEngine(bool headless = false): m_headless(headless) { init(); };
+    ~GameEngine();
 
     bool isSDL() { return SDLRenderer; };
+    bool isHeadless() { return m_headless; };
 
     // main public methods
     /// @brief start and run the main loop continuously
@@ -86,6 +129,12 @@ public:
     SDL_Renderer* renderer() { return m_SDLRenderer; };
 
     VulkanRenderer* vulkanRenderer() { return m_vulkanRenderer; };
+    /// @brief get the job system, jobs that call SDL or TTF have to use runOnMainThread
+    /// @return the job system shared by the whole engine
+    JobSystem* jobSystem() { return m_jobSystem.get(); };
+    /// @brief get the latency measurement from the input to the present, only the vulkan renderer feeds it
+    /// @return the tracker with the statistics since the last L key press
+    LatencyTracker* latencyTracker() { return m_latencyTracker.get(); };
 
     /// @brief get that the game is running or not
     /// @return bool shows the game is running
@@ -128,6 +177,36 @@ public:
     /// @brief get the actual fps of the game
     /// @return fps value
     const double getFPS() { return FPS; };
+    /// @brief limit the frame rate
+    /// @param fps frames per second, 0 for no limit
+    void setTargetFps(double fps) { m_framePacer.setTargetFps(fps); };
+    /// @brief get the statistics of the last frames, the percentiles show the stutters
+    /// @return frame length statistics in ms
+    FramePacer::frameStats getFrameStats() { return m_framePacer.getStats(); };
+    /// @brief get the length of one simulation step, every scene update moves the game with this much time
+    /// @return step length in seconds
+    double getSimulationStep() { return SIMULATION_STEP; };
+    /// @brief stop the headless run after this many simulation steps
+    /// @param steps 0 for no limit
+    void setStepLimit(uint64_t steps) { m_stepLimit = steps; };
+    /// @brief get the number of simulation steps of the headless run
+    /// @return steps since the start
+    uint64_t getStepCount() { return m_stepCount; };
+
+    // replay
+    /// @brief write the seed and every action to a file until the game quits, call it before run
+    /// @param pathToFile the recording, it is overwritten
+    /// @return false if the file cannot be opened
+    bool recordReplay(const std::string& pathToFile);
+    /// @brief play a recording instead of the live input, the game stops after its last step; call it before run
+    /// @param pathToFile a file written by recordReplay
+    /// @return false if the file cannot be opened or read
+    bool playReplay(const std::string& pathToFile);
+    /// @brief seed the random generators, the scenes get their seeds from nextSeed
+    void setSeed(uint32_t seed);
+    /// @brief get a seed for a random generator of a scene, the same after the same engine seed
+    /// @return random 32 bit number
+    uint32_t nextSeed() { return (uint32_t)m_generator(); };
 
     /// @brief Render a given text to the screen
     void renderText(const std::string& textToRender, TTF_Font* font, const SDL_Color& color, int fontSize, const MATH::Vec2& pos);
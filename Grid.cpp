@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <queue>
 #include "Logger.h"
+#include "FieldOfView.h"
 
 int Grid::calculateIdx(const intPair& location)
 {
@@ -53,6 +54,7 @@ void Grid::createGrid(std::shared_ptr<EntityManager> entityManager)
 
     m_grid.resize(m_rowNumber, std::vector<entityPtr>(m_columnNumber));
     m_gridJustBricks.resize(m_rowNumber, std::vector<entityPtr>(m_columnNumber));
+    m_wallMask.assign(m_rowNumber * m_columnNumber, WALL_NORTH | WALL_WEST);
     float halfW = m_width/2.f;
     float halfH = m_heigth/2.f;
 
@@ -66,7 +68,7 @@ void Grid::createGrid(std::shared_ptr<EntityManager> entityManager)
             brickNode->addComponent<CTransform>(MATH::Vec2{j*m_width + halfW, i*m_heigth + halfH});
             brickNode->addComponent<CRectBody>(m_width, m_heigth);
             brickNode->addComponent<CState>();
-            brickNode->addComponent<CShape2d>("rectangleVertex", "rectangleIndex");
+            brickNode->addComponent<CShape2d>("rectangleVertex", "rectangleIndex", 0, true);
             brickNode->addComponent<CTexture>("brick");
             m_gridJustBricks[j][i] = brickNode;
 
@@ -77,7 +79,7 @@ void Grid::createGrid(std::shared_ptr<EntityManager> entityManager)
             oneNode->addComponent<CAABB>(m_width, m_heigth);
             oneNode->addComponent<CState>();
             oneNode->addComponent<CNode>(j, i, id);
-            oneNode->addComponent<CShape2d>("wallsVertex", "wallsNoneIndex");
+            oneNode->addComponent<CShape2d>("wallsVertex", "wallsNoneIndex", 1, true);
             oneNode->addComponent<CWalls>();
 
             m_grid[j][i] = oneNode;
@@ -87,6 +89,14 @@ void Grid::createGrid(std::shared_ptr<EntityManager> entityManager)
     }
 }
 
+int Grid::getCellIdx(const MATH::Vec2 &pos)
+{
+    int x = std::clamp((int)(pos.x / m_width), 0, m_rowNumber - 1);
+    int y = std::clamp((int)(pos.y / m_heigth), 0, m_columnNumber - 1);
+
+    return calculateIdx(intPair(x, y));
+}
+
 nodes Grid::getEntityAt(const MATH::Vec2 &pos)
 {
     nodes res{};
@@ -212,27 +222,31 @@ void Grid::generateMaze()
             if (node.xDir == -1)
             {
                 walls.west = false;
-                shape.indexName = whichWall(startEntity);
+                m_wallMask[node.id] &= ~WALL_WEST;
+                shape.setIndexName(whichWall(startEntity));
                 node.scores[0][1] = 0;
             }
             else if (node.yDir == -1)
             {
                 walls.north = false;
-                shape.indexName = whichWall(startEntity);
+                m_wallMask[node.id] &= ~WALL_NORTH;
+                shape.setIndexName(whichWall(startEntity));
                 node.scores[1][0] = 0;
             }
             else if (node.xDir == 1)
             {
                 auto nextEntity = getEntityAt(node.row + 1, node.column);
                 nextEntity->getComponent<CWalls>().west = false;
-                nextEntity->getComponent<CShape2d>().indexName = whichWall(nextEntity);
+                m_wallMask[nextEntity->getComponent<CNode>().id] &= ~WALL_WEST;
+                nextEntity->getComponent<CShape2d>().setIndexName(whichWall(nextEntity));
                 node.scores[2][1] = 0;
             }
             else if (node.yDir == 1)
             {
                 auto nextEntity = getEntityAt(node.row, node.column + 1);
                 nextEntity->getComponent<CWalls>().north = false;
-                nextEntity->getComponent<CShape2d>().indexName = whichWall(nextEntity);
+                m_wallMask[nextEntity->getComponent<CNode>().id] &= ~WALL_NORTH;
+                nextEntity->getComponent<CShape2d>().setIndexName(whichWall(nextEntity));
                 node.scores[1][2] = 0;
             }
 
@@ -252,6 +266,45 @@ void Grid::generateMaze()
     }
 }
 
+void Grid::showCellWalls(bool show)
+{
+    for (auto& row: m_grid)
+    {
+        for (auto& entity: row)
+        {
+            if (show)
+                entity->addComponent<CShape2d>("wallsVertex", whichWall(entity), 1, true);
+            else
+                entity->removeComponent<CShape2d>();
+        }
+    }
+}
+
+void Grid::hideUnseenCells(const FieldOfView& fieldOfView)
+{
+    for (int x = 0; x < m_rowNumber; x++)
+    {
+        for (int y = 0; y < m_columnNumber; y++)
+        {
+            int idx{calculateIdx(intPair(x, y))};
+            m_gridJustBricks[x][y]->getComponent<CState>().hidden = !fieldOfView.isVisible(idx);
+            m_grid[x][y]->getComponent<CState>().hidden = !fieldOfView.isExplored(idx);
+        }
+    }
+}
+
+void Grid::showAllCells()
+{
+    for (int x = 0; x < m_rowNumber; x++)
+    {
+        for (int y = 0; y < m_columnNumber; y++)
+        {
+            m_gridJustBricks[x][y]->getComponent<CState>().hidden = false;
+            m_grid[x][y]->getComponent<CState>().hidden = false;
+        }
+    }
+}
+
 entityPtr Grid::getRandomEntityFromGrid(std::vector<nodes>& grid)
 {
     for (auto& row: grid)
@@ -280,4 +333,5 @@ std::string Grid::whichWall(entityPtr entity)
     {
         return "wallsWestIndex";
     }
+    return "wallsNoneIndex";
 }
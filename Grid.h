@@ -10,6 +10,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <cstdint>
 #include "Entity.h"
 
 #include <chrono>
@@ -17,6 +18,7 @@
 
 class Entity;
 class EntityManager;
+class FieldOfView;
 
 using intPair = std::pair<int,int>;
 using intUMap = std::unordered_map<int, int>;
@@ -34,12 +36,18 @@ public:
 
 class Grid
 {
+public:
+    // bits of the wall mask, one byte per cell; same meaning as the CWalls component
+    static constexpr uint8_t WALL_NORTH{1};
+    static constexpr uint8_t WALL_WEST{2};
+
 private:
     std::mt19937 m_generator{std::chrono::system_clock::now().time_since_epoch().count()};
     std::uniform_real_distribution<float> m_uniformDistribution{0.0f, 1.0f};
 
     std::vector<nodes> m_grid;
     std::vector<nodes> m_gridJustBricks;
+    std::vector<uint8_t> m_wallMask; // indexed like the CNode id
     entityPtr m_startEntity;
     entityPtr m_targetEntity;
 
@@ -78,6 +86,8 @@ public:
     };
 
     void createGrid(std::shared_ptr<EntityManager> entityManager);
+    // the maze generation gives the same maze after the same seed
+    void setSeed(uint32_t seed) { m_generator.seed(seed); };
 
     entityPtr getStartEntity() { return m_startEntity; };
     entityPtr getTargetEntity() { return m_targetEntity; };
@@ -95,14 +105,26 @@ public:
     entityPtr getEntityAt(int idx) { intPair loc{calculateGridLocation(idx)}; return m_grid[loc.first][loc.second]; };
     entityPtr getEntityAt(intPair location) { return m_grid[location.first][location.second]; };
     entityPtr getEntityAt(int x, int y) { return m_grid[x][y]; };
-    entityPtr getEntityAt(float xCoord, float yCoord) { return m_grid[(int)(xCoord / m_width)][(int)(yCoord / m_heigth)]; };
+    entityPtr getEntityAt(float xCoord, float yCoord) { return getEntityAt(getCellIdx(MATH::Vec2{xCoord, yCoord})); };
     nodes getEntityAt(const MATH::Vec2& pos);
+    int getCellIdx(const MATH::Vec2& pos);
+
+    const std::vector<uint8_t>& getWallMask() { return m_wallMask; };
+    int getRowNumber() { return m_rowNumber; };
+    int getColumnNumber() { return m_columnNumber; };
+    float getCellWidth() { return m_width; };
+    float getCellHeight() { return m_heigth; };
 
     std::vector<entityPtr> getNeighbors(int idx);
 
     void calculateAStar(entityPtr startEntity, entityPtr targetEntity, std::vector<int>& res);
 
     void generateMaze();
+    // per cell wall shapes on/off; off when the walls are drawn from one baked mesh
+    void showCellWalls(bool show);
+    // fog of war: the bricks are drawn in the visible cells, the walls in the explored ones, nothing in the rest
+    void hideUnseenCells(const FieldOfView& fieldOfView);
+    void showAllCells();
 
 };
 
@@ -0,0 +1,394 @@
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600 // ucontext is only declared with it on macOS
+#endif
+#include "JobSystem.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ucontext.h>
+#endif
+
+struct JobSystem::fiber
+{
+#ifdef _WIN32
+    void* handle{nullptr};
+#else
+    ucontext_t context{};
+    std::unique_ptr<char[]> stack; // not cleared, the pages are only touched when the stack grows
+#endif
+    job current;
+    bool done{false};
+    counter* waitingOn{nullptr};
+};
+
+struct JobSystem::threadData
+{
+#ifdef _WIN32
+    void* scheduler{nullptr};
+#else
+    ucontext_t scheduler{};
+#endif
+    fiber* running{nullptr};
+    bool mainThread{false};
+    std::vector<char> memory;
+    size_t used{0};
+};
+
+// a fiber can continue on another thread after a wait, so the compiler must not keep the address of the thread local between two calls
+static thread_local JobSystem::threadData* t_thread{nullptr};
+
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+static JobSystem::threadData* threadLocalData()
+{
+    return t_thread;
+}
+
+// switches from the scheduler of the thread to the fiber and back when it finished or waits
+static void switchToFiber(JobSystem::threadData* thread, JobSystem::fiber* f)
+{
+    thread->running = f;
+#ifdef _WIN32
+    SwitchToFiber(f->handle);
+#else
+    swapcontext(&thread->scheduler, &f->context);
+#endif
+}
+
+static void switchToScheduler(JobSystem::fiber* f)
+{
+    JobSystem::threadData* thread{threadLocalData()};
+    thread->running = nullptr;
+#ifdef _WIN32
+    (void)f;
+    SwitchToFiber(thread->scheduler);
+#else
+    swapcontext(&f->context, &thread->scheduler);
+#endif
+}
+
+// a new fiber starts here and stays in the loop, a finished job only switches away and the next job continues it
+#ifdef _WIN32
+static void __stdcall fiberStart(void*)
+#else
+static void fiberStart()
+#endif
+{
+    while (true)
+    {
+        JobSystem::fiber* f{threadLocalData()->running};
+        f->current.function();
+        f->done = true;
+        switchToScheduler(f);
+    }
+}
+
+JobSystem::JobSystem(int workerCount)
+{
+    if (workerCount < 1)
+        workerCount = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+
+    m_mainThreadId = std::this_thread::get_id();
+    registerThread(true);
+
+    for (int i = 0; i < workerCount; i++)
+        m_threads.push_back(std::make_unique<threadData>());
+    for (int i = 0; i < workerCount; i++)
+    {
+        threadData* thread{m_threads[i + 1].get()};
+        m_workers.emplace_back([this, thread]()
+        {
+            t_thread = thread;
+            workerLoop();
+        });
+    }
+    Logger::Instance()->logInfo("JobSystem: " + std::to_string(workerCount) + " worker threads");
+}
+
+JobSystem::~JobSystem()
+{
+    // the jobs already started are finished first, so nothing waits on a counter of a destroyed owner
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            if (m_jobs.empty() && m_mainJobs.empty() && m_readyFibers.empty() && m_readyMainFibers.empty() && m_waitingFibers.empty()
+                && m_freeFibers.size() == m_fibers.size())
+                break;
+        }
+        if (!runOne(true) && !runOne(false))
+            std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_running = false;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker: m_workers)
+        worker.join();
+
+#ifdef _WIN32
+    for (auto& f: m_fibers)
+        DeleteFiber(f->handle);
+#endif
+    t_thread = nullptr;
+}
+
+JobSystem::threadData* JobSystem::registerThread(bool mainThread)
+{
+    auto data = std::make_unique<threadData>();
+    threadData* thread{data.get()};
+    thread->mainThread = mainThread;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_threads.push_back(std::move(data));
+    }
+    t_thread = thread;
+    return thread;
+}
+
+JobSystem::threadData* JobSystem::currentThread()
+{
+    threadData* thread{threadLocalData()};
+#ifdef _WIN32
+    // every thread that switches to a fiber has to be a fiber itself
+    if (thread && !thread->scheduler)
+        thread->scheduler = IsThreadAFiber() ? GetCurrentFiber() : ConvertThreadToFiber(nullptr);
+#endif
+    return thread;
+}
+
+JobSystem::fiber* JobSystem::acquireFiber()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_freeFibers.empty())
+    {
+        fiber* f{m_freeFibers.back()};
+        m_freeFibers.pop_back();
+        return f;
+    }
+
+    m_fibers.push_back(std::make_unique<fiber>());
+    fiber* f{m_fibers.back().get()};
+#ifdef _WIN32
+    f->handle = CreateFiber(m_fiberStackSize, fiberStart, nullptr);
+#else
+    f->stack.reset(new char[m_fiberStackSize]);
+    getcontext(&f->context);
+    f->context.uc_stack.ss_sp = f->stack.get();
+    f->context.uc_stack.ss_size = m_fiberStackSize;
+    f->context.uc_link = nullptr;
+    makecontext(&f->context, fiberStart, 0);
+#endif
+    return f;
+}
+
+bool JobSystem::runOne(bool mainThread)
+{
+    threadData* thread{currentThread()};
+    if (!thread || thread->running)
+        return false;
+
+    fiber* f{nullptr};
+    job next{};
+    bool newJob{false};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        // the fibers that waited come first, they hold up the jobs that wait for them
+        auto& ready = mainThread ? m_readyMainFibers : m_readyFibers;
+        auto& jobs = mainThread ? m_mainJobs : m_jobs;
+        if (!ready.empty())
+        {
+            f = ready.front();
+            ready.pop_front();
+        }
+        else if (!jobs.empty())
+        {
+            next = std::move(jobs.front());
+            jobs.pop_front();
+            newJob = true;
+        }
+        else
+            return false;
+    }
+
+    if (newJob)
+    {
+        f = acquireFiber();
+        f->current = std::move(next);
+        f->done = false;
+    }
+
+    switchToFiber(thread, f);
+
+    if (f->done)
+        finished(f);
+    else
+        park(f);
+    return true;
+}
+
+void JobSystem::finished(fiber* f)
+{
+    counter* done{f->current.done};
+    f->current.function = nullptr;
+    if (done && done->fetch_sub(1, std::memory_order_acq_rel) == 1)
+        wakeWaiting(done);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_freeFibers.push_back(f);
+}
+
+void JobSystem::park(fiber* f)
+{
+    // the fiber is already switched away, it can be continued by any thread from here
+    bool notify{false};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        // the counter may have reached 0 since the fiber checked it, wakeWaiting takes the same lock after the decrement
+        if (f->waitingOn->load(std::memory_order_acquire) == 0)
+        {
+            (f->current.mainThread ? m_readyMainFibers : m_readyFibers).push_back(f);
+            notify = true;
+        }
+        else
+            m_waitingFibers.push_back(f);
+    }
+    if (notify)
+        m_workAvailable.notify_one();
+}
+
+void JobSystem::wakeWaiting(counter* done)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        auto waiting = std::partition(m_waitingFibers.begin(), m_waitingFibers.end(), [done](fiber* f) { return f->waitingOn != done; });
+        for (auto it = waiting; it != m_waitingFibers.end(); ++it)
+            ((*it)->current.mainThread ? m_readyMainFibers : m_readyFibers).push_back(*it);
+        m_waitingFibers.erase(waiting, m_waitingFibers.end());
+    }
+    m_workAvailable.notify_all();
+}
+
+void JobSystem::workerLoop()
+{
+    while (true)
+    {
+        if (runOne(false))
+            continue;
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_workAvailable.wait(lock, [this]() { return !m_running || !m_jobs.empty() || !m_readyFibers.empty(); });
+        if (!m_running)
+            return;
+    }
+}
+
+void JobSystem::run(std::function<void()> function, counter* done)
+{
+    if (done)
+        done->fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_jobs.push_back(job{std::move(function), done, false});
+    }
+    m_workAvailable.notify_one();
+}
+
+void JobSystem::runOnMainThread(std::function<void()> function, counter* done)
+{
+    if (done)
+        done->fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_mainJobs.push_back(job{std::move(function), done, true});
+}
+
+void JobSystem::wait(counter& done)
+{
+    if (done.load(std::memory_order_acquire) == 0)
+        return;
+
+    threadData* thread{currentThread()};
+    if (thread && thread->running)
+    {
+        fiber* f{thread->running};
+        f->waitingOn = &done;
+        switchToScheduler(f);
+        // may be another thread from here
+        f->waitingOn = nullptr;
+        return;
+    }
+
+    // not in a job, the thread helps until the counter is 0; any other thread becomes a helper the first time, e.g. the render thread
+    if (!thread)
+        thread = registerThread(false);
+    bool mainThread{thread->mainThread};
+    while (done.load(std::memory_order_acquire) != 0)
+    {
+        if (mainThread && runOne(true))
+            continue;
+        if (runOne(false))
+            continue;
+        // the main thread jobs are added without a notify, the main thread keeps looking for them
+        if (mainThread)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        // the others sleep until there is a job to run or the last job of the counter finished, wakeWaiting notifies then
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_workAvailable.wait(lock, [this, &done]() { return done.load(std::memory_order_acquire) == 0 || !m_jobs.empty() || !m_readyFibers.empty(); });
+    }
+}
+
+void JobSystem::runMainThreadJobs()
+{
+    if (!isMainThread())
+        return;
+    // only the ones there now, a main thread job that adds another one does not keep the frame here
+    size_t count{0};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        count = m_mainJobs.size() + m_readyMainFibers.size();
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!runOne(true))
+            break;
+    }
+}
+
+void* JobSystem::allocate(size_t size, size_t alignment)
+{
+    threadData* thread{threadLocalData()};
+    if (!thread)
+        return nullptr;
+    if (thread->memory.empty())
+        thread->memory.resize(m_allocatorSize);
+
+    uintptr_t base{(uintptr_t)thread->memory.data()};
+    uintptr_t start{(base + thread->used + alignment - 1) & ~(uintptr_t)(alignment - 1)};
+    if (start + size > base + thread->memory.size())
+    {
+        Logger::Instance()->logWarning("JobSystem: the allocator of the thread is full");
+        return nullptr;
+    }
+    thread->used = start + size - base;
+    return (void*)start;
+}
+
+void JobSystem::resetAllocators()
+{
+    // a helper thread can register meanwhile
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (auto& thread: m_threads)
+        thread->used = 0;
+}
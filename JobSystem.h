@@ -0,0 +1,99 @@
+/// used sources from the internet:
+/// https://www.gdcvault.com/play/1022186/Parallelizing-the-Naughty-Dog-Engine
+/// https://man7.org/linux/man-pages/man3/makecontext.3.html
+/// https://learn.microsoft.com/en-us/windows/win32/procthread/fibers
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+// jobs run on fibers spread over worker threads, a job can wait for other jobs without blocking its worker:
+// the waiting fiber is put aside and the worker picks up another job, the fiber continues when the counter reaches 0
+// the main thread jobs are only run by the main thread, for the SDL and TTF calls that are not allowed from other threads
+// only one JobSystem should exist, the threads find their own data through a thread local pointer
+class JobSystem
+{
+public:
+    // the number of jobs still running, wait returns when it is 0
+    using counter = std::atomic<int>;
+
+    struct fiber;
+    struct threadData;
+
+private:
+    struct job
+    {
+        std::function<void()> function;
+        counter* done{nullptr};
+        bool mainThread{false};
+    };
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<threadData>> m_threads; // the workers, the main thread and the helpers, added under m_mutex
+    std::vector<std::unique_ptr<fiber>> m_fibers;
+    std::vector<fiber*> m_freeFibers;
+    bool m_running{true};
+
+    // guarded by m_mutex
+    std::deque<job> m_jobs;
+    std::deque<job> m_mainJobs;
+    std::deque<fiber*> m_readyFibers; // were waiting, their counter is 0 now
+    std::deque<fiber*> m_readyMainFibers;
+    std::vector<fiber*> m_waitingFibers;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+
+    const size_t m_fiberStackSize{256 * 1024};
+    const size_t m_allocatorSize{1024 * 1024};
+    std::thread::id m_mainThreadId;
+
+    threadData* currentThread();
+    threadData* registerThread(bool mainThread);
+    fiber* acquireFiber();
+    // runs one job or continues one waiting fiber; false if there was nothing to do
+    bool runOne(bool mainThread);
+    void finished(fiber* f);
+    void park(fiber* f);
+    void wakeWaiting(counter* done);
+    void workerLoop();
+
+public:
+    // workerCount < 1: one less than the cores, the main thread is the last one
+    JobSystem(int workerCount = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // done is incremented now and decremented when the function returned, one counter can track many jobs
+    void run(std::function<void()> function, counter* done = nullptr);
+    // the same, only the main thread runs it, in runMainThreadJobs or while it waits
+    void runOnMainThread(std::function<void()> function, counter* done = nullptr);
+
+    // in a job: the fiber waits and the worker does other jobs meanwhile
+    // outside of a job: the thread runs jobs until the counter is 0, the main thread runs the main thread jobs too
+    // a thread that is neither a worker nor the main thread is registered as a helper on its first wait, it runs the jobs
+    // the same way and sleeps on the condition variable when the rest of its jobs are on the workers; it has to end before the JobSystem
+    void wait(counter& done);
+
+    // the main thread calls it once per frame
+    void runMainThreadJobs();
+
+    // memory from the calling thread's own linear allocator, no lock and no free; it is valid until resetAllocators
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    // only when no job is running, e.g. at the end of the frame
+    void resetAllocators();
+
+    int getWorkerCount() const { return (int)m_workers.size(); };
+    bool isMainThread() const { return std::this_thread::get_id() == m_mainThreadId; };
+};
+
+#endif
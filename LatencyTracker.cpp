@@ -0,0 +1,130 @@
+#include "LatencyTracker.h"
+#include "Logger.h"
+#include <SDL.h>
+#include <algorithm>
+
+LatencyTracker::LatencyTracker()
+{
+    m_frequency = SDL_GetPerformanceFrequency();
+}
+
+LatencyTracker::~LatencyTracker()
+{
+    if (m_csv.is_open())
+        m_csv.close();
+}
+
+bool LatencyTracker::openCsv(const std::string& pathToFile)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_csv.open(pathToFile, std::ios::out | std::ios::trunc);
+    if (!m_csv.is_open())
+    {
+        Logger::Instance()->logError("LatencyTracker: cannot open the file: " + pathToFile);
+        return false;
+    }
+    m_csv << "action";
+    for (int s = (int)LATENCY::stage::SIMULATED; s < (int)LATENCY::stage::COUNT; s++)
+        m_csv << "," << stageName((LATENCY::stage)s) << "_ms";
+    m_csv << "\n";
+    return true;
+}
+
+void LatencyTracker::add(const std::vector<LATENCY::sample>& samples)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& sample: samples)
+    {
+        uint64_t input{sample.time[(int)LATENCY::stage::INPUT]};
+        if (m_csv.is_open())
+            m_csv << (int)sample.action;
+
+        for (int s = (int)LATENCY::stage::SIMULATED; s < (int)LATENCY::stage::COUNT; s++)
+        {
+            // an input stamped a little after the step started is counted as 0
+            double ms{sample.time[s] > input ? toMs(sample.time[s] - input) : 0.0};
+            auto& stage = m_stages[s];
+            stage.count++;
+            stage.max = std::max(stage.max, ms);
+            stage.histogram[std::min((int)ms, BUCKETS - 1)]++;
+            m_sums[s] += ms;
+            if (m_csv.is_open())
+                m_csv << "," << ms;
+        }
+        if (m_csv.is_open())
+            m_csv << "\n";
+    }
+}
+
+LatencyTracker::stageStats LatencyTracker::getStats(LATENCY::stage stage)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stageStats res{m_stages[(int)stage]};
+    if (res.count == 0)
+        return res;
+    res.average = m_sums[(int)stage] / res.count;
+
+    // the upper end of the bucket of the nearest rank, not more than the largest one seen
+    auto percentile = [&](double p)
+    {
+        size_t rank = std::max<size_t>((size_t)(p * res.count + 0.999999), 1);
+        size_t seen{0};
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            seen += res.histogram[i];
+            if (seen >= rank)
+                return std::min((double)(i + 1), res.max);
+        }
+        return res.max;
+    };
+    res.p50 = percentile(0.50);
+    res.p95 = percentile(0.95);
+    res.p99 = percentile(0.99);
+    return res;
+}
+
+void LatencyTracker::logReport()
+{
+    for (int s = (int)LATENCY::stage::SIMULATED; s < (int)LATENCY::stage::COUNT; s++)
+    {
+        auto stats = getStats((LATENCY::stage)s);
+        Logger::Instance()->logInfo("LatencyTracker input to " + std::string(stageName((LATENCY::stage)s))
+            + " events: " + std::to_string(stats.count) + " ms average: " + std::to_string(stats.average)
+            + " p50: " + std::to_string(stats.p50) + " p95: " + std::to_string(stats.p95)
+            + " p99: " + std::to_string(stats.p99) + " max: " + std::to_string(stats.max));
+    }
+
+    // only the buckets with events, as "from ms: count"
+    auto presented = getStats(LATENCY::stage::PRESENTED);
+    std::string histogram{};
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        if (presented.histogram[i] > 0)
+            histogram += " " + std::to_string(i) + ": " + std::to_string(presented.histogram[i]);
+    }
+    Logger::Instance()->logInfo("LatencyTracker input to presented (drawn by the GPU) histogram in ms:" + histogram);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_csv.is_open())
+        m_csv.flush();
+}
+
+void LatencyTracker::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stages = {};
+    m_sums = {};
+}
+
+const char* LatencyTracker::stageName(LATENCY::stage stage)
+{
+    switch (stage)
+    {
+    case LATENCY::stage::INPUT: return "input";
+    case LATENCY::stage::SIMULATED: return "simulated";
+    case LATENCY::stage::RECORDED: return "recorded";
+    case LATENCY::stage::SUBMITTED: return "submitted";
+    case LATENCY::stage::PRESENTED: return "presented";
+    default: return "unknown";
+    }
+}
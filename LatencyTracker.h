@@ -0,0 +1,63 @@
+/// used sources from the internet:
+/// https://wiki.libsdl.org/SDL2/SDL_GetPerformanceCounter
+
+#ifndef LATENCYTRACKER_H
+#define LATENCYTRACKER_H
+
+#include <array>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Structs.h"
+
+// collects the input events that reached the screen, with the time of every stage from the input
+// each stage has a histogram with 1 ms buckets, the percentiles are read from it; the CSV has one line per event
+// the render thread adds the samples, so every method locks
+// the presented stage is when the GPU finished the frame, not the scan out, see LATENCY::stage
+class LatencyTracker
+{
+public:
+    static constexpr int BUCKETS{100}; // the last one counts everything from 99 ms
+
+    struct stageStats
+    {
+        size_t count{0};
+        double average{0.0}; // ms from the input
+        double p50{0.0};
+        double p95{0.0};
+        double p99{0.0};
+        double max{0.0};
+        std::array<uint32_t, BUCKETS> histogram{};
+    };
+
+private:
+    std::mutex m_mutex;
+    uint64_t m_frequency{1};
+    std::array<stageStats, (int)LATENCY::stage::COUNT> m_stages{};
+    std::array<double, (int)LATENCY::stage::COUNT> m_sums{};
+    std::ofstream m_csv;
+
+    double toMs(uint64_t ticks) const { return (double)ticks * 1000.0 / m_frequency; };
+
+public:
+    LatencyTracker();
+    ~LatencyTracker();
+
+    // every finished sample is written to the file from now on, false if it can not be opened
+    bool openCsv(const std::string& pathToFile);
+
+    // the samples with every stage stamped
+    void add(const std::vector<LATENCY::sample>& samples);
+
+    // since the last reset, the INPUT stage is empty
+    stageStats getStats(LATENCY::stage stage);
+    // the percentiles of every stage and the histogram of the presented one to the log
+    void logReport();
+    void reset();
+
+    static const char* stageName(LATENCY::stage stage);
+};
+
+#endif
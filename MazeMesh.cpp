@@ -0,0 +1,92 @@
+#include "MazeMesh.h"
+#include "Grid.h"
+
+uint32_t MazeMesh::addVertex(int latticeX, int latticeY, float x, float y)
+{
+    uint64_t key = ((uint64_t)(uint32_t)latticeX << 32) | (uint32_t)latticeY;
+    auto it = m_vertexLookup.find(key);
+    if (it != m_vertexLookup.end())
+        return it->second;
+
+    uint32_t idx = m_vertices.size();
+    // position in the [-1, 1] space of the grid rectangle, texture coordinates in [0, 1]
+    float u = x / m_gridWidth;
+    float v = y / m_gridHeight;
+    m_vertices.push_back(MATH::Vec4{u * 2.f - 1.f, v * 2.f - 1.f, u, v});
+    m_vertexLookup.insert({key, idx});
+    return idx;
+}
+
+void MazeMesh::addQuad(int x0, int y0, int x1, int y1, float left, float top, float right, float bottom)
+{
+    uint32_t topLeft = addVertex(x0, y0, left, top);
+    uint32_t topRight = addVertex(x1, y0, right, top);
+    uint32_t bottomLeft = addVertex(x0, y1, left, bottom);
+    uint32_t bottomRight = addVertex(x1, y1, right, bottom);
+
+    // same winding as the 2dWalls index files
+    m_indices.insert(m_indices.end(), {topRight, topLeft, bottomLeft, bottomLeft, bottomRight, topRight});
+}
+
+void MazeMesh::bake(const std::vector<uint8_t>& walls, int rowNumber, int columnNumber, float cellWidth, float cellHeight)
+{
+    m_vertices.clear();
+    m_indices.clear();
+    m_vertexLookup.clear();
+    m_gridWidth = rowNumber * cellWidth;
+    m_gridHeight = columnNumber * cellHeight;
+
+    // the wallsVertex mesh has 0.1 wide walls in the [-1, 1] space of the cell
+    float thicknessX = cellWidth * 0.05f;
+    float thicknessY = cellHeight * 0.05f;
+
+    // lattice coordinate 2 * i is the cell border, 2 * i + 1 is the cell border + wall thickness
+    // north walls: horizontal runs in every row
+    for (int y = 0; y < columnNumber; y++)
+    {
+        int x = 0;
+        while (x < rowNumber)
+        {
+            if (!(walls[x + y * rowNumber] & Grid::WALL_NORTH))
+            {
+                x++;
+                continue;
+            }
+            int start = x;
+            while (x < rowNumber && (walls[x + y * rowNumber] & Grid::WALL_NORTH))
+                x++;
+            addQuad(2 * start, 2 * y, 2 * x, 2 * y + 1, start * cellWidth, y * cellHeight, x * cellWidth, y * cellHeight + thicknessY);
+        }
+    }
+
+    // west walls: vertical runs in every column
+    for (int x = 0; x < rowNumber; x++)
+    {
+        int y = 0;
+        while (y < columnNumber)
+        {
+            if (!(walls[x + y * rowNumber] & Grid::WALL_WEST))
+            {
+                y++;
+                continue;
+            }
+            int start = y;
+            while (y < columnNumber && (walls[x + y * rowNumber] & Grid::WALL_WEST))
+                y++;
+            addQuad(2 * x, 2 * start, 2 * x + 1, 2 * y, x * cellWidth, start * cellHeight, x * cellWidth + thicknessX, y * cellHeight);
+        }
+    }
+}
+
+int MazeMesh::perCellTriangleCount(const std::vector<uint8_t>& walls)
+{
+    int res{0};
+    for (auto cell: walls)
+    {
+        if (cell & Grid::WALL_NORTH)
+            res += 2;
+        if (cell & Grid::WALL_WEST)
+            res += 2;
+    }
+    return res;
+}
@@ -0,0 +1,40 @@
+#ifndef MAZEMESH_H
+#define MAZEMESH_H
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "Vector.h"
+
+// bakes every wall of a maze into one vertex and index buffer, so the whole maze is one draw call
+// the walls next to each other in the same line are merged into one quad, the shared corners are stored only once
+// the vertices are in the [-1, 1] space of a rectangle that covers the whole grid, the same as the 2d vertex files
+class MazeMesh
+{
+private:
+    std::vector<MATH::Vec4> m_vertices;
+    std::vector<uint32_t> m_indices;
+    std::unordered_map<uint64_t, uint32_t> m_vertexLookup;
+
+    float m_gridWidth{0.f};
+    float m_gridHeight{0.f};
+
+    // the corners are on a lattice: cell border or cell border + wall thickness, so they can be keyed with integers
+    uint32_t addVertex(int latticeX, int latticeY, float x, float y);
+    void addQuad(int x0, int y0, int x1, int y1, float left, float top, float right, float bottom);
+
+public:
+    MazeMesh() {};
+
+    void bake(const std::vector<uint8_t>& walls, int rowNumber, int columnNumber, float cellWidth, float cellHeight);
+
+    const std::vector<MATH::Vec4>& getVertices() { return m_vertices; };
+    const std::vector<uint32_t>& getIndices() { return m_indices; };
+    int getTriangleCount() { return m_indices.size() / 3; };
+
+    // how many triangles the wallsVertex + walls*Index per cell drawing needs for the same maze
+    static int perCellTriangleCount(const std::vector<uint8_t>& walls);
+
+};
+
+#endif
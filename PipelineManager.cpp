@@ -2,6 +2,7 @@
 #include "DeviceHandler.h"
 #include "Logger.h"
 #include <iostream>
+#include <algorithm>
 
 PipelineManager::PipelineManager(DeviceHandler *de)
     : m_deviceHandler(de)
@@ -10,6 +11,7 @@ PipelineManager::PipelineManager(DeviceHandler *de)
     m_checkVkResult = std::bind(&DeviceHandler::checkVkResult, m_deviceHandler, std::placeholders::_1);
 
     createBaseDescriptorSetLayouts();
+    createTextureArrayDescriptorSet();
     createBasePipelineLayouts();
 }
 
@@ -205,6 +207,38 @@ VkPipelineLayout& PipelineManager::createGraphicsPipeline(
     return m_pipelineLayout[pipelineLayoutName];
 }
 
+VkPipelineLayout& PipelineManager::createComputePipeline(
+    VkPipeline& newPipeline,
+    const std::string& name,
+    const std::string& pipelineLayoutName,
+    const std::string& compPath
+    )
+{
+    if (m_pipelines.find(name) == m_pipelines.end())
+        m_pipelines.insert({name, pipelineInfo{}});
+
+    VkShaderModule compShader = createShaderModule(compPath);
+    m_pipelines[name].compShaderPath = compPath;
+
+    VkPipelineShaderStageCreateInfo compShaderCreateInfo{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    compShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    compShaderCreateInfo.module = compShader;
+    compShaderCreateInfo.pName = "main";
+
+    VkComputePipelineCreateInfo createInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    createInfo.stage = compShaderCreateInfo;
+    createInfo.layout = m_pipelineLayout[pipelineLayoutName];
+    createInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    m_checkVkResult(vkCreateComputePipelines(m_logicalDevice, VK_NULL_HANDLE, 1, &createInfo, VK_NULL_HANDLE, &newPipeline));
+    m_pipelines[name].pipeline = newPipeline;
+
+    vkDestroyShaderModule(m_logicalDevice, compShader, nullptr);
+    Logger::Instance()->logInfo("createComputePipeline: " + name);
+
+    return m_pipelineLayout[pipelineLayoutName];
+}
+
 std::vector<char> PipelineManager::readFile(const std::string& path) {
     std::ifstream file(path, std::ios::ate | std::ios::binary);
 
@@ -270,6 +304,67 @@ void PipelineManager::createBaseDescriptorSetLayouts()
     m_descriptorLayouts["ubo0vertex"].allocInfo.descriptorSetCount = 1;
     m_descriptorLayouts["ubo0vertex"].allocInfo.pSetLayouts = &m_descriptorLayouts["ubo0vertex"].layout;
 
+    //ssbo part; the dynamic offset selects the region of the frame in flight
+    m_descriptorLayouts.insert({"ssbo0vertex", descriptorLayoutInfo{}});
+
+    VkDescriptorSetLayoutBinding ssbo0VertexBinding{};
+    ssbo0VertexBinding.binding = 0;
+    ssbo0VertexBinding.descriptorCount = 1;
+    ssbo0VertexBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    ssbo0VertexBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo ssbo0vertexCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    ssbo0vertexCreateInfo.bindingCount = 1;
+    ssbo0vertexCreateInfo.pBindings = &ssbo0VertexBinding;
+
+    m_checkVkResult(vkCreateDescriptorSetLayout(m_logicalDevice, &ssbo0vertexCreateInfo, VK_NULL_HANDLE, &m_descriptorLayouts["ssbo0vertex"].layout));
+
+    VkDescriptorPoolSize ssboPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC};
+    ssboPoolSize.descriptorCount = 5U;
+    VkDescriptorPoolCreateInfo ssbopoolCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    ssbopoolCreateInfo.poolSizeCount = 1;
+    ssbopoolCreateInfo.pPoolSizes = &ssboPoolSize;
+    ssbopoolCreateInfo.maxSets = 5U;//this is hardcoded here; maybe change later if needed
+
+    VkDescriptorPool ssboPool;
+    m_checkVkResult(vkCreateDescriptorPool(m_logicalDevice, &ssbopoolCreateInfo, VK_NULL_HANDLE, &ssboPool));
+
+    m_descriptorLayouts["ssbo0vertex"].allocInfo.descriptorPool = ssboPool;
+    m_descriptorLayouts["ssbo0vertex"].allocInfo.descriptorSetCount = 1;
+    m_descriptorLayouts["ssbo0vertex"].allocInfo.pSetLayouts = &m_descriptorLayouts["ssbo0vertex"].layout;
+
+    //culling part; the compute shader reads the instances and writes the draw commands and the visible instances
+    m_descriptorLayouts.insert({"cull0compute", descriptorLayoutInfo{}});
+
+    VkDescriptorSetLayoutBinding cull0ComputeBindings[3]{};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        cull0ComputeBindings[i].binding = i;
+        cull0ComputeBindings[i].descriptorCount = 1;
+        cull0ComputeBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        cull0ComputeBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo cull0computeCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    cull0computeCreateInfo.bindingCount = 3;
+    cull0computeCreateInfo.pBindings = cull0ComputeBindings;
+
+    m_checkVkResult(vkCreateDescriptorSetLayout(m_logicalDevice, &cull0computeCreateInfo, VK_NULL_HANDLE, &m_descriptorLayouts["cull0compute"].layout));
+
+    VkDescriptorPoolSize cullPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC};
+    cullPoolSize.descriptorCount = 3U * 5U;
+    VkDescriptorPoolCreateInfo cullpoolCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    cullpoolCreateInfo.poolSizeCount = 1;
+    cullpoolCreateInfo.pPoolSizes = &cullPoolSize;
+    cullpoolCreateInfo.maxSets = 5U;//this is hardcoded here; maybe change later if needed
+
+    VkDescriptorPool cullPool;
+    m_checkVkResult(vkCreateDescriptorPool(m_logicalDevice, &cullpoolCreateInfo, VK_NULL_HANDLE, &cullPool));
+
+    m_descriptorLayouts["cull0compute"].allocInfo.descriptorPool = cullPool;
+    m_descriptorLayouts["cull0compute"].allocInfo.descriptorSetCount = 1;
+    m_descriptorLayouts["cull0compute"].allocInfo.pSetLayouts = &m_descriptorLayouts["cull0compute"].layout;
+
     //combined sampler part
     m_descriptorLayouts.insert({"sampler1fragment", descriptorLayoutInfo{}});
     
@@ -300,6 +395,96 @@ void PipelineManager::createBaseDescriptorSetLayouts()
     m_descriptorLayouts["sampler1fragment"].allocInfo.pSetLayouts = &m_descriptorLayouts["sampler1fragment"].layout;
 }
 
+void PipelineManager::createTextureArrayDescriptorSet()
+{
+    if (!m_deviceHandler->hasDescriptorIndexing())
+        return;
+
+    m_textureArraySize = std::min(m_textureArrayLimit, m_deviceHandler->getMaxTextureArraySize());
+
+    //texture array part; only the written elements are valid, and new or released ones are written while the frames in flight use the set
+    m_descriptorLayouts.insert({"textureArray1fragment", descriptorLayoutInfo{}});
+
+    VkDescriptorSetLayoutBinding textureArray1FragmentBinding{};
+    textureArray1FragmentBinding.binding = 1;
+    textureArray1FragmentBinding.descriptorCount = m_textureArraySize;
+    textureArray1FragmentBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureArray1FragmentBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlagsEXT bindingFlags{VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT};
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT};
+    bindingFlagsCreateInfo.bindingCount = 1;
+    bindingFlagsCreateInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo textureArray1fragmentCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    textureArray1fragmentCreateInfo.pNext = &bindingFlagsCreateInfo;
+    textureArray1fragmentCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    textureArray1fragmentCreateInfo.bindingCount = 1;
+    textureArray1fragmentCreateInfo.pBindings = &textureArray1FragmentBinding;
+
+    m_checkVkResult(vkCreateDescriptorSetLayout(m_logicalDevice, &textureArray1fragmentCreateInfo, VK_NULL_HANDLE, &m_descriptorLayouts["textureArray1fragment"].layout));
+
+    VkDescriptorPoolSize textureArrayPoolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
+    textureArrayPoolSize.descriptorCount = m_textureArraySize;
+    VkDescriptorPoolCreateInfo textureArraypoolCreateInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    textureArraypoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    textureArraypoolCreateInfo.poolSizeCount = 1;
+    textureArraypoolCreateInfo.pPoolSizes = &textureArrayPoolSize;
+    textureArraypoolCreateInfo.maxSets = 1U;
+
+    VkDescriptorPool textureArrayPool;
+    m_checkVkResult(vkCreateDescriptorPool(m_logicalDevice, &textureArraypoolCreateInfo, VK_NULL_HANDLE, &textureArrayPool));
+
+    m_descriptorLayouts["textureArray1fragment"].allocInfo.descriptorPool = textureArrayPool;
+    m_descriptorLayouts["textureArray1fragment"].allocInfo.descriptorSetCount = 1;
+    m_descriptorLayouts["textureArray1fragment"].allocInfo.pSetLayouts = &m_descriptorLayouts["textureArray1fragment"].layout;
+
+    m_checkVkResult(vkAllocateDescriptorSets(m_logicalDevice, &m_descriptorLayouts["textureArray1fragment"].allocInfo, &m_textureArraySet));
+    Logger::Instance()->logInfo("PipelineManager: texture array with " + std::to_string(m_textureArraySize) + " elements");
+}
+
+uint32_t PipelineManager::addTextureToArray(VkImageView& imageView)
+{
+    if (m_textureArraySet == VK_NULL_HANDLE || (m_freeTextureArrayElements.empty() && m_textureArrayCount >= m_textureArraySize))
+        return UINT32_MAX;
+
+    uint32_t index{m_textureArrayCount};
+    if (!m_freeTextureArrayElements.empty())
+    {
+        index = m_freeTextureArrayElements.back();
+        m_freeTextureArrayElements.pop_back();
+    }
+
+    VkWriteDescriptorSet descriptorWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstSet = m_textureArraySet;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = VK_NULL_HANDLE;
+    descriptorWrite.pTexelBufferView  = VK_NULL_HANDLE;
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = m_deviceHandler->getSampler();
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    descriptorWrite.pImageInfo  = &imageInfo;
+
+    vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, VK_NULL_HANDLE);
+    if (index == m_textureArrayCount)
+        m_textureArrayCount++;
+    return index;
+}
+
+void PipelineManager::releaseTextureFromArray(uint32_t index)
+{
+    // the element keeps the old image view until it is written again, it is partially bound so nothing reads it
+    if (index < m_textureArrayCount)
+        m_freeTextureArrayElements.push_back(index);
+}
+
 void PipelineManager::createUBODescriptorSet(VkDescriptorSet& setToCreate, VkBuffer& buffer, VkDeviceSize offset, VkDeviceSize range)
 {
     m_checkVkResult(vkAllocateDescriptorSets(m_logicalDevice, &m_descriptorLayouts["ubo0vertex"].allocInfo, &setToCreate));
@@ -323,6 +508,64 @@ void PipelineManager::createUBODescriptorSet(VkDescriptorSet& setToCreate, VkBuf
     vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, VK_NULL_HANDLE);
 }
 
+void PipelineManager::createSSBODescriptorSet(VkDescriptorSet& setToCreate, VkBuffer& buffer, VkDeviceSize range)
+{
+    m_checkVkResult(vkAllocateDescriptorSets(m_logicalDevice, &m_descriptorLayouts["ssbo0vertex"].allocInfo, &setToCreate));
+    updateSSBODescriptorSet(setToCreate, buffer, range);
+}
+
+void PipelineManager::updateSSBODescriptorSet(VkDescriptorSet& set, VkBuffer& buffer, VkDeviceSize range)
+{
+    VkWriteDescriptorSet descriptorWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo  = VK_NULL_HANDLE;
+    descriptorWrite.pTexelBufferView  = VK_NULL_HANDLE;
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = range;
+
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, VK_NULL_HANDLE);
+}
+
+void PipelineManager::createCullDescriptorSet(VkDescriptorSet& setToCreate, VkBuffer& instances, VkBuffer& draws, VkBuffer& visible, VkDeviceSize instanceRange, VkDeviceSize drawRange)
+{
+    m_checkVkResult(vkAllocateDescriptorSets(m_logicalDevice, &m_descriptorLayouts["cull0compute"].allocInfo, &setToCreate));
+    updateCullDescriptorSet(setToCreate, instances, draws, visible, instanceRange, drawRange);
+}
+
+void PipelineManager::updateCullDescriptorSet(VkDescriptorSet& set, VkBuffer& instances, VkBuffer& draws, VkBuffer& visible, VkDeviceSize instanceRange, VkDeviceSize drawRange)
+{
+    VkDescriptorBufferInfo bufferInfos[3]{};
+    bufferInfos[0].buffer = instances;
+    bufferInfos[0].range = instanceRange;
+    bufferInfos[1].buffer = draws;
+    bufferInfos[1].range = drawRange;
+    bufferInfos[2].buffer = visible;
+    bufferInfos[2].range = instanceRange;
+
+    VkWriteDescriptorSet descriptorWrites[3]{};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstSet = set;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(m_logicalDevice, 3, descriptorWrites, 0, VK_NULL_HANDLE);
+}
+
 void PipelineManager::createSamplerDescriptorSet(VkDescriptorSet& setToCreate, VkImageView& imageView)
 {
     m_checkVkResult(vkAllocateDescriptorSets(m_logicalDevice, &m_descriptorLayouts["sampler1fragment"].allocInfo, &setToCreate));
@@ -415,4 +658,73 @@ void PipelineManager::createBasePipelineLayouts()
     ));
 
     m_pipelineLayout.insert({"ubo0sampler1shape2dPC", ubosamplershae2dPCLayout});
+
+    // ssbo part; the instances of the shape2d pipelines
+    layoutCreateInfo.pushConstantRangeCount = 0;
+    layoutCreateInfo.pPushConstantRanges = VK_NULL_HANDLE;
+    layouts = {m_descriptorLayouts["ssbo0vertex"].layout};
+    layoutCreateInfo.setLayoutCount = (uint32_t)layouts.size();
+    layoutCreateInfo.pSetLayouts = layouts.data();
+
+    VkPipelineLayout ssboLayout{};
+    m_checkVkResult(vkCreatePipelineLayout(
+    m_logicalDevice,
+    &layoutCreateInfo,
+    VK_NULL_HANDLE,
+    &ssboLayout
+    ));
+
+    m_pipelineLayout.insert({"ssbo0", ssboLayout});
+
+    layouts.push_back(m_descriptorLayouts["sampler1fragment"].layout);
+    layoutCreateInfo.setLayoutCount = (uint32_t)layouts.size();
+    layoutCreateInfo.pSetLayouts = layouts.data();
+
+    VkPipelineLayout ssbosamplerLayout{};
+    m_checkVkResult(vkCreatePipelineLayout(
+    m_logicalDevice,
+    &layoutCreateInfo,
+    VK_NULL_HANDLE,
+    &ssbosamplerLayout
+    ));
+
+    m_pipelineLayout.insert({"ssbo0sampler1", ssbosamplerLayout});
+
+    // culling part; the push constant is the first draw of the dispatch
+    pushC.size = sizeof(uintPC);
+    pushC.offset = 0;
+    pushC.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range = {pushC};
+    std::vector<VkDescriptorSetLayout> cullLayouts = {m_descriptorLayouts["cull0compute"].layout};
+    VkPipelineLayoutCreateInfo cullLayoutCreateInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    cullLayoutCreateInfo.setLayoutCount = (uint32_t)cullLayouts.size();
+    cullLayoutCreateInfo.pSetLayouts = cullLayouts.data();
+    cullLayoutCreateInfo.pushConstantRangeCount = (uint32_t)range.size();
+    cullLayoutCreateInfo.pPushConstantRanges = range.data();
+
+    VkPipelineLayout cullLayout{};
+    m_checkVkResult(vkCreatePipelineLayout(
+    m_logicalDevice,
+    &cullLayoutCreateInfo,
+    VK_NULL_HANDLE,
+    &cullLayout
+    ));
+
+    m_pipelineLayout.insert({"cull0uintPC", cullLayout});
+
+    if (m_textureArraySet == VK_NULL_HANDLE)
+        return;
+
+    layouts.back() = m_descriptorLayouts["textureArray1fragment"].layout;
+    layoutCreateInfo.pSetLayouts = layouts.data();
+
+    VkPipelineLayout ssbotextureArrayLayout{};
+    m_checkVkResult(vkCreatePipelineLayout(
+    m_logicalDevice,
+    &layoutCreateInfo,
+    VK_NULL_HANDLE,
+    &ssbotextureArrayLayout
+    ));
+
+    m_pipelineLayout.insert({"ssbo0textureArray1", ssbotextureArrayLayout});
 }
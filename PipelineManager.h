@@ -28,9 +28,17 @@ private:
     std::map<std::string, descriptorLayoutInfo> m_descriptorLayouts;
     std::map<std::string, VkPipelineLayout> m_pipelineLayout;
 
+    // with descriptor indexing every texture is one element of this array, the instances select it by index
+    const uint32_t m_textureArrayLimit{1024};
+    uint32_t m_textureArraySize{0};
+    uint32_t m_textureArrayCount{0};
+    std::vector<uint32_t> m_freeTextureArrayElements; // the released elements below the count, reused before the count grows
+    VkDescriptorSet m_textureArraySet{VK_NULL_HANDLE};
+
     std::vector<char> readFile(const std::string& path);
     VkShaderModule createShaderModule(const std::string& path);
     void createBaseDescriptorSetLayouts();
+    void createTextureArrayDescriptorSet();
 
     void createBasePipelineLayouts();
 
@@ -47,10 +55,24 @@ public:
 
     pipelineInfo &addBaseGraphicsPipelineCreateInfo(const std::string& name);
     VkPipelineLayout& createGraphicsPipeline(VkPipeline& newPipeline, const std::string& name, const std::string& pipelineLayoutName, const std::string& vertPath, const std::string& fragPath);
+    VkPipelineLayout& createComputePipeline(VkPipeline& newPipeline, const std::string& name, const std::string& pipelineLayoutName, const std::string& compPath);
     void addVertexDataToPipeline(const std::string& vertexName, const std::string& pipelineName);
 
     void createUBODescriptorSet(VkDescriptorSet& setToCreate, VkBuffer& buffer, VkDeviceSize offset, VkDeviceSize range);
+    // storage buffer with a dynamic offset, the range is one region of it; update it only when no frame in flight uses it
+    void createSSBODescriptorSet(VkDescriptorSet& setToCreate, VkBuffer& buffer, VkDeviceSize range);
+    void updateSSBODescriptorSet(VkDescriptorSet& set, VkBuffer& buffer, VkDeviceSize range);
+    // the three storage buffers of the culling, each with a dynamic offset: the instances, the draw commands and the visible instances
+    void createCullDescriptorSet(VkDescriptorSet& setToCreate, VkBuffer& instances, VkBuffer& draws, VkBuffer& visible, VkDeviceSize instanceRange, VkDeviceSize drawRange);
+    void updateCullDescriptorSet(VkDescriptorSet& set, VkBuffer& instances, VkBuffer& draws, VkBuffer& visible, VkDeviceSize instanceRange, VkDeviceSize drawRange);
     void createSamplerDescriptorSet(VkDescriptorSet& setToCreate, VkImageView& imageView);
+    // false without descriptor indexing, then the textures need their own sampler descriptor sets
+    bool hasTextureArray() { return m_textureArraySet != VK_NULL_HANDLE; };
+    VkDescriptorSet& getTextureArraySet() { return m_textureArraySet; };
+    // writes the texture to a free element of the array and returns its index, UINT32_MAX when the array is full
+    uint32_t addTextureToArray(VkImageView& imageView);
+    // the element can be written again, only when no frame in flight uses it anymore
+    void releaseTextureFromArray(uint32_t index);
 };
 
 #endif
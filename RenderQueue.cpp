@@ -0,0 +1,43 @@
+#include "RenderQueue.h"
+
+const std::vector<RenderQueue::entry>& RenderQueue::sort(const std::vector<RENDER::shape2dInstance>& instances)
+{
+    m_entries.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++)
+        m_entries[i] = entry{instances[i].sortKey, (uint32_t)i};
+    radixSort(m_entries, m_scratch);
+    return m_entries;
+}
+
+void RenderQueue::radixSort(std::vector<entry>& entries, std::vector<entry>& scratch)
+{
+    if (entries.size() < 2)
+        return;
+
+    // the counts of every byte in one go over the keys
+    uint32_t counts[8][256]{};
+    for (const auto& e: entries)
+    {
+        for (int pass = 0; pass < 8; pass++)
+            counts[pass][(e.key >> (8 * pass)) & 0xFF]++;
+    }
+
+    scratch.resize(entries.size());
+    for (int pass = 0; pass < 8; pass++)
+    {
+        uint32_t* count = counts[pass];
+        if (count[(entries[0].key >> (8 * pass)) & 0xFF] == entries.size())
+            continue;
+
+        uint32_t offsets[256];
+        uint32_t sum{0};
+        for (int b = 0; b < 256; b++)
+        {
+            offsets[b] = sum;
+            sum += count[b];
+        }
+        for (const auto& e: entries)
+            scratch[offsets[(e.key >> (8 * pass)) & 0xFF]++] = e;
+        entries.swap(scratch);
+    }
+}
@@ -0,0 +1,36 @@
+/// used sources from the internet:
+/// https://en.wikipedia.org/wiki/Radix_sort
+/// https://realtimecollisiondetection.net/blog/?p=86
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+#include <cstdint>
+#include "Structs.h"
+
+// the draws of a frame in the order of their sort keys, see RENDER::shape2dSortKey
+// only the keys and the indices are sorted, the instances stay where they are
+// radix sort with 8 bits per pass, a pass is skipped when every key has the same byte there, e.g. the unused layers
+class RenderQueue
+{
+public:
+    struct entry
+    {
+        uint64_t key;
+        uint32_t index; // in the instances given to sort
+    };
+
+private:
+    std::vector<entry> m_entries;
+    std::vector<entry> m_scratch;
+
+public:
+    // valid until the next call, the same keys keep the order of the instances
+    const std::vector<entry>& sort(const std::vector<RENDER::shape2dInstance>& instances);
+
+    // sorts the entries by key, stable; scratch is only a buffer for the passes
+    static void radixSort(std::vector<entry>& entries, std::vector<entry>& scratch);
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "Replay.h"
+#include "Logger.h"
+#include <cstring>
+
+// little endian on every platform, so a recording can be played on another machine
+static void writeValue(std::fstream& file, uint64_t value, int bytes)
+{
+    char buffer[8]{};
+    for (int i = 0; i < bytes; i++)
+        buffer[i] = (char)((value >> (8 * i)) & 0xFF);
+    file.write(buffer, bytes);
+}
+
+static uint64_t readValue(std::fstream& file, int bytes)
+{
+    unsigned char buffer[8]{};
+    file.read((char*)buffer, bytes);
+    uint64_t value{0};
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)buffer[i] << (8 * i);
+    return value;
+}
+
+bool Replay::startRecording(const std::string& pathToFile, uint32_t seed, double simulationHz, const std::string& startScene)
+{
+    close();
+    m_file.open(pathToFile, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+    {
+        Logger::Instance()->logError("Replay: cannot open the file to record: " + pathToFile);
+        return false;
+    }
+
+    m_seed = seed;
+    m_simulationHz = simulationHz;
+    m_startScene = startScene;
+    m_actionCount = 0;
+
+    uint64_t hzBits{0};
+    std::memcpy(&hzBits, &simulationHz, sizeof(hzBits));
+    m_file.write(MAGIC, sizeof(MAGIC));
+    writeValue(m_file, VERSION, 2);
+    writeValue(m_file, seed, 4);
+    writeValue(m_file, hzBits, 8);
+    writeValue(m_file, startScene.size(), 1);
+    m_file.write(startScene.data(), startScene.size());
+
+    m_mode = mode::RECORD;
+    return true;
+}
+
+bool Replay::startPlaying(const std::string& pathToFile)
+{
+    close();
+    m_file.open(pathToFile, std::ios::in | std::ios::binary);
+    if (!m_file.is_open())
+    {
+        Logger::Instance()->logError("Replay: cannot open the file to play: " + pathToFile);
+        return false;
+    }
+
+    char magic[4]{};
+    m_file.read(magic, sizeof(magic));
+    uint16_t version{(uint16_t)readValue(m_file, 2)};
+    if (!m_file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION)
+    {
+        Logger::Instance()->logError("Replay: not a recording or another version: " + pathToFile);
+        m_file.close();
+        return false;
+    }
+
+    m_seed = (uint32_t)readValue(m_file, 4);
+    uint64_t hzBits{readValue(m_file, 8)};
+    std::memcpy(&m_simulationHz, &hzBits, sizeof(hzBits));
+    m_startScene.resize(readValue(m_file, 1));
+    m_file.read(&m_startScene[0], m_startScene.size());
+
+    m_mode = mode::PLAY;
+    m_actionCount = 0;
+    m_finished = false;
+    readNext();
+    return true;
+}
+
+void Replay::close(uint32_t lastStep)
+{
+    if (m_mode == mode::RECORD)
+    {
+        record(lastStep, Action{});
+        Logger::Instance()->logInfo("Replay: recorded " + std::to_string(m_actionCount - 1) + " actions in " + std::to_string(lastStep) + " steps");
+    }
+    if (m_file.is_open())
+        m_file.close();
+    m_mode = mode::NONE;
+    m_hasNext = false;
+}
+
+void Replay::record(uint32_t step, const Action& action)
+{
+    if (m_mode != mode::RECORD)
+        return;
+    writeValue(m_file, step, 4);
+    writeValue(m_file, (uint8_t)action.name(), 1);
+    writeValue(m_file, (uint8_t)action.type(), 1);
+    writeValue(m_file, (uint16_t)(int16_t)action.x(), 2);
+    writeValue(m_file, (uint16_t)(int16_t)action.y(), 2);
+    m_actionCount++;
+}
+
+void Replay::readNext()
+{
+    m_hasNext = false;
+    uint32_t step{(uint32_t)readValue(m_file, 4)};
+    ACTION::id name{(ACTION::id)readValue(m_file, 1)};
+    ACTION::type type{(ACTION::type)readValue(m_file, 1)};
+    int x{(int16_t)readValue(m_file, 2)};
+    int y{(int16_t)readValue(m_file, 2)};
+    if (!m_file)
+    {
+        // cut off without the closing action, it ends after the last complete one
+        Logger::Instance()->logWarning("Replay: the recording ends without its last step");
+        m_finished = true;
+        return;
+    }
+
+    m_nextStep = step;
+    if (name == ACTION::id::NONE)
+    {
+        m_finished = true;
+        return;
+    }
+    m_next = Action(name, type, 0, x, y);
+    m_hasNext = true;
+}
+
+bool Replay::next(uint32_t step, Action& action)
+{
+    if (m_mode != mode::PLAY || !m_hasNext || m_nextStep != step)
+        return false;
+    action = m_next;
+    m_actionCount++;
+    readNext();
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include "Action.h"
+
+// records the seed and every action with the simulation step that handled it, and plays them back in the same steps
+// the simulation has a fixed step, so the same actions in the same steps give the same game, whatever the frame rate is
+// file: "RPLY", version, seed, steps per second, start scene, then 10 bytes per action; an action with NONE closes it with the last step
+class Replay
+{
+public:
+    enum class mode
+    {
+        NONE = 0,
+        RECORD,
+        PLAY
+    };
+
+private:
+    static constexpr char MAGIC[4]{'R', 'P', 'L', 'Y'};
+    static constexpr uint16_t VERSION{1};
+
+    mode m_mode{mode::NONE};
+    std::fstream m_file;
+    uint32_t m_seed{0};
+    double m_simulationHz{0.0};
+    std::string m_startScene{""};
+
+    // the next recorded action when playing
+    bool m_hasNext{false};
+    uint32_t m_nextStep{0};
+    Action m_next{};
+    bool m_finished{false};
+    uint32_t m_actionCount{0};
+
+    void readNext();
+
+public:
+    Replay() {};
+    ~Replay() { close(); };
+
+    bool startRecording(const std::string& pathToFile, uint32_t seed, double simulationHz, const std::string& startScene);
+    // false if the file is missing or from another version
+    bool startPlaying(const std::string& pathToFile);
+    // writes the end of a recording, the last step included
+    void close(uint32_t lastStep = 0);
+
+    mode getMode() const { return m_mode; };
+    bool isRecording() const { return m_mode == mode::RECORD; };
+    bool isPlaying() const { return m_mode == mode::PLAY; };
+
+    void record(uint32_t step, const Action& action);
+    // the next action of the given step, false if there is no more in this step
+    bool next(uint32_t step, Action& action);
+    // the recording ended at the given step
+    bool isFinished(uint32_t step) const { return m_finished && step >= m_nextStep; };
+
+    uint32_t getSeed() const { return m_seed; };
+    double getSimulationHz() const { return m_simulationHz; };
+    const std::string& getStartScene() const { return m_startScene; };
+    uint32_t getActionCount() const { return m_actionCount; };
+};
+
+#endif
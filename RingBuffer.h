@@ -0,0 +1,68 @@
+/// used sources from the internet:
+/// https://rigtorp.se/ringbuffer/
+/// https://www.1024cores.net/home/lock-free-algorithms/queues
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// fixed size queue for one producer and one consumer thread, without locks and allocation
+// the producer only writes m_head, the consumer only writes m_tail, the other side reads them with acquire so the item is already written
+// Capacity has to be a power of two, one slot stays empty to tell a full buffer from an empty one
+template<typename T, size_t Capacity>
+class RingBuffer
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "RingBuffer capacity has to be a power of two");
+
+private:
+    std::array<T, Capacity> m_items{};
+    // on different cache lines, so the two threads do not invalidate each other's line with every push and pop
+    alignas(64) std::atomic<size_t> m_head{0}; // next slot to write
+    alignas(64) std::atomic<size_t> m_tail{0}; // next slot to read
+
+    static size_t next(size_t idx) { return (idx + 1) & (Capacity - 1); };
+
+public:
+    // producer side, false if the buffer is full and the item is dropped
+    bool push(const T& item)
+    {
+        size_t head{m_head.load(std::memory_order_relaxed)};
+        size_t nextHead{next(head)};
+        if (nextHead == m_tail.load(std::memory_order_acquire))
+            return false;
+        m_items[head] = item;
+        m_head.store(nextHead, std::memory_order_release);
+        return true;
+    };
+
+    // consumer side, the oldest item without removing it, nullptr if empty
+    const T* front() const
+    {
+        size_t tail{m_tail.load(std::memory_order_relaxed)};
+        if (tail == m_head.load(std::memory_order_acquire))
+            return nullptr;
+        return &m_items[tail];
+    };
+
+    // consumer side, false if empty
+    bool pop(T& item)
+    {
+        const T* oldest{front()};
+        if (!oldest)
+            return false;
+        item = *oldest;
+        m_tail.store(next(m_tail.load(std::memory_order_relaxed)), std::memory_order_release);
+        return true;
+    };
+
+    // consumer side, drops everything pushed until now
+    void clear() { m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release); };
+
+    bool empty() const { return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire); };
+    size_t capacity() const { return Capacity - 1; };
+};
+
+#endif
@@ -6,25 +6,66 @@
 #include "Animation.h"
 #include "EntityManager.h"
 #include "VulkanRenderer.h"
+#include "SpatialHash.h"
+#include <algorithm>
 
 Scene::Scene(GameEngine* ge)
     : m_ge(ge)
 {
     m_em = std::make_shared<EntityManager>();
+    m_broadphase = std::make_unique<SpatialHash>(64.f);
+    // larger cells, the view covers a lot of them
+    m_renderIndex = std::make_unique<SpatialHash>(256.f);
+    // the static layer still has the shapes of the previous scene
+    if (m_ge->vulkanRenderer())
+        m_ge->vulkanRenderer()->invalidateStaticLayer();
 }
 
-void Scene::registerAction(int i, const std::string& name)
+void Scene::invalidateStaticLayer()
 {
-    m_actionMap[i] = name;
+    if (m_ge->vulkanRenderer())
+        m_ge->vulkanRenderer()->invalidateStaticLayer();
 }
 
-void Scene::doAction(Action action)
+bool Scene::isStaticShape(std::shared_ptr<Entity>& entity)
+{
+    return !m_ge->isSDL() && entity->hasComponent<CShape2d>() && entity->getComponent<CShape2d>().isStatic;
+}
+
+void Scene::registerAction(SDL_Scancode key, ACTION::id name)
+{
+    if (key >= 0 && key < SDL_NUM_SCANCODES)
+        m_keyActions[key] = name;
+}
+
+void Scene::registerMouseAction(Uint8 button, ACTION::id name)
+{
+    if (button < m_mouseButtonActions.size())
+        m_mouseButtonActions[button] = name;
+}
+
+void Scene::doAction(const Action& action)
 {
     sDoAction(action);
 }
 
-void Scene::sRender()
+void Scene::sSavePreviousState()
 {
+    for (auto& entity: m_em->getEntities())
+    {
+        if (entity->hasComponent<CTransform>())
+        {
+            auto& transform = entity->getComponent<CTransform>();
+            transform.prevPos = transform.pos;
+        }
+    }
+    m_renderIndexDirty = true;
+}
+
+void Scene::sRender(float alpha)
+{
+    m_renderAlpha = alpha;
+
     if (m_ge->isSDL())
     {
         SDL_SetRenderDrawColor(m_ge->renderer(), 0xFF, 0xFF, 0x0, 0x0);
@@ -32,47 +73,44 @@ void Scene::sRender()
         SDL_SetRenderDrawBlendMode(m_ge->renderer(), SDL_BLENDMODE_BLEND);
     }
 
-    for (auto& entity: m_em->getEntities())
+    // the static shapes are only sent again when the renderer lost them or one of them changed
+    // with added entities still pending the layer would miss them, then it waits for the next update
+    if (!m_ge->isSDL() && m_ge->vulkanRenderer()->isStaticLayerDirty() && !m_em->hasPendingEntities())
     {
-        if (entity->hasComponent<CTransform>())
+        m_ge->vulkanRenderer()->beginStaticLayer();
+        for (auto& entity: m_em->getEntities())
         {
-            if (entity->hasComponent<CText>())
-            {
-                drawText(entity);
-            }
-            if (entity->hasComponent<CRectBody>())
-            {
-                if (entity->hasComponent<CTexture>())
-                {
-                    drawTexture(entity);
-                }
-                else if (entity->hasComponent<CSpriteSet>())
-                {
-                    if (entity->hasComponent<CAnimation>())
-                        drawAnimation(entity);
-                    else
-                        drawSpriteSet(entity);
-                }
-                else if (entity->hasComponent<CSpriteStack>())
-                {
-                    drawSpriteStack(entity);
-                }
-                else if (entity->hasComponent<CVoxel>())
-                {
-                    drawVoxel(entity);
-                }
-                else if (entity->hasComponent<CShape2d>())
-                {
-                    drawShape2d(entity);
-                }
-                else
-                {
-                    drawRect(entity);
-                }
-            }
+            if (entity->isActive() && isStaticShape(entity))
+                drawEntity(entity);
         }
+        m_ge->vulkanRenderer()->endStaticLayer();
+    }
+
+    if (m_renderIndexDirty)
+    {
+        sRenderIndex();
+        m_renderIndexDirty = false;
     }
 
+    int windowX{0}, windowY{0};
+    m_ge->getWindowSize(windowX, windowY);
+    COLLISION::aabb view{m_cameraPos, m_cameraPos + MATH::Vec2((float)windowX, (float)windowY)};
+    m_drawnIds.clear();
+    m_renderIndex->query(view, m_drawnIds);
+    size_t visible{m_drawnIds.size()};
+    m_drawnIds.insert(m_drawnIds.end(), m_alwaysDrawn.begin(), m_alwaysDrawn.end());
+    // the ids grow in the order the entities were added, so the later ones are still drawn on top
+    std::sort(m_drawnIds.begin(), m_drawnIds.end());
+    for (auto id: m_drawnIds)
+    {
+        auto entity = m_em->getEntity(id);
+        if (entity)
+            drawEntity(entity);
+    }
+    m_submittedSum += m_drawnIds.size();
+    m_culledSum += m_renderIndex->size() - visible;
+    m_renderedFrames++;
+
     // render everything at the end of each render loop
     if (m_ge->isSDL())
     {
@@ -84,6 +122,49 @@ void Scene::sRender()
     }
 }
 
+void Scene::drawEntity(std::shared_ptr<Entity> &entity)
+{
+    if (entity->hasComponent<CState>() && entity->getComponent<CState>().hidden)
+        return;
+    if (!entity->hasComponent<CTransform>())
+        return;
+
+    if (entity->hasComponent<CText>())
+    {
+        drawText(entity);
+    }
+    if (entity->hasComponent<CRectBody>())
+    {
+        if (entity->hasComponent<CTexture>())
+        {
+            drawTexture(entity);
+        }
+        else if (entity->hasComponent<CSpriteSet>())
+        {
+            if (entity->hasComponent<CAnimation>())
+                drawAnimation(entity);
+            else
+                drawSpriteSet(entity);
+        }
+        else if (entity->hasComponent<CSpriteStack>())
+        {
+            drawSpriteStack(entity);
+        }
+        else if (entity->hasComponent<CVoxel>())
+        {
+            drawVoxel(entity);
+        }
+        else if (entity->hasComponent<CShape2d>())
+        {
+            drawShape2d(entity);
+        }
+        else
+        {
+            drawRect(entity);
+        }
+    }
+}
+
 void Scene::drawShape2d(std::shared_ptr<Entity> &entity)
 {
     if (m_ge->isSDL())
@@ -95,21 +176,31 @@ void Scene::drawShape2d(std::shared_ptr<Entity> &entity)
     auto& body = entity->getComponent<CRectBody>();
     auto& shape = entity->getComponent<CShape2d>();
 
-    MATH::Vec2 position{transform.pos.x, transform.pos.y};
+    AssetManager* am{m_ge->assetManager().get()};
+    resolveShape2d(shape, am);
+
+    MATH::Vec2 position{transform.renderPos(m_renderAlpha)};
     MATH::Vec2 size{body.halfWidth(), body.halfHeight()};
-    MATH::Vec4 color{body.color()};
     m_ge->vulkanRenderer()->vulkanRenderShape2d(
-        shape.vertexName,
-        shape.indexName,
+        RENDER::shape2dSortKey(shape.layer, RENDER::pipeline::SHAPE2D, 0, shape.vertexHandle, shape.indexHandle),
         position,
         size,
-        color,
-        m_ge->assetManager()->GetVertexBuffer(shape.vertexName),
-        m_ge->assetManager()->GetIndexBuffer(shape.indexName),
-        m_ge->assetManager()->GetIndexSize(shape.indexName)
+        body.color(),
+        am->GetVertexBuffer(shape.vertexHandle),
+        am->GetIndexBuffer(shape.indexHandle),
+        am->GetIndexSize(shape.indexHandle)
         );
 }
 
+void Scene::resolveShape2d(CShape2d& shape, AssetManager* am)
+{
+    // only once per component, or after its index buffer changed
+    if (shape.vertexHandle == UINT32_MAX)
+        shape.vertexHandle = am->GetVertexBufferHandle(shape.vertexName);
+    if (shape.indexHandle == UINT32_MAX)
+        shape.indexHandle = am->GetIndexBufferHandle(shape.indexName);
+}
+
 void Scene::drawRect(std::shared_ptr<Entity> &entity)
 {
     if (!entity->hasComponent<CTransform>() || !entity->hasComponent<CRectBody>())
@@ -137,7 +228,7 @@ void Scene::drawRect(std::shared_ptr<Entity> &entity)
     }
     else
     {
-        MATH::Vec2 position{transform.pos.x, transform.pos.y};
+        MATH::Vec2 position{transform.renderPos(m_renderAlpha)};
         MATH::Vec2 size{body.halfWidth(), body.halfHeight()};
 
         m_ge->vulkanRenderer()->vulkanRenderRect(position, size, body.color());
@@ -169,20 +260,24 @@ void Scene::drawTexture(std::shared_ptr<Entity> &entity)
             return;
 
         auto& shape = entity->getComponent<CShape2d>();
-
-        MATH::Vec2 position{transform.pos.x, transform.pos.y};
+        AssetManager* am{m_ge->assetManager().get()};
+        resolveShape2d(shape, am);
+        if (texture.handle == UINT32_MAX)
+            texture.handle = am->GetVulkanTextureHandle(texture.name);
+        // the textures on the same atlas page are drawn together
+        const auto& textureData = am->GetVulkanTextureData(texture.handle);
+
+        MATH::Vec2 position{transform.renderPos(m_renderAlpha)};
         MATH::Vec2 size{body.halfWidth(), body.halfHeight()};
 
         m_ge->vulkanRenderer()->vulkanRenderShape2dWithTexture(
-            shape.vertexName,
-            shape.indexName,
-            texture.name,
+            RENDER::shape2dSortKey(shape.layer, RENDER::pipeline::SHAPE2D_TEXTURE, textureData.imageHandle, shape.vertexHandle, shape.indexHandle),
             position,
             size,
-            m_ge->assetManager()->GetVulkanTexture(texture.name),
-            m_ge->assetManager()->GetVertexBuffer(shape.vertexName),
-            m_ge->assetManager()->GetIndexBuffer(shape.indexName),
-            m_ge->assetManager()->GetIndexSize(shape.indexName)
+            textureData,
+            am->GetVertexBuffer(shape.vertexHandle),
+            am->GetIndexBuffer(shape.indexHandle),
+            am->GetIndexSize(shape.indexHandle)
             );
     }
 }
@@ -324,11 +419,13 @@ std::pair<bool, bool> Scene::checkInsideEntity(std::shared_ptr<Entity>& one, std
         auto& oneAABB = one->getComponent<CAABB>();
         auto& twoTransform = two->getComponent<CTransform>();
         auto& twoAABB = two->getComponent<CAABB>();
+        // where the next step would move it
+        MATH::Vec2 delta{stepDelta(one)};
 
-        bool outsideX = oneTransform.pos.x - oneAABB.halfWidth() + oneTransform.vel.x < twoTransform.pos.x - twoAABB.halfWidth() ||
-            oneTransform.pos.x + oneAABB.halfWidth() + oneTransform.vel.x > twoTransform.pos.x + twoAABB.halfWidth();
-        bool outsideY = oneTransform.pos.y - oneAABB.halfHeight() + oneTransform.vel.y < twoTransform.pos.y - twoAABB.halfHeight() ||
-            oneTransform.pos.y + oneAABB.halfHeight() + oneTransform.vel.y > twoTransform.pos.y + twoAABB.halfHeight();
+        bool outsideX = oneTransform.pos.x - oneAABB.halfWidth() + delta.x < twoTransform.pos.x - twoAABB.halfWidth() ||
+            oneTransform.pos.x + oneAABB.halfWidth() + delta.x > twoTransform.pos.x + twoAABB.halfWidth();
+        bool outsideY = oneTransform.pos.y - oneAABB.halfHeight() + delta.y < twoTransform.pos.y - twoAABB.halfHeight() ||
+            oneTransform.pos.y + oneAABB.halfHeight() + delta.y > twoTransform.pos.y + twoAABB.halfHeight();
 
         return std::make_pair(outsideX, outsideY);
     }
@@ -340,7 +437,7 @@ std::pair<bool, bool> Scene::checkInsideEntity(std::shared_ptr<Entity>& one, std
 
 std::pair<bool, bool> Scene::checkPointInsideEntity(MATH::Vec2& point, std::shared_ptr<Entity>& entity)
 {
-    if (!entity->hasComponent<CTransform>() && !entity->hasComponent<CAABB>())
+    if (!entity->hasComponent<CTransform>() || !entity->hasComponent<CAABB>())
         return std::make_pair(false, false);
 
     auto& transform = entity->getComponent<CTransform>();
@@ -354,6 +451,168 @@ std::pair<bool, bool> Scene::checkPointInsideEntity(MATH::Vec2& point, std::shar
     return std::make_pair(insideX, insideY);
 }
 
+void Scene::sBroadphase()
+{
+    m_maxStepDistance = 0.f;
+    m_stepDeltas.clear();
+    for (auto& entity: m_em->getEntities())
+    {
+        if (!entity->isActive() || !entity->hasComponent<CTransform>() || !entity->hasComponent<CAABB>())
+            continue;
+        auto& transform = entity->getComponent<CTransform>();
+        auto& aabb = entity->getComponent<CAABB>();
+        m_broadphase->update(entity->id(), COLLISION::makeAABB(transform.pos, MATH::Vec2(aabb.halfWidth(), aabb.halfHeight())));
+        m_maxStepDistance = std::max(m_maxStepDistance, MATH::VMath::mag(stepDelta(entity)));
+    }
+    // destroyed entities and the ones without CAABB are not updated anymore
+    m_broadphase->removeStale();
+}
+
+void Scene::sRenderIndex()
+{
+    m_alwaysDrawn.clear();
+    for (auto& entity: m_em->getEntities())
+    {
+        // the static shapes are in the static layer of the renderer, the GPU culls them
+        if (!entity->isActive() || !entity->hasComponent<CTransform>() || isStaticShape(entity))
+            continue;
+        bool screenSpace{entity->hasComponent<CState>() && entity->getComponent<CState>().cameraIndependent};
+        if (screenSpace || !entity->hasComponent<CRectBody>())
+            m_alwaysDrawn.push_back(entity->id());
+        else
+            m_renderIndex->update(entity->id(), renderBounds(entity));
+    }
+    // destroyed entities and the ones that are always drawn now
+    m_renderIndex->removeStale();
+}
+
+COLLISION::aabb Scene::renderBounds(std::shared_ptr<Entity>& entity)
+{
+    auto& transform = entity->getComponent<CTransform>();
+    auto& body = entity->getComponent<CRectBody>();
+    MATH::Vec2 halfSize{(float)body.halfWidth(), (float)body.halfHeight()};
+    // a rotated sprite fits in the circle around the body, the voxels are always drawn rotated
+    if (transform.angle != 0.0 || entity->hasComponent<CVoxel>())
+    {
+        float radius{MATH::VMath::mag(halfSize)};
+        halfSize = MATH::Vec2{radius, radius};
+    }
+    // drawn somewhere between the two positions
+    COLLISION::aabb box{COLLISION::merge(COLLISION::makeAABB(transform.prevPos, halfSize), COLLISION::makeAABB(transform.pos, halfSize))};
+    // the layers of the stacks are drawn one step higher each
+    if (entity->hasComponent<CSpriteStack>())
+    {
+        auto& spriteStack = entity->getComponent<CSpriteStack>();
+        box.min.y -= (float)(spriteStack.rowNumber * spriteStack.columnNumber * spriteStack.step);
+    }
+    else if (entity->hasComponent<CVoxel>())
+    {
+        auto& voxel = entity->getComponent<CVoxel>();
+        box.min.y -= (float)(voxel.rowNumber * voxel.step);
+    }
+    return box;
+}
+
+Scene::cullingStats Scene::getCullingStats()
+{
+    cullingStats stats{};
+    if (m_renderedFrames == 0)
+        return stats;
+    stats.submitted = m_submittedSum / (double)m_renderedFrames;
+    stats.culled = m_culledSum / (double)m_renderedFrames;
+    return stats;
+}
+
+void Scene::getEntitiesInAABB(const COLLISION::aabb& box, std::vector<std::shared_ptr<Entity>>& res)
+{
+    m_broadphaseResult.clear();
+    m_broadphase->query(box, m_broadphaseResult);
+    for (auto id: m_broadphaseResult)
+    {
+        auto entity = m_em->getEntity(id);
+        if (entity && entity->isActive())
+            res.push_back(entity);
+    }
+}
+
+void Scene::getEntitiesOverlapping(std::shared_ptr<Entity>& entity, std::vector<std::shared_ptr<Entity>>& res)
+{
+    if (!entity->hasComponent<CTransform>() || !entity->hasComponent<CAABB>())
+        return;
+    auto& transform = entity->getComponent<CTransform>();
+    auto& aabb = entity->getComponent<CAABB>();
+
+    m_broadphaseResult.clear();
+    m_broadphase->query(COLLISION::makeAABB(transform.pos, MATH::Vec2(aabb.halfWidth(), aabb.halfHeight())), m_broadphaseResult);
+    for (auto id: m_broadphaseResult)
+    {
+        if (id == entity->id())
+            continue;
+        auto other = m_em->getEntity(id);
+        if (other && other->isActive())
+            res.push_back(other);
+    }
+}
+
+void Scene::getEntitiesAtPoint(const MATH::Vec2& point, std::vector<std::shared_ptr<Entity>>& res)
+{
+    m_broadphaseResult.clear();
+    m_broadphase->queryPoint(point, m_broadphaseResult);
+    for (auto id: m_broadphaseResult)
+    {
+        auto entity = m_em->getEntity(id);
+        if (entity && entity->isActive())
+            res.push_back(entity);
+    }
+}
+
+MATH::Vec2 Scene::stepDelta(std::shared_ptr<Entity>& entity)
+{
+    if (!entity->hasComponent<CTransform>() || !entity->hasComponent<CState>() || !entity->getComponent<CState>().moving)
+        return MATH::Vec2{0.f, 0.f};
+    auto& transform = entity->getComponent<CTransform>();
+    return transform.vel * (transform.moveSpeed * (float)m_ge->getSimulationStep());
+}
+
+COLLISION::sweepHit Scene::sweepEntities(std::shared_ptr<Entity>& entity, const MATH::Vec2& delta, const std::string& tag, std::shared_ptr<Entity>& hitEntity)
+{
+    COLLISION::sweepHit first{};
+    hitEntity = nullptr;
+    if (!entity->hasComponent<CTransform>() || !entity->hasComponent<CAABB>())
+        return first;
+    auto& aabb = entity->getComponent<CAABB>();
+    COLLISION::aabb box{COLLISION::makeAABB(entity->getComponent<CTransform>().pos, MATH::Vec2(aabb.halfWidth(), aabb.halfHeight()))};
+
+    // the broadphase has the boxes from the start of the step, the others can come closer by m_maxStepDistance
+    COLLISION::aabb swept{COLLISION::merge(box, COLLISION::aabb{box.min + delta, box.max + delta})};
+    m_broadphaseResult.clear();
+    m_broadphase->query(COLLISION::expand(swept, m_maxStepDistance), m_broadphaseResult);
+
+    for (auto id: m_broadphaseResult)
+    {
+        if (id == entity->id())
+            continue;
+        auto other = m_em->getEntity(id);
+        if (!other || !other->isActive() || other->tag() != tag || !other->hasComponent<CAABB>())
+            continue;
+
+        // the other one may have moved already in this step, so it starts from prevPos
+        // and moves as far as the walls let it, in the direction it had before it bounced
+        auto& otherAABB = other->getComponent<CAABB>();
+        COLLISION::aabb otherBox{COLLISION::makeAABB(other->getComponent<CTransform>().prevPos, MATH::Vec2(otherAABB.halfWidth(), otherAABB.halfHeight()))};
+        auto moved = m_stepDeltas.find(id);
+        MATH::Vec2 otherDelta{moved != m_stepDeltas.end() ? moved->second : stepDelta(other)};
+        // in the frame of the other entity it stands still and this one moves with the difference of the two movements
+        COLLISION::sweepHit hit{COLLISION::sweep(box, delta - otherDelta, otherBox)};
+        if (hit.hit && hit.time < first.time)
+        {
+            first = hit;
+            hitEntity = other;
+        }
+    }
+    return first;
+}
+
 void Scene::checkEntityLifetime(std::shared_ptr<Entity> &entity)
 {
     if (!entity->hasComponent<CLifetime>())
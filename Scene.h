@@ -4,12 +4,16 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <array>
 #include "GameEngine.h"
 
 #include "Action.h"
+#include "Broadphase.h"
 
 class EntityManager;
 class Entity;
+class AssetManager;
+class CShape2d;
 
 class Scene
 {
@@ -17,7 +21,25 @@ protected:
     GameEngine* m_ge{nullptr};
     std::shared_ptr<EntityManager> m_em;
     int m_currentFrame{0};
-    std::map<int, std::string> m_actionMap;
+    // the action of every key and mouse button, NONE where the scene does not use it
+    std::array<ACTION::id, SDL_NUM_SCANCODES> m_keyActions{};
+    std::array<ACTION::id, 8> m_mouseButtonActions{};
+    ACTION::id m_mouseMotionAction{ACTION::id::NONE};
+    float m_renderAlpha{1.f};
+    std::unique_ptr<Broadphase> m_broadphase;
+    std::vector<size_t> m_broadphaseResult;
+    float m_maxStepDistance{0.f}; // the longest movement of one entity in this step
+    // the final movement of the entities the movement system already moved in this step, by id; cleared by sBroadphase
+    std::map<size_t, MATH::Vec2> m_stepDeltas;
+    // only the entities in the view are drawn: the ones with a body are in this index by the box they can be drawn in until the next step
+    std::unique_ptr<Broadphase> m_renderIndex;
+    bool m_renderIndexDirty{true};
+    std::vector<size_t> m_alwaysDrawn; // without a body, or in screen space like the HUD
+    std::vector<size_t> m_drawnIds;
+    MATH::Vec2 m_cameraPos{0.f, 0.f}; // the top left corner of the view in the world, the scenes with a camera move it
+    size_t m_submittedSum{0};
+    size_t m_culledSum{0};
+    size_t m_renderedFrames{0};
 
     virtual void init() = 0;
     virtual void endScene() = 0;
@@ -27,20 +49,60 @@ protected:
     std::pair<bool, bool> checkPointInsideEntity(MATH::Vec2& point, std::shared_ptr<Entity>& entity);
     void checkEntityLifetime(std::shared_ptr<Entity> &entity);
 
+    // keeps the broadphase in sync with the entities that have CTransform and CAABB, call it after the entity manager update
+    // and after everything that changes the velocities before the movement
+    void sBroadphase();
+    // the entities from the broadphase with a CAABB overlapping the box
+    void getEntitiesInAABB(const COLLISION::aabb& box, std::vector<std::shared_ptr<Entity>>& res);
+    // the same as above, without the entity itself
+    void getEntitiesOverlapping(std::shared_ptr<Entity>& entity, std::vector<std::shared_ptr<Entity>>& res);
+    void getEntitiesAtPoint(const MATH::Vec2& point, std::vector<std::shared_ptr<Entity>>& res);
+    // puts the entities to draw in the render index, once after every simulation step
+    void sRenderIndex();
+    // everything the entity can cover while it is drawn between the previous and the current step
+    COLLISION::aabb renderBounds(std::shared_ptr<Entity>& entity);
+    // the movement of an entity in this step
+    MATH::Vec2 stepDelta(std::shared_ptr<Entity>& entity);
+    // the first contact of the entity moving with delta and the entities with the tag, they move meanwhile: with their final movement
+    // in m_stepDeltas if they were moved already in this step, with their stepDelta otherwise
+    // the time of impact is exact for moving boxes, so fast entities do not jump over each other; hitEntity is the one it ran into
+    COLLISION::sweepHit sweepEntities(std::shared_ptr<Entity>& entity, const MATH::Vec2& delta, const std::string& tag, std::shared_ptr<Entity>& hitEntity);
+
 public:
     Scene() = delete;
     Scene(GameEngine* ge);
     virtual ~Scene() {};
     virtual void update() = 0;
     virtual void sDoAction(const Action& action) = 0;
-    void sRender();
+    // stores the positions before a simulation step, the rendering interpolates from them
+    void sSavePreviousState();
+    // alpha: how far the time is between the previous and the current simulation step, 0..1
+    void sRender(float alpha = 1.f);
+
+    struct cullingStats
+    {
+        double submitted{0.0};
+        double culled{0.0};
+    };
+    // the entities drawn and the ones left out because they were outside of the view, on average per rendered frame
+    cullingStats getCullingStats();
+
+    void doAction(const Action& action);
+    void registerAction(SDL_Scancode key, ACTION::id name);
+    void registerMouseAction(Uint8 button, ACTION::id name);
+    void registerMouseMotionAction(ACTION::id name) { m_mouseMotionAction = name; };
 
-    void doAction(Action action);
-    void registerAction(int i, const std::string& name);
+    ACTION::id getKeyAction(SDL_Scancode key) const { return (key >= 0 && key < SDL_NUM_SCANCODES) ? m_keyActions[key] : ACTION::id::NONE; };
+    ACTION::id getMouseAction(Uint8 button) const { return (button < m_mouseButtonActions.size()) ? m_mouseButtonActions[button] : ACTION::id::NONE; };
+    ACTION::id getMouseMotionAction() const { return m_mouseMotionAction; };
 
-    std::map<int, std::string>& getActionMap() { return m_actionMap; };
+    // the shapes flagged static are drawn from the static layer of the renderer, it keeps them until this is called
+    // call it after one of them changed: moved, hidden, added, removed, or got another mesh or texture
+    void invalidateStaticLayer();
+    bool isStaticShape(std::shared_ptr<Entity>& entity);
 
     // rendering methods
+    void drawEntity(std::shared_ptr<Entity> &entity);
     void drawRect(std::shared_ptr<Entity> &entity);
     void drawShape2d(std::shared_ptr<Entity> &entity);
     void drawTexture(std::shared_ptr<Entity> &entity);
@@ -49,6 +111,8 @@ public:
     void drawVoxel(std::shared_ptr<Entity> &entity);
     void drawAnimation(std::shared_ptr<Entity> &entity);
     void drawText(std::shared_ptr<Entity> &entity);
+    // looks up the asset handles of the component the first time it is drawn
+    void resolveShape2d(CShape2d& shape, AssetManager* am);
 };
 
 #endif
\ No newline at end of file
@@ -34,9 +34,9 @@ void SceneEnd::init()
     m_exitButton->addComponent<CSpriteSet>("exitGameButtonAnim", 3, 3, w, h, 2, 2);
 
     // create actionMap for this scene; can create a function from this, so the init will call it every time, pure virtual function in scene
-    registerAction(SDL_SCANCODE_W, "UP");
-    registerAction(SDL_SCANCODE_S, "DOWN");
-    registerAction(SDL_SCANCODE_E, "USE");
+    registerAction(SDL_SCANCODE_W, ACTION::id::UP);
+    registerAction(SDL_SCANCODE_S, ACTION::id::DOWN);
+    registerAction(SDL_SCANCODE_E, ACTION::id::USE);
 }
 
 void SceneEnd::endScene()
@@ -48,25 +48,24 @@ void SceneEnd::update()
 {
     m_em->update();
     sMovement();
-    sRender();
     m_currentFrame++;
 }
 
 void SceneEnd::sDoAction(const Action& action)
 {
-    if (action.type() != "START")
+    if (!action.isStart())
         return;
-    if (action.name() == "UP")
+    if (action.name() == ACTION::id::UP)
     {
         // move to the previous menu
         moveUpOneMenu();
     }
-    else if (action.name() == "DOWN")
+    else if (action.name() == ACTION::id::DOWN)
     {
         // move to the next menu
         moveDownOneMenu();
     }
-    else if (action.name() == "USE")
+    else if (action.name() == ACTION::id::USE)
     {
         // activate the currently selected menu
         useActiveMenu();
@@ -83,10 +82,10 @@ void SceneEnd::sMovement()
             auto& state = entity->getComponent<CState>();
 
             if (state.moving)
-                transform.pos = transform.pos + transform.vel;
+                transform.pos = transform.pos + stepDelta(entity);
 
             if (state.turning)
-                transform.angle = transform.angle + transform.turnSpeed / m_ge->getFPS();
+                transform.angle = transform.angle + transform.turnSpeed * m_ge->getSimulationStep();
 
         }
     }
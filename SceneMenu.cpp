@@ -34,11 +34,11 @@ void SceneMenu::init()
     m_exitButton->addComponent<CSpriteSet>("exitGameButtonAnim", 3, 3, w, h, 2, 2);
 
     // create actionMap for this scene; can create a function from this, so the init will call it every time, pure virtual function in scene
-    registerAction(SDL_SCANCODE_W, "UP");
-    registerAction(SDL_SCANCODE_S, "DOWN");
-    registerAction(SDL_SCANCODE_E, "USE");
-    registerAction(SDL_SCANCODE_LEFTBRACKET, "VolumeDown");
-    registerAction(SDL_SCANCODE_RIGHTBRACKET, "VolumeUp");
+    registerAction(SDL_SCANCODE_W, ACTION::id::UP);
+    registerAction(SDL_SCANCODE_S, ACTION::id::DOWN);
+    registerAction(SDL_SCANCODE_E, ACTION::id::USE);
+    registerAction(SDL_SCANCODE_LEFTBRACKET, ACTION::id::VOLUMEDOWN);
+    registerAction(SDL_SCANCODE_RIGHTBRACKET, ACTION::id::VOLUMEUP);
 
     // add some menu music and button sounds
     m_ge->assetManager()->AddSound("buttonClick", "audio/buttonClick.mp3");
@@ -52,36 +52,35 @@ void SceneMenu::endScene()
 void SceneMenu::update()
 {
     m_em->update();
-    sRender();
     m_currentFrame++;
 }
 
 void SceneMenu::sDoAction(const Action& action)
 {
-    if (action.type() != "START")
+    if (!action.isStart())
         return;
-    if (action.name() == "UP")
+    if (action.name() == ACTION::id::UP)
     {
         // move to the previous menu
         moveUpOneMenu();
     }
-    else if (action.name() == "DOWN")
+    else if (action.name() == ACTION::id::DOWN)
     {
         // move to the next menu
         moveDownOneMenu();
     }
-    else if (action.name() == "USE")
+    else if (action.name() == ACTION::id::USE)
     {
         // activate the currently selected menu
         m_ge->playSound("buttonClick");
         useActiveMenu();
     }
-    else if (action.name() == "VolumeUp")
+    else if (action.name() == ACTION::id::VOLUMEUP)
     {
         m_ge->changeSoundsVolume(10);
         m_ge->changeMusicVolume(10);
     }
-    else if (action.name() == "VolumeDown")
+    else if (action.name() == ACTION::id::VOLUMEDOWN)
     {
         m_ge->changeSoundsVolume(-10);
         m_ge->changeMusicVolume(-10);
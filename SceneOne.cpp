@@ -28,13 +28,13 @@ void SceneOne::init()
     m_camera->addComponent<CTransform>(MATH::Vec2{0,0});
 
     // create actionMap for this scene; can create a function from this, so the init will call it every time, pure virtual function in scene
-    registerAction(SDL_SCANCODE_W, "UP");
-    registerAction(SDL_SCANCODE_S, "DOWN");
-    registerAction(SDL_SCANCODE_A, "LEFT");
-    registerAction(SDL_SCANCODE_D, "RIGHT");
-    registerAction(SDL_BUTTON_LEFT, "LEFTMOUSE");
-    registerAction(SDL_BUTTON_RIGHT, "RIGHTMOUSE");
-    registerAction(SDL_MOUSEMOTION, "MOUSEMOTION");
+    registerAction(SDL_SCANCODE_W, ACTION::id::UP);
+    registerAction(SDL_SCANCODE_S, ACTION::id::DOWN);
+    registerAction(SDL_SCANCODE_A, ACTION::id::LEFT);
+    registerAction(SDL_SCANCODE_D, ACTION::id::RIGHT);
+    registerMouseAction(SDL_BUTTON_LEFT, ACTION::id::LEFTMOUSE);
+    registerMouseAction(SDL_BUTTON_RIGHT, ACTION::id::RIGHTMOUSE);
+    registerMouseMotionAction(ACTION::id::MOUSEMOTION);
 
     //m_ge->playMusic("menuMusic");
 }
@@ -51,7 +51,6 @@ void SceneOne::update()
     sPhysics();
     sMovement();
     sUpdateCamera();
-    sRender();
     sCheckGameState();
     m_currentFrame++;
 }
@@ -65,15 +64,15 @@ void SceneOne::sDoAction(const Action& action)
     auto& state = m_player->getComponent<CState>();
     auto& body = m_player->getComponent<CRectBody>();
 
-    if (action.name() == "LEFTMOUSE")
+    if (action.name() == ACTION::id::LEFTMOUSE)
     {
-        state.moving = action.type() == "START";
-        MATH::Vec2 mouseLocation{action.event().button.x, action.event().button.y};
+        state.moving = action.isStart();
+        MATH::Vec2 mouseLocation{action.x(), action.y()};
         transform.vel = MATH::VMath::normalize(mouseLocation - transform.cameraViewPos);
     }
-    else if (action.name() == "MOUSEMOTION")
+    else if (action.name() == ACTION::id::MOUSEMOTION)
     {
-        MATH::Vec2 mouseLocation{action.event().motion.x, action.event().motion.y};
+        MATH::Vec2 mouseLocation{action.x(), action.y()};
         transform.vel = MATH::VMath::normalize(mouseLocation - transform.cameraViewPos);
     }
 
@@ -83,21 +82,21 @@ void SceneOne::sDoAction(const Action& action)
     auto& transform = m_player->getComponent<CTransform>();
     auto& state = m_player->getComponent<CState>();
 
-    if (action.name() == "UP")
+    if (action.name() == ACTION::id::UP)
     {
-        transform.vel.y = (action.type() == "START") ? -1.f : 0.f;
+        transform.vel.y = (action.isStart()) ? -1.f : 0.f;
     }
-    else if (action.name() == "DOWN")
+    else if (action.name() == ACTION::id::DOWN)
     {
-        transform.vel.y = (action.type() == "START") ? 1.f : 0.f;
+        transform.vel.y = (action.isStart()) ? 1.f : 0.f;
     }
-    else if (action.name() == "LEFT")
+    else if (action.name() == ACTION::id::LEFT)
     {
-        transform.vel.x = (action.type() == "START") ? -1.f : 0.f;
+        transform.vel.x = (action.isStart()) ? -1.f : 0.f;
     }
-    else if (action.name() == "RIGHT")
+    else if (action.name() == ACTION::id::RIGHT)
     {
-        transform.vel.x = (action.type() == "START") ? 1.f : 0.f;
+        transform.vel.x = (action.isStart()) ? 1.f : 0.f;
     }
 
     state.moving = (MATH::VMath::mag(transform.vel) != 0) ? true : false;
@@ -114,10 +113,10 @@ void SceneOne::sMovement()
             auto& state = entity->getComponent<CState>();
 
             if (state.moving)
-                transform.pos = transform.pos + transform.vel * transform.moveSpeed;
+                transform.pos = transform.pos + stepDelta(entity);
 
             if (state.turning)
-                transform.angle = fmod(transform.angle + transform.turnDirection * transform.turnSpeed, 360);
+                transform.angle = fmod(transform.angle + transform.turnDirection * transform.turnSpeed * m_ge->getSimulationStep(), 360);
 
         }
     }
@@ -130,8 +129,8 @@ void SceneOne::playerPhysicsUpdate()
         auto& transform = m_player->getComponent<CTransform>();
         auto& state = m_player->getComponent<CState>();
 
-        transform.moveSpeed = (float)transform.maxMoveSpeed / m_ge->getFPS();
-        transform.turnSpeed = transform.maxTurnSpeed / m_ge->getFPS();
+        transform.moveSpeed = transform.maxMoveSpeed;
+        transform.turnSpeed = transform.maxTurnSpeed;
 
         auto currentRad = atan2f(transform.vel.y, transform.vel.x);
         auto currentDeg = currentRad * 180 / M_PI;
@@ -168,8 +167,8 @@ void SceneOne::sPhysics()
 
 void SceneOne::sCheckGameState()
 {
-    m_time += m_ge->getFrameTime();
-    m_HUD.timeNumber->getComponent<CText>().text = std::to_string(m_time / 1000);
+    m_time += m_ge->getSimulationStep() * 1000.0;
+    m_HUD.timeNumber->getComponent<CText>().text = std::to_string((int)(m_time / 1000));
     checkEnd();
 }
 
@@ -182,6 +181,8 @@ void SceneOne::sUpdateCamera()
     // this is the main logic to move the camera around, now we just follow the player and adjust the view to be center of the screen
     camera.pos.x = m_player->getComponent<CTransform>().pos.x - windowX / 2;
     camera.pos.y = m_player->getComponent<CTransform>().pos.y - windowY / 2;
+    // the render culling keeps what is in the view from here
+    m_cameraPos = camera.pos;
 
     for (auto& entity: m_em->getEntities())
     {
@@ -268,11 +269,13 @@ std::pair<bool, bool> SceneOne::checkInsideEntity(std::shared_ptr<Entity>& one,
             auto& oneAABB = one->getComponent<CAABB>();
             auto& twoTransform = two->getComponent<CTransform>();
             auto& twoAABB = two->getComponent<CAABB>();
+            // where the next step would move it
+            MATH::Vec2 delta{stepDelta(one)};
 
-            bool outsideX = oneTransform.pos.x - oneAABB.halfWidth() + oneTransform.vel.x < twoTransform.pos.x - twoAABB.halfWidth() ||
-                oneTransform.pos.x + oneAABB.halfWidth() + oneTransform.vel.x > twoTransform.pos.x + twoAABB.halfWidth();
-            bool outsideY = oneTransform.pos.y - oneAABB.halfHeight() + oneTransform.vel.y < twoTransform.pos.y - twoAABB.halfHeight() ||
-                oneTransform.pos.y + oneAABB.halfHeight() + oneTransform.vel.y > twoTransform.pos.y + twoAABB.halfHeight();
+            bool outsideX = oneTransform.pos.x - oneAABB.halfWidth() + delta.x < twoTransform.pos.x - twoAABB.halfWidth() ||
+                oneTransform.pos.x + oneAABB.halfWidth() + delta.x > twoTransform.pos.x + twoAABB.halfWidth();
+            bool outsideY = oneTransform.pos.y - oneAABB.halfHeight() + delta.y < twoTransform.pos.y - twoAABB.halfHeight() ||
+                oneTransform.pos.y + oneAABB.halfHeight() + delta.y > twoTransform.pos.y + twoAABB.halfHeight();
 
             return std::make_pair(outsideX, outsideY);
         }
@@ -291,7 +294,6 @@ void SceneOne::checkEnd()
 void SceneOne::createHUD()
 {
     // TODO: create a better render ordering system; with layers and order in a given layer, so we can give precise order to render the objects
-    // TODO: also some kind of culling system, so we are not rendering objects that are not on the screen, just calculate the other changes: physics, collision, etc
     m_HUD.upperBar = m_em->addEntity("HUDelement");
     m_HUD.upperBar->addComponent<CRectBody>(windowX, 48, MATH::Vec4{0xFF, 0, 0xFF, 0xFF});
     m_HUD.upperBar->addComponent<CTransform>(MATH::Vec2{windowX / 2, 24});
@@ -28,7 +28,7 @@ private:
     HUD m_HUD;
     std::shared_ptr<Entity> m_camera;
 
-    int m_time{0};
+    double m_time{0}; // ms
 
     // store the window's size
     int windowX, windowY;
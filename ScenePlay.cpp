@@ -30,10 +30,10 @@ void ScenePlay::init()
     m_camera->addComponent<CTransform>(MATH::Vec2{0,0});
 
     // create actionMap for this scene; can create a function from this, so the init will call it every time, pure virtual function in scene
-    registerAction(SDL_SCANCODE_W, "UP");
-    registerAction(SDL_SCANCODE_S, "DOWN");
-    registerAction(SDL_SCANCODE_A, "LEFT");
-    registerAction(SDL_SCANCODE_D, "RIGHT");
+    registerAction(SDL_SCANCODE_W, ACTION::id::UP);
+    registerAction(SDL_SCANCODE_S, ACTION::id::DOWN);
+    registerAction(SDL_SCANCODE_A, ACTION::id::LEFT);
+    registerAction(SDL_SCANCODE_D, ACTION::id::RIGHT);
 }
 
 void ScenePlay::endScene()
@@ -45,10 +45,10 @@ void ScenePlay::update()
 {
     // TODO: find a way to cycle through the entities only one time per update; not in every method: once for physics, once for movement etc...
     m_em->update();
+    sBroadphase();
     sPhysics();
     sMovement();
     sUpdateCamera();
-    sRender();
     sCheckGameState();
     m_currentFrame++;
 }
@@ -59,40 +59,40 @@ void ScenePlay::sDoAction(const Action& action)
         return;
     auto& transform = m_player->getComponent<CTransform>();
     auto& state = m_player->getComponent<CState>();
-    if (action.name() == "UP")
+    if (action.name() == ACTION::id::UP)
     {
-        state.moving = action.type() == "START";
+        state.moving = action.isStart();
     }
-    else if (action.name() == "DOWN")
+    else if (action.name() == ACTION::id::DOWN)
     {
-        state.moving = action.type() == "START";
+        state.moving = action.isStart();
         transform.moveSpeed *= -1;
     }
-    else if (action.name() == "LEFT")
+    else if (action.name() == ACTION::id::LEFT)
     {
-        state.turning = action.type() == "START";
+        state.turning = action.isStart();
         transform.maxTurnSpeed *= -1;
     }
-    else if (action.name() == "RIGHT")
+    else if (action.name() == ACTION::id::RIGHT)
     {
-        state.turning = action.type() == "START";
+        state.turning = action.isStart();
     }
     /* this control is for a simple up down left right movement system
-    if (action.name() == "UP")
+    if (action.name() == ACTION::id::UP)
     {
-        m_player->getComponent<CTransform>().vel.y = (action.type() == "START") ? -2.f : 0.f;
+        m_player->getComponent<CTransform>().vel.y = (action.isStart()) ? -2.f : 0.f;
     }
-    else if (action.name() == "DOWN")
+    else if (action.name() == ACTION::id::DOWN)
     {
-        m_player->getComponent<CTransform>().vel.y = (action.type() == "START") ? 2.f : 0.f;
+        m_player->getComponent<CTransform>().vel.y = (action.isStart()) ? 2.f : 0.f;
     }
-    else if (action.name() == "LEFT")
+    else if (action.name() == ACTION::id::LEFT)
     {
-        m_player->getComponent<CTransform>().vel.x = (action.type() == "START") ? -2.f : 0.f;
+        m_player->getComponent<CTransform>().vel.x = (action.isStart()) ? -2.f : 0.f;
     }
-    else if (action.name() == "RIGHT")
+    else if (action.name() == ACTION::id::RIGHT)
     {
-        m_player->getComponent<CTransform>().vel.x = (action.type() == "START") ? 2.f : 0.f;
+        m_player->getComponent<CTransform>().vel.x = (action.isStart()) ? 2.f : 0.f;
     }
     */
 }
@@ -107,10 +107,10 @@ void ScenePlay::sMovement()
             auto& state = entity->getComponent<CState>();
 
             if (state.moving)
-                transform.pos = transform.pos + transform.vel;
+                transform.pos = transform.pos + stepDelta(entity);
 
             if (state.turning)
-                transform.angle = transform.angle + transform.turnSpeed;
+                transform.angle = transform.angle + transform.turnSpeed * m_ge->getSimulationStep();
 
         }
     }
@@ -121,11 +121,11 @@ void ScenePlay::playerPhysicsUpdate()
     if (m_player->hasComponent<CTransform>())
     {
         auto& transform = m_player->getComponent<CTransform>();
+        // forward or backward with the sign of moveSpeed
         double realAngle = fmod(transform.angle, 360.0) * M_PI / 180.0;
-        auto currentMoveSpeed = (float)transform.moveSpeed / m_ge->getFPS();
-        transform.vel = MATH::Vec2{cosf(realAngle), sinf(realAngle)} * currentMoveSpeed;
+        transform.vel = MATH::Vec2{cosf(realAngle), sinf(realAngle)};
 
-        transform.turnSpeed = transform.maxTurnSpeed / m_ge->getFPS();
+        transform.turnSpeed = transform.maxTurnSpeed;
     }
 }
 
@@ -170,6 +170,8 @@ void ScenePlay::sUpdateCamera()
     // this is the main logic to move the camera around, now we just follow the player and adjust the view to be center of the screen
     camera.pos.x = m_player->getComponent<CTransform>().pos.x - windowX / 2;
     camera.pos.y = m_player->getComponent<CTransform>().pos.y - windowY / 2;
+    // the render culling keeps what is in the view from here
+    m_cameraPos = camera.pos;
 
     for (auto& entity: m_em->getEntities())
     {
@@ -222,9 +224,12 @@ void ScenePlay::spawnPlayer()
 
 void ScenePlay::collisionWithPlayer()
 {
-    for (auto& enemy: m_em->getEntities("Enemy"))
+    // only the entities near the player from the broadphase, not every enemy
+    m_playerContacts.clear();
+    getEntitiesOverlapping(m_player, m_playerContacts);
+    for (auto& enemy: m_playerContacts)
     {
-        if (checkEntityCollision(enemy, m_player))
+        if (enemy->tag() == "Enemy" && checkEntityCollision(enemy, m_player))
         {
             m_player->getComponent<CScore>().score += 1;
             m_HUD.mainScoreNumber->getComponent<CText>().text = std::to_string(m_player->getComponent<CScore>().score);
@@ -304,50 +309,6 @@ void ScenePlay::initMapTiles()
     }
 }
 
-bool ScenePlay::checkEntityCollision(std::shared_ptr<Entity> &one, std::shared_ptr<Entity> &two)
-{
-        if (one->hasComponent<CTransform>() && one->hasComponent<CAABB>() &&
-            two->hasComponent<CTransform>() && two->hasComponent<CAABB>())
-        {
-            auto& oneTransform = one->getComponent<CTransform>();
-            auto& oneAABB = one->getComponent<CAABB>();
-            auto& twoTransform = two->getComponent<CTransform>();
-            auto& twoAABB = two->getComponent<CAABB>();
-
-            MATH::Vec2 diff{fabsf(oneTransform.pos.x - twoTransform.pos.x),
-                            fabsf(oneTransform.pos.y - twoTransform.pos.y)};
-            return diff.x < abs(oneAABB.halfWidth() + twoAABB.halfWidth()) &&
-                    diff.y < abs(oneAABB.halfHeight() + twoAABB.halfHeight());
-        }
-        else
-        {
-            return false;
-        }
-}
-
-std::pair<bool, bool> ScenePlay::checkInsideEntity(std::shared_ptr<Entity>& one, std::shared_ptr<Entity>& two)
-{
-        if (one->hasComponent<CTransform>() && one->hasComponent<CAABB>() &&
-            two->hasComponent<CTransform>() && two->hasComponent<CAABB>())
-        {
-            auto& oneTransform = one->getComponent<CTransform>();
-            auto& oneAABB = one->getComponent<CAABB>();
-            auto& twoTransform = two->getComponent<CTransform>();
-            auto& twoAABB = two->getComponent<CAABB>();
-
-            bool outsideX = oneTransform.pos.x - oneAABB.halfWidth() + oneTransform.vel.x < twoTransform.pos.x - twoAABB.halfWidth() ||
-                oneTransform.pos.x + oneAABB.halfWidth() + oneTransform.vel.x > twoTransform.pos.x + twoAABB.halfWidth();
-            bool outsideY = oneTransform.pos.y - oneAABB.halfHeight() + oneTransform.vel.y < twoTransform.pos.y - twoAABB.halfHeight() ||
-                oneTransform.pos.y + oneAABB.halfHeight() + oneTransform.vel.y > twoTransform.pos.y + twoAABB.halfHeight();
-
-            return std::make_pair(outsideX, outsideY);
-        }
-        else
-        {
-            return std::make_pair(false, false);
-        }
-}
-
 void ScenePlay::checkLifetime()
 {
     for (auto& enemy: m_em->getEntities())
@@ -378,7 +339,6 @@ void ScenePlay::checkEnd()
 void ScenePlay::createHUD()
 {
     // TODO: create a better render ordering system; with layers and order in a given layer, so we can give precise order to render the objects
-    // TODO: also some kind of culling system, so we are not rendering objects that are not on the screen, just calculate the other changes: physics, collision, etc
     m_HUD.upperBar = m_em->addEntity("HUDelement");
     m_HUD.upperBar->addComponent<CRectBody>(windowX, 48, MATH::Vec4{0xFF, 0, 0xFF, 0xFF});
     m_HUD.upperBar->addComponent<CTransform>(MATH::Vec2{windowX / 2, 24});
@@ -24,6 +24,7 @@ private:
     std::shared_ptr<Entity> m_map;
     HUD m_HUD;
     std::shared_ptr<Entity> m_camera;
+    std::vector<std::shared_ptr<Entity>> m_playerContacts;
 
     MATH::Vec2 enemySpawnLocs[9] = {
         MATH::Vec2{200, 600},
@@ -44,8 +45,6 @@ private:
     void endScene() override;
 
     void initMapTiles();
-    bool checkEntityCollision(std::shared_ptr<Entity>& one, std::shared_ptr<Entity>& two);
-    std::pair<bool, bool> checkInsideEntity(std::shared_ptr<Entity>& one, std::shared_ptr<Entity>& two);
     void changePlayerSkin(const std::string& name, int frameCount);
 
     // systems
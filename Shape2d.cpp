@@ -3,124 +3,326 @@
 #include "PipelineManager.h"
 #include "DeviceHandler.h"
 #include <vulkan/vulkan.h>
-#include <cstring>//somehow we need this for macos; but not in rectangle.cpp, strange
+#include <algorithm>
+#include <cstring>
 
 void Shape2d::init()
 {
 
 }
 
+Shape2d::~Shape2d()
+{
+    if (instanceBuffer == VK_NULL_HANDLE)
+        return;
+    vkUnmapMemory(m_deviceHandler->getLogicalDevice(), instanceMemory);
+    m_deviceHandler->destroyBuffer(instanceBuffer, instanceMemory);
+    if (!m_gpuCulling)
+        return;
+    m_deviceHandler->destroyBuffer(visibleBuffer, visibleMemory);
+    vkUnmapMemory(m_deviceHandler->getLogicalDevice(), drawMemory);
+    m_deviceHandler->destroyBuffer(drawBuffer, drawMemory);
+}
+
 void Shape2d::createPipeline(PipelineManager* pm)
 {
+    m_pipelineManager = pm;
     pm->addBaseGraphicsPipelineCreateInfo(m_name + "Pipeline");
     pm->addVertexDataToPipeline("shape2d", m_name + "Pipeline");
     Logger::Instance()->logInfo("Shape2d: createPipeline 1");
-    ubo0Pipelinelayout = pm->createGraphicsPipeline(ubo0Pipeline, m_name + "Pipeline", "ubo0", "shaders/shape2dShaderVert.spv", "shaders/shape2dShaderFrag.spv");
+    ssbo0Pipelinelayout = pm->createGraphicsPipeline(ssbo0Pipeline, m_name + "Pipeline", "ssbo0", "shaders/shape2dShaderVert.spv", "shaders/shape2dShaderFrag.spv");
     Logger::Instance()->logInfo("Shape2d: createPipeline 2");
 
     pm->addBaseGraphicsPipelineCreateInfo(m_name + "Pipeline2");
     pm->addVertexDataToPipeline("shape2d", m_name + "Pipeline2");
-    ubo0Sampler1Pipelinelayout = pm->createGraphicsPipeline(ubo0Sampler1Pipeline, m_name + "Pipeline2", "ubo0sampler1", "shaders/shape2dTextureShaderVert.spv", "shaders/shape2dTextureShaderFrag.spv");
+    ssbo0Sampler1Pipelinelayout = pm->createGraphicsPipeline(ssbo0Sampler1Pipeline, m_name + "Pipeline2", "ssbo0sampler1", "shaders/shape2dTextureShaderVert.spv", "shaders/shape2dTextureShaderFrag.spv");
     Logger::Instance()->logInfo("Shape2d: createPipeline 3");
 
-    pm->createUBODescriptorSet(ubo0Set, uboBuffer, 0, sizeof(m_ubodata));
+    if (pm->hasTextureArray())
+    {
+        pm->addBaseGraphicsPipelineCreateInfo(m_name + "Pipeline3");
+        pm->addVertexDataToPipeline("shape2d", m_name + "Pipeline3");
+        ssbo0TextureArray1Pipelinelayout = pm->createGraphicsPipeline(ssbo0TextureArray1Pipeline, m_name + "Pipeline3", "ssbo0textureArray1", "shaders/shape2dTextureArrayShaderVert.spv", "shaders/shape2dTextureArrayShaderFrag.spv");
+        Logger::Instance()->logInfo("Shape2d: createPipeline 4");
+    }
+
+    // with the culling the draws read only the visible instances
+    pm->createSSBODescriptorSet(ssbo0Set, m_gpuCulling ? visibleBuffer : instanceBuffer, m_instanceRegionSize);
+    if (m_gpuCulling)
+    {
+        cullPipelinelayout = pm->createComputePipeline(cullPipeline, m_name + "Cull", "cull0uintPC", "shaders/shape2dCullComp.spv");
+        pm->createCullDescriptorSet(cullSet, instanceBuffer, drawBuffer, visibleBuffer, m_instanceRegionSize, m_drawRegionSize);
+    }
 
     Logger::Instance()->logInfo("Shape2d: createPipeline DONE");
 }
 
 void Shape2d::createUboBuffer(DeviceHandler* dh)
 {
-    dh->createBuffer(
-        sizeof(m_ubodata),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        uboBuffer,
-        uboMemory
+    m_deviceHandler = dh;
+    m_gpuCulling = dh->hasGpuCulling();
+    growInstanceBuffer(m_initialInstanceCapacity);
+    if (m_gpuCulling)
+        growDrawBuffer(m_initialDrawCapacity);
+}
+
+VkDeviceSize Shape2d::alignRegion(VkDeviceSize size)
+{
+    m_atomSize = std::max<VkDeviceSize>(m_deviceHandler->getLimits().nonCoherentAtomSize, 1);
+    VkDeviceSize alignment{std::max<VkDeviceSize>(m_deviceHandler->getLimits().minStorageBufferOffsetAlignment, m_atomSize)};
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+void Shape2d::flushRange(VkDeviceMemory memory, VkDeviceSize begin, VkDeviceSize end)
+{
+    begin = begin / m_atomSize * m_atomSize;
+    end = (end + m_atomSize - 1) / m_atomSize * m_atomSize; // the regions are aligned to the atom size, it stays in this one
+
+    VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+    range.memory = memory;
+    range.offset = begin;
+    range.size = end - begin;
+    m_deviceHandler->checkVkResult(vkFlushMappedMemoryRanges(m_deviceHandler->getLogicalDevice(), 1, &range));
+}
+
+void Shape2d::growInstanceBuffer(size_t instanceCount)
+{
+    size_t capacity{std::max(m_instanceCapacity, m_initialInstanceCapacity)};
+    while (capacity < instanceCount)
+        capacity *= 2;
+
+    if (instanceBuffer != VK_NULL_HANDLE)
+    {
+        // the frames in flight still read the old buffer and the descriptor set
+        m_deviceHandler->waitIdle();
+        vkUnmapMemory(m_deviceHandler->getLogicalDevice(), instanceMemory);
+        m_deviceHandler->destroyBuffer(instanceBuffer, instanceMemory);
+        if (m_gpuCulling)
+            m_deviceHandler->destroyBuffer(visibleBuffer, visibleMemory);
+    }
+
+    m_instanceRegionSize = alignRegion(capacity * sizeof(shape2dInstanceData));
+    m_instanceCapacity = capacity;
+    VkDeviceSize size{m_instanceRegionSize * m_deviceHandler->getFramesInFlight()};
+
+    m_deviceHandler->createBuffer(
+        size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        instanceBuffer,
+        instanceMemory
     );
 
-    vkMapMemory(dh->getLogicalDevice(), uboMemory, 0, sizeof(m_ubodata), 0, &uboAddress);
+    // mapped for the lifetime of the buffer, every frame only copies into it
+    void* address{nullptr};
+    m_deviceHandler->checkVkResult(vkMapMemory(m_deviceHandler->getLogicalDevice(), instanceMemory, 0, size, 0, &address));
+    instanceAddress = static_cast<char*>(address);
+
+    // only the GPU reads and writes it
+    if (m_gpuCulling)
+        m_deviceHandler->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibleBuffer, visibleMemory);
+
+    // the new regions have nothing valid in them yet
+    m_regionCopies.assign(m_deviceHandler->getFramesInFlight(), std::vector<shape2dInstanceData>(capacity));
+    m_regionCounts.assign(m_deviceHandler->getFramesInFlight(), 0);
+
+    if (ssbo0Set != VK_NULL_HANDLE)
+    {
+        m_pipelineManager->updateSSBODescriptorSet(ssbo0Set, m_gpuCulling ? visibleBuffer : instanceBuffer, m_instanceRegionSize);
+        if (m_gpuCulling)
+            m_pipelineManager->updateCullDescriptorSet(cullSet, instanceBuffer, drawBuffer, visibleBuffer, m_instanceRegionSize, m_drawRegionSize);
+        Logger::Instance()->logInfo("Shape2d: instance buffer grown to " + std::to_string(capacity) + " instances per frame");
+    }
 }
 
-void Shape2d::updateUBO()
+void Shape2d::growDrawBuffer(size_t drawCount)
 {
-    auto itPos = std::begin(m_ubodata.positionAndSize);
-    auto endPos = std::end(m_ubodata.positionAndSize);
-    auto itCol = std::begin(m_ubodata.color);
-    auto endCol = std::end(m_ubodata.color);
-    for (auto& [key, value]: m_vertexData)
+    size_t capacity{std::max(m_drawCapacity, m_initialDrawCapacity)};
+    while (capacity < drawCount)
+        capacity *= 2;
+
+    if (drawBuffer != VK_NULL_HANDLE)
     {
-        for (auto& obj: value.uboData)
-        {
-            if (itPos == endPos || itCol == endCol)
-                break;
-            *itPos = obj.first;
-            *itCol = obj.second;
-            itPos++;
-            itCol++;
-        }
+        // the frames in flight still draw with the old commands
+        m_deviceHandler->waitIdle();
+        vkUnmapMemory(m_deviceHandler->getLogicalDevice(), drawMemory);
+        m_deviceHandler->destroyBuffer(drawBuffer, drawMemory);
     }
 
-    memcpy(uboAddress, &m_ubodata, sizeof(m_ubodata));
+    m_drawRegionSize = alignRegion(capacity * sizeof(VkDrawIndexedIndirectCommand));
+    m_drawCapacity = capacity;
+    VkDeviceSize size{m_drawRegionSize * m_deviceHandler->getFramesInFlight()};
+
+    // the CPU writes the batches, the compute shader changes their instance counts and the draws read them
+    m_deviceHandler->createBuffer(
+        size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        drawBuffer,
+        drawMemory
+    );
+
+    void* address{nullptr};
+    m_deviceHandler->checkVkResult(vkMapMemory(m_deviceHandler->getLogicalDevice(), drawMemory, 0, size, 0, &address));
+    drawAddress = static_cast<char*>(address);
+
+    if (cullSet != VK_NULL_HANDLE)
+    {
+        m_pipelineManager->updateCullDescriptorSet(cullSet, instanceBuffer, drawBuffer, visibleBuffer, m_instanceRegionSize, m_drawRegionSize);
+        Logger::Instance()->logInfo("Shape2d: draw buffer grown to " + std::to_string(capacity) + " draws per frame");
+    }
+}
+
+void Shape2d::updateUBO(uint32_t frame)
+{
+    if (m_gpuCulling && !m_batches.empty())
+        flushRange(drawMemory, frame * m_drawRegionSize, frame * m_drawRegionSize + m_batches.size() * sizeof(VkDrawIndexedIndirectCommand));
+
+    if (m_dirtyEnd <= m_dirtyBegin)
+        return;
+    flushRange(instanceMemory, frame * m_instanceRegionSize + m_dirtyBegin * sizeof(shape2dInstanceData),
+        frame * m_instanceRegionSize + m_dirtyEnd * sizeof(shape2dInstanceData));
 }
 
 void Shape2d::resetFrameVariables()
 {
-    m_shapeCount = 0;// this is not used now, but maybe later so I keep it here
-    m_vertexData.clear();
-    m_vertexBufferMap.clear();
-    m_indexBufferMap.clear();
+    m_shapeCount = 0;
+    m_batches.clear();
+}
+
+void Shape2d::createCommandBuffer(VkCommandBuffer& buffer, uint32_t frame)
+{
+    createCommandBuffer(buffer, frame, 0, m_batches.size());
 }
 
-void Shape2d::createCommandBuffer(VkCommandBuffer& buffer)
+void Shape2d::createCommandBuffer(VkCommandBuffer& buffer, uint32_t frame, size_t firstDraw, size_t lastDraw)
 {
-    int instanceOffset{0};
-    for (auto& obj: m_vertexData)
+    uint32_t dynamicOffset{(uint32_t)(frame * m_instanceRegionSize)};
+    // the batches come sorted, so only the state that differs from the previous batch is bound again
+    // a secondary inherits no state, every part starts with binding everything
+    VkPipeline boundPipeline{VK_NULL_HANDLE};
+    VkDescriptorSet boundTextureSet{VK_NULL_HANDLE};
+    VkBuffer boundVertexBuffer{VK_NULL_HANDLE};
+    VkBuffer boundIndexBuffer{VK_NULL_HANDLE};
+    for (size_t i = firstDraw; i < lastDraw; i++)
     {
-        VkDeviceSize offsets[] = {0};
-        if (obj.second.nameTexture != "")
+        const auto& value = m_batches[i];
+        VkPipeline pipeline{ssbo0Pipeline};
+        VkPipelineLayout layout{ssbo0Pipelinelayout};
+        auto pipe = RENDER::sortKeyPipeline(value.key);
+        if (pipe == RENDER::pipeline::SHAPE2D_TEXTURE)
         {
-            vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ubo0Sampler1Pipeline);
-            vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ubo0Sampler1Pipelinelayout, 0, 1, &ubo0Set, 0, VK_NULL_HANDLE);
-            vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ubo0Sampler1Pipelinelayout, 1, 1, m_textureMap[obj.second.nameTexture], 0, VK_NULL_HANDLE);
-        } else {
-            vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ubo0Pipeline);
-            vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ubo0Pipelinelayout, 0, 1, &ubo0Set, 0, VK_NULL_HANDLE);
+            pipeline = ssbo0Sampler1Pipeline;
+            layout = ssbo0Sampler1Pipelinelayout;
+        } else if (pipe == RENDER::pipeline::SHAPE2D_TEXTURE_ARRAY) {
+            pipeline = ssbo0TextureArray1Pipeline;
+            layout = ssbo0TextureArray1Pipelinelayout;
+        }
+
+        if (pipeline != boundPipeline)
+        {
+            // the layouts differ in set 1, so the set of the instances is bound again with the pipeline
+            vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &ssbo0Set, 1, &dynamicOffset);
+            boundPipeline = pipeline;
+            boundTextureSet = VK_NULL_HANDLE;
+        }
+        if (pipe != RENDER::pipeline::SHAPE2D && value.textureSet != boundTextureSet)
+        {
+            vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &value.textureSet, 0, VK_NULL_HANDLE);
+            boundTextureSet = value.textureSet;
+        }
+        if (value.vertexBuffer != boundVertexBuffer)
+        {
+            VkDeviceSize offsets[] = {0};
+            vkCmdBindVertexBuffers(buffer, 0, 1, &value.vertexBuffer, offsets);
+            boundVertexBuffer = value.vertexBuffer;
+        }
+        if (value.indexBuffer != boundIndexBuffer)
+        {
+            vkCmdBindIndexBuffer(buffer, value.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            boundIndexBuffer = value.indexBuffer;
+        }
+        if (m_gpuCulling)
+        {
+            // the compute shader left only the visible instances in the command of the batch
+            VkDeviceSize offset{frame * m_drawRegionSize + i * sizeof(VkDrawIndexedIndirectCommand)};
+            vkCmdDrawIndexedIndirect(buffer, drawBuffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else
+        {
+            vkCmdDrawIndexed(buffer, value.indexCount, value.count, 0, 0, value.first);
         }
-        vkCmdBindVertexBuffers(buffer, 0, 1, m_vertexBufferMap[obj.second.nameVertex], offsets);
-        vkCmdBindIndexBuffer(buffer, *m_indexBufferMap[obj.second.nameIndex].first, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(buffer, m_indexBufferMap[obj.second.nameIndex].second, obj.second.uboData.size(), 0, 0, instanceOffset);
-        instanceOffset += obj.second.uboData.size();
     }
 }
 
-void Shape2d::addShape2dToDraw(const std::string &nameVertex, const std::string &nameIndex, MATH::Vec4 &positionAndSize, MATH::Vec4 &color, VkBuffer& vertexBuffer, VkBuffer& indexBuffer, int indexCount)
+void Shape2d::createComputeCommands(VkCommandBuffer& buffer, uint32_t frame)
 {
-    if (m_vertexData.find(nameVertex + nameIndex) == m_vertexData.end())
+    if (!m_gpuCulling || m_batches.empty())
+        return;
+
+    uint32_t dynamicOffsets[3]{(uint32_t)(frame * m_instanceRegionSize), (uint32_t)(frame * m_drawRegionSize), (uint32_t)(frame * m_instanceRegionSize)};
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelinelayout, 0, 1, &cullSet, 3, dynamicOffsets);
+
+    // one workgroup per batch, split when there are more batches than one dispatch can have
+    uint32_t maxGroups{m_deviceHandler->getLimits().maxComputeWorkGroupCount[0]};
+    for (uint32_t first = 0; first < m_batches.size(); first += maxGroups)
     {
-        m_vertexData.insert({ nameVertex + nameIndex, {} });
-        m_vertexData[nameVertex + nameIndex].nameIndex = nameIndex;
-        m_vertexData[nameVertex + nameIndex].nameVertex = nameVertex;
+        BUFFER::uintPushConstant pushConstant{first};
+        vkCmdPushConstants(buffer, cullPipelinelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstant), &pushConstant);
+        vkCmdDispatch(buffer, std::min<uint32_t>(maxGroups, (uint32_t)m_batches.size() - first), 1, 1);
     }
 
-    m_vertexData[nameVertex + nameIndex].uboData.push_back(std::make_pair(positionAndSize, color));
-
-    m_vertexBufferMap[nameVertex] = &vertexBuffer;
-    m_indexBufferMap[nameIndex] = std::make_pair(&indexBuffer, indexCount);
+    // the draws wait for the instance counts and the visible instances
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
 }
 
-void Shape2d::addShape2dToDraw(const std::string &nameVertex, const std::string &nameIndex, const std::string &nameTexture, MATH::Vec4 &positionAndSize, VkDescriptorSet& set, VkBuffer& vertexBuffer, VkBuffer& indexBuffer, int indexCount)
+void Shape2d::addShapes2dToDraw(const std::vector<RENDER::shape2dInstance>& instances, uint32_t frame)
 {
-    if (m_vertexData.find(nameVertex + nameIndex + nameTexture) == m_vertexData.end())
+    const auto& order = m_queue.sort(instances);
+    m_shapeCount = order.size();
+    if (m_shapeCount > m_instanceCapacity)
+        growInstanceBuffer(m_shapeCount);
+
+    // the slot of an instance is its place in the sorted order, only the ones that differ from the last use of this region are written
+    auto& copy = m_regionCopies[frame];
+    auto* mapped = reinterpret_cast<shape2dInstanceData*>(instanceAddress + frame * m_instanceRegionSize);
+    size_t validCount{m_regionCounts[frame]};
+    m_dirtyBegin = m_shapeCount;
+    m_dirtyEnd = 0;
+    m_uploadedBytes = 0;
+    for (size_t slot = 0; slot < m_shapeCount; slot++)
     {
-        m_vertexData.insert({ nameVertex + nameIndex + nameTexture, {} });
-        m_vertexData[nameVertex + nameIndex + nameTexture].nameIndex = nameIndex;
-        m_vertexData[nameVertex + nameIndex + nameTexture].nameVertex = nameVertex;
-        m_vertexData[nameVertex + nameIndex + nameTexture].nameTexture = nameTexture;
-    }
+        const auto& instance = instances[order[slot].index];
+        // a handle too big for its bits can give the same key to other buffers, so they split the batch too
+        if (m_batches.empty() || m_batches.back().key != instance.sortKey || m_batches.back().vertexBuffer != instance.vertexBuffer
+            || m_batches.back().indexBuffer != instance.indexBuffer || m_batches.back().indexCount != instance.indexCount
+            || m_batches.back().textureSet != instance.textureSet)
+            m_batches.push_back(batch{instance.sortKey, instance.vertexBuffer, instance.indexBuffer, instance.indexCount, instance.textureSet, 0, (uint32_t)slot});
+        m_batches.back().count++;
 
-    m_vertexData[nameVertex + nameIndex + nameTexture].uboData.push_back(std::make_pair(positionAndSize, MATH::Vec4{0,0,0,1}));
+        shape2dInstanceData data{instance.positionAndSize, instance.color, instance.uvRect};
+        if (slot < validCount && std::memcmp(&copy[slot], &data, sizeof(data)) == 0)
+            continue;
+        copy[slot] = data;
+        mapped[slot] = data;
+        m_dirtyBegin = std::min(m_dirtyBegin, slot);
+        m_dirtyEnd = std::max(m_dirtyEnd, slot + 1);
+        m_uploadedBytes += sizeof(data);
+    }
+    m_regionCounts[frame] = m_shapeCount;
 
-    m_vertexBufferMap[nameVertex] = &vertexBuffer;
-    m_indexBufferMap[nameIndex] = std::make_pair(&indexBuffer, indexCount);
-    m_textureMap[nameTexture] = &set;
+    if (!m_gpuCulling)
+        return;
+    // every instance of the batch goes in the count, the compute shader keeps the visible ones
+    if (m_batches.size() > m_drawCapacity)
+        growDrawBuffer(m_batches.size());
+    auto* draws = reinterpret_cast<VkDrawIndexedIndirectCommand*>(drawAddress + frame * m_drawRegionSize);
+    for (size_t i = 0; i < m_batches.size(); i++)
+        draws[i] = VkDrawIndexedIndirectCommand{(uint32_t)m_batches[i].indexCount, m_batches[i].count, 0, 0, m_batches[i].first};
 }
@@ -2,53 +2,101 @@
 #define SHAPE2D_H
 
 #include "VulkanRenderableObject.h"
-#include <map>
-#include <unordered_map>
+#include "RenderQueue.h"
 
-using shape2dUboData = BUFFER::shape2dUboData;
+using shape2dInstanceData = BUFFER::shape2dInstanceData;
 
 class Shape2d : public VulkanRenderableObject
 {
 public:
-    Shape2d() : VulkanRenderableObject("shape2d") { init(); };
-    void updateUBO() override;
+    // the name has to be unique, the pipelines are stored by it
+    Shape2d(const std::string& name = "shape2d") : VulkanRenderableObject(name) { init(); };
+    ~Shape2d();
+    void updateUBO(uint32_t frame) override;
     void resetFrameVariables() override;
     void createPipeline(PipelineManager* pm) override;
-    void createCommandBuffer(VkCommandBuffer& buffer) override;
+    void createCommandBuffer(VkCommandBuffer& buffer, uint32_t frame) override;
+    void createCommandBuffer(VkCommandBuffer& buffer, uint32_t frame, size_t firstDraw, size_t lastDraw) override;
+    size_t getDrawCount() override { return m_batches.size(); };
+    void createComputeCommands(VkCommandBuffer& buffer, uint32_t frame) override;
     void createUboBuffer(DeviceHandler* dh) override;
 
-    void addShape2dToDraw(const std::string &nameVertex, const std::string &nameIndex, MATH::Vec4& positionAndSize, MATH::Vec4 &color, VkBuffer& vertexBuffer, VkBuffer& indexBuffer, int indexCount);
-    void addShape2dToDraw(const std::string &nameVertex, const std::string &nameIndex, const std::string &nameTexture, MATH::Vec4& positionAndSize, VkDescriptorSet& set, VkBuffer& vertexBuffer, VkBuffer& indexBuffer, int indexCount);
+    // sorts the instances of the frame by their keys and writes them in that order straight into its region of the mapped
+    // buffer, only the ones that changed since the region was used the last time; updateUBO flushes the written range after it
+    void addShapes2dToDraw(const std::vector<RENDER::shape2dInstance>& instances, uint32_t frame);
+    size_t getUploadedBytes() override { return m_uploadedBytes; };
 
     size_t m_shapeCount{0};
 
 private:
     void init() override;
+    // waits for the frames in flight, the new buffer has room for at least the given instances per frame
+    void growInstanceBuffer(size_t instanceCount);
+    void growDrawBuffer(size_t drawCount);
+    // the dynamic offsets have to be multiples of the alignment, and the flushed ranges multiples of the atom size
+    VkDeviceSize alignRegion(VkDeviceSize size);
+    void flushRange(VkDeviceMemory memory, VkDeviceSize begin, VkDeviceSize end);
 
-    struct shapeData
+    // the sorted instances with the same key are drawn with one call, from first to first + count
+    struct batch
     {
-        std::vector<std::pair<MATH::Vec4, MATH::Vec4>> uboData;
-        std::string nameVertex;
-        std::string nameIndex;
-        std::string nameTexture{""};
+        uint64_t key{0};
+        VkBuffer vertexBuffer{VK_NULL_HANDLE};
+        VkBuffer indexBuffer{VK_NULL_HANDLE};
+        int indexCount{0};
+        VkDescriptorSet textureSet{VK_NULL_HANDLE};
+        uint32_t count{0};
+        uint32_t first{0};
     };
 
-    std::map<std::string, shapeData> m_vertexData;
-    shape2dUboData m_ubodata;
-    std::unordered_map<std::string, VkBuffer*> m_vertexBufferMap;
-    std::unordered_map<std::string, std::pair<VkBuffer*, int>> m_indexBufferMap;
-    std::unordered_map<std::string, VkDescriptorSet*> m_textureMap;
+    RenderQueue m_queue;
+    std::vector<batch> m_batches;
 
-    VkDescriptorSet ubo0Set{VK_NULL_HANDLE};
+    VkDescriptorSet ssbo0Set{VK_NULL_HANDLE};
     VkDescriptorSet sampler1Set{VK_NULL_HANDLE};
-    VkPipeline ubo0Sampler1Pipeline{VK_NULL_HANDLE};
-    VkPipelineLayout ubo0Sampler1Pipelinelayout{VK_NULL_HANDLE};
-    VkPipeline ubo0Pipeline{VK_NULL_HANDLE};
-    VkPipelineLayout ubo0Pipelinelayout{VK_NULL_HANDLE};
-
-    VkBuffer uboBuffer{VK_NULL_HANDLE};
-    VkDeviceMemory uboMemory{VK_NULL_HANDLE};
-    void* uboAddress{nullptr};
+    VkPipeline ssbo0Sampler1Pipeline{VK_NULL_HANDLE};
+    VkPipelineLayout ssbo0Sampler1Pipelinelayout{VK_NULL_HANDLE};
+    // only with descriptor indexing, the texture of every instance is selected from one array
+    VkPipeline ssbo0TextureArray1Pipeline{VK_NULL_HANDLE};
+    VkPipelineLayout ssbo0TextureArray1Pipelinelayout{VK_NULL_HANDLE};
+    VkPipeline ssbo0Pipeline{VK_NULL_HANDLE};
+    VkPipelineLayout ssbo0Pipelinelayout{VK_NULL_HANDLE};
+
+    // the instances of every frame in flight in one persistently mapped storage buffer, each frame writes its own region
+    // the dynamic offset of the descriptor set selects the region; the buffer doubles when a frame has more instances
+    DeviceHandler* m_deviceHandler{nullptr};
+    PipelineManager* m_pipelineManager{nullptr};
+    const size_t m_initialInstanceCapacity{4096};
+    size_t m_instanceCapacity{0};
+    VkDeviceSize m_instanceRegionSize{0};
+    VkBuffer instanceBuffer{VK_NULL_HANDLE};
+    VkDeviceMemory instanceMemory{VK_NULL_HANDLE};
+    char* instanceAddress{nullptr};
+
+    // the memory does not have to be host coherent: the written range of the frame is flushed, aligned to the atom size
+    // a copy of every region tells which instances changed, the mapped memory itself is not read back
+    VkDeviceSize m_atomSize{1};
+    std::vector<std::vector<shape2dInstanceData>> m_regionCopies;
+    std::vector<size_t> m_regionCounts; // the valid instances in the region, the ones after it are always written
+    size_t m_dirtyBegin{0};
+    size_t m_dirtyEnd{0};
+    size_t m_uploadedBytes{0};
+
+    // the culling on the GPU: the compute shader writes the visible instances of every batch in order to the visible buffer,
+    // and their count to the indirect draw command of the batch; the draws read the visible buffer instead of the instances
+    // the visible buffer has the same regions as the instance buffer, the draw commands have a region per frame in flight too
+    bool m_gpuCulling{false};
+    VkPipeline cullPipeline{VK_NULL_HANDLE};
+    VkPipelineLayout cullPipelinelayout{VK_NULL_HANDLE};
+    VkDescriptorSet cullSet{VK_NULL_HANDLE};
+    VkBuffer visibleBuffer{VK_NULL_HANDLE};
+    VkDeviceMemory visibleMemory{VK_NULL_HANDLE};
+    const size_t m_initialDrawCapacity{256};
+    size_t m_drawCapacity{0};
+    VkDeviceSize m_drawRegionSize{0};
+    VkBuffer drawBuffer{VK_NULL_HANDLE};
+    VkDeviceMemory drawMemory{VK_NULL_HANDLE};
+    char* drawAddress{nullptr};
 };
 
 #endif
\ No newline at end of file
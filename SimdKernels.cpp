@@ -0,0 +1,300 @@
+#include "SimdKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// gcc and clang only generate AVX2 code in the functions that ask for it, the rest of the program runs on any x86 CPU
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+namespace SIMD
+{
+    static level s_level{detect()};
+
+    void boxes::clear()
+    {
+        posX.clear(); posY.clear();
+        velX.clear(); velY.clear();
+        halfW.clear(); halfH.clear();
+        ids.clear();
+    }
+
+    void boxes::reserve(size_t count)
+    {
+        posX.reserve(count); posY.reserve(count);
+        velX.reserve(count); velY.reserve(count);
+        halfW.reserve(count); halfH.reserve(count);
+        ids.reserve(count);
+    }
+
+    void boxes::add(size_t id, const MATH::Vec2& pos, const MATH::Vec2& vel, const MATH::Vec2& half)
+    {
+        posX.push_back(pos.x); posY.push_back(pos.y);
+        velX.push_back(vel.x); velY.push_back(vel.y);
+        halfW.push_back(half.x); halfH.push_back(half.y);
+        ids.push_back(id);
+    }
+
+    level detect()
+    {
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return level::AVX2;
+        return level::SSE;
+#elif defined(SIMD_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        bool osUsesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+        __cpuidex(info, 7, 0);
+        if (osUsesAVX && (info[1] & (1 << 5)))
+            return level::AVX2;
+        return level::SSE;
+#else
+        return level::SCALAR;
+#endif
+    }
+
+    level active()
+    {
+        return s_level;
+    }
+
+    void setLevel(level newLevel)
+    {
+        // never above what the CPU can run
+        s_level = ((int)newLevel > (int)detect()) ? detect() : newLevel;
+    }
+
+    const char* levelName(level lvl)
+    {
+        switch (lvl)
+        {
+            case level::AVX2: return "AVX2";
+            case level::SSE: return "SSE";
+            default: return "scalar";
+        }
+    }
+
+    // scalar versions, also the tails of the SIMD loops
+
+    static void integrateScalar(boxes& data, float scale, size_t from)
+    {
+        for (size_t i = from; i < data.size(); i++)
+        {
+            data.posX[i] = data.posX[i] + data.velX[i] * scale;
+            data.posY[i] = data.posY[i] + data.velY[i] * scale;
+        }
+    }
+
+    static void overlapOneScalar(const boxes& data, const COLLISION::aabb& box, std::vector<uint32_t>& res, size_t from)
+    {
+        for (size_t i = from; i < data.size(); i++)
+        {
+            if (data.posX[i] - data.halfW[i] < box.max.x && data.posX[i] + data.halfW[i] > box.min.x &&
+                data.posY[i] - data.halfH[i] < box.max.y && data.posY[i] + data.halfH[i] > box.min.y)
+                res.push_back(i);
+        }
+    }
+
+    static void overlapRowScalar(const boxes& data, uint32_t i, const COLLISION::aabb& one, std::vector<indexPair>& res, size_t from)
+    {
+        for (size_t j = from; j < data.size(); j++)
+        {
+            if (one.min.x < data.posX[j] + data.halfW[j] && one.max.x > data.posX[j] - data.halfW[j] &&
+                one.min.y < data.posY[j] + data.halfH[j] && one.max.y > data.posY[j] - data.halfH[j])
+                res.push_back(indexPair{i, (uint32_t)j});
+        }
+    }
+
+    static COLLISION::aabb boxAt(const boxes& data, size_t i)
+    {
+        return COLLISION::aabb{
+            MATH::Vec2{data.posX[i] - data.halfW[i], data.posY[i] - data.halfH[i]},
+            MATH::Vec2{data.posX[i] + data.halfW[i], data.posY[i] + data.halfH[i]}
+            };
+    }
+
+#ifdef SIMD_X86
+    static int lowestBit(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return idx;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // SSE2 is part of every x86-64 CPU, these need no runtime check
+
+    static size_t integrateSSE(boxes& data, float scale)
+    {
+        __m128 s = _mm_set1_ps(scale);
+        size_t i = 0;
+        for (; i + 4 <= data.size(); i += 4)
+        {
+            __m128 px = _mm_loadu_ps(&data.posX[i]);
+            __m128 py = _mm_loadu_ps(&data.posY[i]);
+            px = _mm_add_ps(px, _mm_mul_ps(_mm_loadu_ps(&data.velX[i]), s));
+            py = _mm_add_ps(py, _mm_mul_ps(_mm_loadu_ps(&data.velY[i]), s));
+            _mm_storeu_ps(&data.posX[i], px);
+            _mm_storeu_ps(&data.posY[i], py);
+        }
+        return i;
+    }
+
+    static size_t overlapOneSSE(const boxes& data, const COLLISION::aabb& box, std::vector<uint32_t>& res)
+    {
+        __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+        __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+        size_t i = 0;
+        for (; i + 4 <= data.size(); i += 4)
+        {
+            __m128 px = _mm_loadu_ps(&data.posX[i]), hw = _mm_loadu_ps(&data.halfW[i]);
+            __m128 py = _mm_loadu_ps(&data.posY[i]), hh = _mm_loadu_ps(&data.halfH[i]);
+            __m128 hit = _mm_and_ps(
+                _mm_and_ps(_mm_cmplt_ps(_mm_sub_ps(px, hw), maxX), _mm_cmpgt_ps(_mm_add_ps(px, hw), minX)),
+                _mm_and_ps(_mm_cmplt_ps(_mm_sub_ps(py, hh), maxY), _mm_cmpgt_ps(_mm_add_ps(py, hh), minY)));
+            unsigned int mask = _mm_movemask_ps(hit);
+            while (mask)
+            {
+                res.push_back(i + lowestBit(mask));
+                mask &= mask - 1;
+            }
+        }
+        return i;
+    }
+
+    static size_t overlapRowSSE(const boxes& data, uint32_t i, const COLLISION::aabb& one, std::vector<indexPair>& res, size_t from)
+    {
+        __m128 minX = _mm_set1_ps(one.min.x), maxX = _mm_set1_ps(one.max.x);
+        __m128 minY = _mm_set1_ps(one.min.y), maxY = _mm_set1_ps(one.max.y);
+        size_t j = from;
+        for (; j + 4 <= data.size(); j += 4)
+        {
+            __m128 px = _mm_loadu_ps(&data.posX[j]), hw = _mm_loadu_ps(&data.halfW[j]);
+            __m128 py = _mm_loadu_ps(&data.posY[j]), hh = _mm_loadu_ps(&data.halfH[j]);
+            __m128 hit = _mm_and_ps(
+                _mm_and_ps(_mm_cmplt_ps(minX, _mm_add_ps(px, hw)), _mm_cmpgt_ps(maxX, _mm_sub_ps(px, hw))),
+                _mm_and_ps(_mm_cmplt_ps(minY, _mm_add_ps(py, hh)), _mm_cmpgt_ps(maxY, _mm_sub_ps(py, hh))));
+            unsigned int mask = _mm_movemask_ps(hit);
+            while (mask)
+            {
+                res.push_back(indexPair{i, (uint32_t)(j + lowestBit(mask))});
+                mask &= mask - 1;
+            }
+        }
+        return j;
+    }
+
+    SIMD_TARGET_AVX2 static size_t integrateAVX2(boxes& data, float scale)
+    {
+        __m256 s = _mm256_set1_ps(scale);
+        size_t i = 0;
+        for (; i + 8 <= data.size(); i += 8)
+        {
+            __m256 px = _mm256_loadu_ps(&data.posX[i]);
+            __m256 py = _mm256_loadu_ps(&data.posY[i]);
+            px = _mm256_add_ps(px, _mm256_mul_ps(_mm256_loadu_ps(&data.velX[i]), s));
+            py = _mm256_add_ps(py, _mm256_mul_ps(_mm256_loadu_ps(&data.velY[i]), s));
+            _mm256_storeu_ps(&data.posX[i], px);
+            _mm256_storeu_ps(&data.posY[i], py);
+        }
+        return i;
+    }
+
+    SIMD_TARGET_AVX2 static size_t overlapOneAVX2(const boxes& data, const COLLISION::aabb& box, std::vector<uint32_t>& res)
+    {
+        __m256 minX = _mm256_set1_ps(box.min.x), maxX = _mm256_set1_ps(box.max.x);
+        __m256 minY = _mm256_set1_ps(box.min.y), maxY = _mm256_set1_ps(box.max.y);
+        size_t i = 0;
+        for (; i + 8 <= data.size(); i += 8)
+        {
+            __m256 px = _mm256_loadu_ps(&data.posX[i]), hw = _mm256_loadu_ps(&data.halfW[i]);
+            __m256 py = _mm256_loadu_ps(&data.posY[i]), hh = _mm256_loadu_ps(&data.halfH[i]);
+            __m256 hit = _mm256_and_ps(
+                _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(px, hw), maxX, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(px, hw), minX, _CMP_GT_OQ)),
+                _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(py, hh), maxY, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(py, hh), minY, _CMP_GT_OQ)));
+            unsigned int mask = _mm256_movemask_ps(hit);
+            while (mask)
+            {
+                res.push_back(i + lowestBit(mask));
+                mask &= mask - 1;
+            }
+        }
+        return i;
+    }
+
+    SIMD_TARGET_AVX2 static size_t overlapRowAVX2(const boxes& data, uint32_t i, const COLLISION::aabb& one, std::vector<indexPair>& res, size_t from)
+    {
+        __m256 minX = _mm256_set1_ps(one.min.x), maxX = _mm256_set1_ps(one.max.x);
+        __m256 minY = _mm256_set1_ps(one.min.y), maxY = _mm256_set1_ps(one.max.y);
+        size_t j = from;
+        for (; j + 8 <= data.size(); j += 8)
+        {
+            __m256 px = _mm256_loadu_ps(&data.posX[j]), hw = _mm256_loadu_ps(&data.halfW[j]);
+            __m256 py = _mm256_loadu_ps(&data.posY[j]), hh = _mm256_loadu_ps(&data.halfH[j]);
+            __m256 hit = _mm256_and_ps(
+                _mm256_and_ps(_mm256_cmp_ps(minX, _mm256_add_ps(px, hw), _CMP_LT_OQ), _mm256_cmp_ps(maxX, _mm256_sub_ps(px, hw), _CMP_GT_OQ)),
+                _mm256_and_ps(_mm256_cmp_ps(minY, _mm256_add_ps(py, hh), _CMP_LT_OQ), _mm256_cmp_ps(maxY, _mm256_sub_ps(py, hh), _CMP_GT_OQ)));
+            unsigned int mask = _mm256_movemask_ps(hit);
+            while (mask)
+            {
+                res.push_back(indexPair{i, (uint32_t)(j + lowestBit(mask))});
+                mask &= mask - 1;
+            }
+        }
+        return j;
+    }
+#endif
+
+    void integrate(boxes& data, float scale)
+    {
+        size_t done{0};
+#ifdef SIMD_X86
+        if (s_level == level::AVX2)
+            done = integrateAVX2(data, scale);
+        else if (s_level == level::SSE)
+            done = integrateSSE(data, scale);
+#endif
+        integrateScalar(data, scale, done);
+    }
+
+    void overlapOne(const boxes& data, const COLLISION::aabb& box, std::vector<uint32_t>& res)
+    {
+        size_t done{0};
+#ifdef SIMD_X86
+        if (s_level == level::AVX2)
+            done = overlapOneAVX2(data, box, res);
+        else if (s_level == level::SSE)
+            done = overlapOneSSE(data, box, res);
+#endif
+        overlapOneScalar(data, box, res, done);
+    }
+
+    void overlapAll(const boxes& data, std::vector<indexPair>& res)
+    {
+        for (uint32_t i = 0; i < data.size(); i++)
+        {
+            COLLISION::aabb one{boxAt(data, i)};
+            size_t done{i + 1u};
+#ifdef SIMD_X86
+            if (s_level == level::AVX2)
+                done = overlapRowAVX2(data, i, one, res, done);
+            else if (s_level == level::SSE)
+                done = overlapRowSSE(data, i, one, res, done);
+#endif
+            overlapRowScalar(data, i, one, res, done);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/// used sources from the internet:
+/// https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html
+/// https://gcc.gnu.org/onlinedocs/gcc/x86-Function-Attributes.html
+/// https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
+
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include "Collision.h"
+
+// batch versions of the movement and the AABB overlap checks over structure of arrays data
+// the same loop runs 1 (scalar), 4 (SSE) or 8 (AVX2) boxes at a time, the best one the CPU supports is picked at startup
+// every version gives the same result as the scalar one, there is no FMA so the rounding is the same too
+namespace SIMD
+{
+    enum class level
+    {
+        SCALAR = 0,
+        SSE,
+        AVX2
+    };
+
+    // one index per box; the half extents are floats, not the truncated ints of CAABB::halfWidth
+    struct boxes
+    {
+        std::vector<float> posX, posY;
+        std::vector<float> velX, velY;
+        std::vector<float> halfW, halfH;
+        std::vector<size_t> ids;
+
+        size_t size() const { return ids.size(); };
+        void clear();
+        void reserve(size_t count);
+        void add(size_t id, const MATH::Vec2& pos, const MATH::Vec2& vel, const MATH::Vec2& half);
+    };
+
+    using indexPair = std::pair<uint32_t, uint32_t>;
+
+    // the best level of this CPU
+    level detect();
+    // the level the kernels use now; it can be lowered, e.g. to compare the versions
+    level active();
+    void setLevel(level newLevel);
+    const char* levelName(level lvl);
+
+    // pos += vel * scale for every box
+    void integrate(boxes& data, float scale);
+    // indices of the boxes overlapping the given box, in increasing order
+    void overlapOne(const boxes& data, const COLLISION::aabb& box, std::vector<uint32_t>& res);
+    // every overlapping pair (i < j) once, ordered by i then j
+    void overlapAll(const boxes& data, std::vector<indexPair>& res);
+}
+
+#endif
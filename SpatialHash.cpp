@@ -0,0 +1,223 @@
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cmath>
+
+void SpatialHash::cellRange(const COLLISION::aabb& box, int& minX, int& minY, int& maxX, int& maxY)
+{
+    minX = (int)std::floor(box.min.x * m_invCellSize);
+    minY = (int)std::floor(box.min.y * m_invCellSize);
+    maxX = (int)std::floor(box.max.x * m_invCellSize);
+    maxY = (int)std::floor(box.max.y * m_invCellSize);
+}
+
+void SpatialHash::addToCells(uint32_t proxyIdx)
+{
+    auto& p = m_proxies[proxyIdx];
+    for (int y = p.minY; y <= p.maxY; y++)
+    {
+        for (int x = p.minX; x <= p.maxX; x++)
+        {
+            auto& c = m_cells[cellKey(x, y)];
+            c.x = x;
+            c.y = y;
+            c.proxies.push_back(proxyIdx);
+        }
+    }
+}
+
+void SpatialHash::removeFromCells(uint32_t proxyIdx)
+{
+    auto& p = m_proxies[proxyIdx];
+    for (int y = p.minY; y <= p.maxY; y++)
+    {
+        for (int x = p.minX; x <= p.maxX; x++)
+        {
+            auto it = m_cells.find(cellKey(x, y));
+            if (it == m_cells.end())
+                continue;
+            // the order in the cell does not matter, swap with the last one
+            auto& proxies = it->second.proxies;
+            auto found = std::find(proxies.begin(), proxies.end(), proxyIdx);
+            if (found != proxies.end())
+            {
+                *found = proxies.back();
+                proxies.pop_back();
+            }
+            // the cells left behind by the moving boxes would grow the map and slow down the queries
+            if (proxies.empty())
+                m_cells.erase(it);
+        }
+    }
+}
+
+void SpatialHash::removeProxy(uint32_t proxyIdx)
+{
+    removeFromCells(proxyIdx);
+    m_idToProxy.erase(m_proxies[proxyIdx].id);
+    m_proxies[proxyIdx].alive = false;
+    m_freeProxies.push_back(proxyIdx);
+}
+
+void SpatialHash::update(size_t id, const COLLISION::aabb& box)
+{
+    int minX, minY, maxX, maxY;
+    cellRange(box, minX, minY, maxX, maxY);
+
+    auto it = m_idToProxy.find(id);
+    if (it == m_idToProxy.end())
+    {
+        uint32_t proxyIdx;
+        if (!m_freeProxies.empty())
+        {
+            proxyIdx = m_freeProxies.back();
+            m_freeProxies.pop_back();
+        }
+        else
+        {
+            proxyIdx = m_proxies.size();
+            m_proxies.emplace_back();
+        }
+        auto& p = m_proxies[proxyIdx];
+        p = proxy{id, box, minX, minY, maxX, maxY, m_syncStamp, 0, true};
+        m_idToProxy.insert({id, proxyIdx});
+        addToCells(proxyIdx);
+        return;
+    }
+
+    auto& p = m_proxies[it->second];
+    p.box = box;
+    p.syncStamp = m_syncStamp;
+    if (p.minX == minX && p.minY == minY && p.maxX == maxX && p.maxY == maxY)
+        return;
+
+    removeFromCells(it->second);
+    p.minX = minX;
+    p.minY = minY;
+    p.maxX = maxX;
+    p.maxY = maxY;
+    addToCells(it->second);
+}
+
+void SpatialHash::remove(size_t id)
+{
+    auto it = m_idToProxy.find(id);
+    if (it != m_idToProxy.end())
+        removeProxy(it->second);
+}
+
+void SpatialHash::removeStale()
+{
+    for (uint32_t i = 0; i < m_proxies.size(); i++)
+    {
+        if (m_proxies[i].alive && m_proxies[i].syncStamp != m_syncStamp)
+            removeProxy(i);
+    }
+    m_syncStamp++;
+}
+
+void SpatialHash::clear()
+{
+    m_proxies.clear();
+    m_freeProxies.clear();
+    m_idToProxy.clear();
+    m_cells.clear();
+}
+
+void SpatialHash::query(const COLLISION::aabb& box, std::vector<size_t>& res)
+{
+    int minX, minY, maxX, maxY;
+    cellRange(box, minX, minY, maxX, maxY);
+    // a box can be in more cells, the stamp makes sure it is added only once
+    m_queryStamp++;
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            auto it = m_cells.find(cellKey(x, y));
+            if (it == m_cells.end())
+                continue;
+            for (auto proxyIdx: it->second.proxies)
+            {
+                auto& p = m_proxies[proxyIdx];
+                if (p.queryStamp == m_queryStamp)
+                    continue;
+                p.queryStamp = m_queryStamp;
+                if (COLLISION::overlap(p.box, box))
+                    res.push_back(p.id);
+            }
+        }
+    }
+}
+
+void SpatialHash::queryPoint(const MATH::Vec2& point, std::vector<size_t>& res)
+{
+    auto it = m_cells.find(cellKey((int)std::floor(point.x * m_invCellSize), (int)std::floor(point.y * m_invCellSize)));
+    if (it == m_cells.end())
+        return;
+    for (auto proxyIdx: it->second.proxies)
+    {
+        if (COLLISION::pointInside(point, m_proxies[proxyIdx].box))
+            res.push_back(m_proxies[proxyIdx].id);
+    }
+}
+
+void SpatialHash::raycast(const MATH::Vec2& from, const MATH::Vec2& to, std::vector<size_t>& res)
+{
+    // the cells under the bounding box of the segment, good enough for the short rays of the game
+    COLLISION::aabb bounds{
+        MATH::Vec2{std::min(from.x, to.x), std::min(from.y, to.y)},
+        MATH::Vec2{std::max(from.x, to.x), std::max(from.y, to.y)}
+        };
+    int minX, minY, maxX, maxY;
+    cellRange(bounds, minX, minY, maxX, maxY);
+    m_queryStamp++;
+    m_rayHits.clear();
+
+    MATH::Vec2 delta{to - from};
+    for (int y = minY; y <= maxY; y++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            auto it = m_cells.find(cellKey(x, y));
+            if (it == m_cells.end())
+                continue;
+            for (auto proxyIdx: it->second.proxies)
+            {
+                auto& p = m_proxies[proxyIdx];
+                if (p.queryStamp == m_queryStamp)
+                    continue;
+                p.queryStamp = m_queryStamp;
+                float time;
+                if (COLLISION::raycast(from, delta, p.box, time))
+                    m_rayHits.push_back({time, p.id});
+            }
+        }
+    }
+
+    std::sort(m_rayHits.begin(), m_rayHits.end());
+    for (auto& hit: m_rayHits)
+        res.push_back(hit.second);
+}
+
+void SpatialHash::findPairs(std::vector<idPair>& res)
+{
+    for (auto& [key, c]: m_cells)
+    {
+        auto& proxies = c.proxies;
+        for (size_t i = 0; i < proxies.size(); i++)
+        {
+            auto& one = m_proxies[proxies[i]];
+            for (size_t j = i + 1; j < proxies.size(); j++)
+            {
+                auto& two = m_proxies[proxies[j]];
+                // two boxes can share more cells, the pair is reported only in the first common one
+                if (std::max(one.minX, two.minX) != c.x || std::max(one.minY, two.minY) != c.y)
+                    continue;
+                if (!COLLISION::overlap(one.box, two.box))
+                    continue;
+                res.push_back(one.id < two.id ? idPair{one.id, two.id} : idPair{two.id, one.id});
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/// used sources from the internet:
+/// https://www.gamedev.net/tutorials/programming/general-and-gameplay-programming/spatial-hashing-r2697/
+/// https://matthias-research.github.io/pages/tenMinutePhysics/11-hashing.pdf
+
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "Broadphase.h"
+
+// uniform grid broadphase, the cells are stored in a hash map so the world has no bounds
+// every box is listed in all the cells it covers; when it moves inside the same cells only the box is updated
+class SpatialHash: public Broadphase
+{
+private:
+    struct proxy
+    {
+        size_t id{0};
+        COLLISION::aabb box{};
+        int minX{0}, minY{0}, maxX{0}, maxY{0};
+        uint32_t syncStamp{0};
+        uint32_t queryStamp{0};
+        bool alive{false};
+    };
+
+    struct cell
+    {
+        int x{0}, y{0};
+        std::vector<uint32_t> proxies;
+    };
+
+    float m_cellSize{64.f};
+    float m_invCellSize{1.f / 64.f};
+
+    std::vector<proxy> m_proxies;
+    std::vector<uint32_t> m_freeProxies;
+    std::unordered_map<size_t, uint32_t> m_idToProxy;
+    std::unordered_map<uint64_t, cell> m_cells;
+    uint32_t m_syncStamp{1};
+    uint32_t m_queryStamp{0};
+    std::vector<std::pair<float, size_t>> m_rayHits;
+
+    static uint64_t cellKey(int x, int y) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y; };
+    void cellRange(const COLLISION::aabb& box, int& minX, int& minY, int& maxX, int& maxY);
+    void addToCells(uint32_t proxyIdx);
+    void removeFromCells(uint32_t proxyIdx);
+    void removeProxy(uint32_t proxyIdx);
+
+public:
+    SpatialHash() {};
+    SpatialHash(float cellSize): m_cellSize(cellSize), m_invCellSize(1.f / cellSize) {};
+
+    void update(size_t id, const COLLISION::aabb& box) override;
+    void remove(size_t id) override;
+    void removeStale() override;
+    void clear() override;
+    int size() override { return m_idToProxy.size(); };
+
+    void query(const COLLISION::aabb& box, std::vector<size_t>& res) override;
+    void queryPoint(const MATH::Vec2& point, std::vector<size_t>& res) override;
+    void raycast(const MATH::Vec2& from, const MATH::Vec2& to, std::vector<size_t>& res) override;
+    void findPairs(std::vector<idPair>& res) override;
+
+};
+
+#endif
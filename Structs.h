@@ -4,7 +4,9 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 #include <string>
+#include <cstdint>
 #include "Vector.h"
+#include "Action.h"
 
 namespace VERTEX
 {
@@ -96,6 +98,7 @@ namespace PIPELINE
     {
         std::string vertShaderPath{""};
         std::string fragShaderPath{""};
+        std::string compShaderPath{""}; // only the compute pipelines, they use none of the graphics state below
         std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
         std::vector<VkVertexInputBindingDescription> vertexInputBindings;
         std::vector<VkVertexInputAttributeDescription> vertexInputAttributes;
@@ -150,10 +153,14 @@ namespace BUFFER
         MATH::Vec4 vector[1000];
     };
 
-    struct shape2dUboData
+    // one element of the instance storage buffer, same layout as the std430 struct in the shape2d shaders
+    // the texture array shader does not use the color, its x is the index of the texture in the array
+    // uvRect is the part of the texture to draw, offset in xy and scale in zw, the atlas textures are only a part of their page
+    struct shape2dInstanceData
     {
-        MATH::Vec4 positionAndSize[2048];
-        MATH::Vec4 color[2048];
+        MATH::Vec4 positionAndSize;
+        MATH::Vec4 color;
+        MATH::Vec4 uvRect;
     };
 }
 
@@ -165,9 +172,93 @@ namespace TEXTURE
         VkDeviceMemory imageMemory{};
         VkImageView imageView{};
         VkDescriptorSet set{};
+        uint32_t arrayIndex{UINT32_MAX}; // the element in the texture array, UINT32_MAX if it only has its own set
+        // the textures packed in an atlas have no image of their own, they are a part of the page
+        uint32_t imageHandle{UINT32_MAX}; // the handle of the texture with the image, the same for everything on one page
+        MATH::Vec4 uvRect{0, 0, 1, 1}; // offset and scale of the texture coordinates in the image
         int width{0};
         int height{0};
     };
 }
 
+namespace LATENCY
+{
+    // the points an input goes through until it is on the screen
+    enum class stage : uint8_t
+    {
+        INPUT = 0, // SDL got the event
+        SIMULATED, // the step that handled it finished
+        RECORDED, // the command buffers of the frame are recorded
+        SUBMITTED, // vkQueueSubmit returned
+        PRESENTED, // the GPU finished the frame, seen when beginFrame waits for its slot again; the display shows it one refresh later at most with FIFO
+        COUNT
+    };
+
+    // one input event, performance counter ticks for each stage
+    struct sample
+    {
+        ACTION::id action{ACTION::id::NONE};
+        uint64_t time[(int)stage::COUNT]{};
+    };
+}
+
+namespace RENDER
+{
+    enum class pipeline : uint8_t
+    {
+        SHAPE2D = 0,
+        SHAPE2D_TEXTURE,
+        SHAPE2D_TEXTURE_ARRAY
+    };
+
+    // the draws are sorted by this key: the lower layers first, then the draws with the same pipeline, texture and mesh
+    // end up next to each other and are drawn with one call; the handles are the ones of the assetmanager
+    // bits from the highest: 16 layer, 4 pipeline, 16 texture, 14 vertex buffer, 14 index buffer,
+    // a bigger handle wraps around and shares the key of another one, the assetmanager warns when it hands one out
+    const uint32_t sortKeyTextureMask{0xFFFF};
+    const uint32_t sortKeyBufferMask{0x3FFF};
+    inline uint64_t shape2dSortKey(uint16_t layer, pipeline pipe, uint32_t texture, uint32_t vertex, uint32_t index)
+    {
+        return ((uint64_t)layer << 48)
+            | ((uint64_t)((uint8_t)pipe & 0xF) << 44)
+            | ((uint64_t)(texture & sortKeyTextureMask) << 28)
+            | ((uint64_t)(vertex & sortKeyBufferMask) << 14)
+            | (uint64_t)(index & sortKeyBufferMask);
+    }
+
+    inline pipeline sortKeyPipeline(uint64_t key) { return (pipeline)((key >> 44) & 0xF); }
+
+    // the textures of the array are selected per instance, so the texture does not split the batches
+    inline uint64_t sortKeyForTextureArray(uint64_t key)
+    {
+        return (key & ~((uint64_t)0xF << 44) & ~((uint64_t)0xFFFF << 28)) | ((uint64_t)pipeline::SHAPE2D_TEXTURE_ARRAY << 44);
+    }
+
+    // one shape to draw, with copies of the handles so it does not point into the entities or the assetmanager
+    struct shape2dInstance
+    {
+        uint64_t sortKey{0};
+        MATH::Vec4 positionAndSize{};
+        MATH::Vec4 color{};
+        MATH::Vec4 uvRect{0, 0, 1, 1};
+        VkBuffer vertexBuffer{VK_NULL_HANDLE};
+        VkBuffer indexBuffer{VK_NULL_HANDLE};
+        int indexCount{0};
+        VkDescriptorSet textureSet{VK_NULL_HANDLE};
+    };
+
+    // everything the renderer needs from one frame of the simulation, it is not changed after it is published
+    struct renderSnapshot
+    {
+        std::vector<shape2dInstance> shapes;
+        // only sent when the static layer changed, the renderer keeps them until the next change
+        std::vector<shape2dInstance> staticShapes;
+        bool staticChanged{false};
+        std::vector<LATENCY::sample> inputs; // the input handled by the steps of this frame, the renderer stamps the rest
+        uint64_t frame{0};
+
+        void clear() { shapes.clear(); staticShapes.clear(); staticChanged = false; inputs.clear(); };
+    };
+}
+
 #endif
\ No newline at end of file
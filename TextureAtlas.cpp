@@ -0,0 +1,131 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <climits>
+
+bool TextureAtlas::insert(int width, int height, rect& result)
+{
+    int paddedWidth{width + 2 * m_padding};
+    int paddedHeight{height + 2 * m_padding};
+    if (paddedWidth > m_pageSize || paddedHeight > m_pageSize)
+        return false;
+
+    int x{0}, y{0};
+    for (uint32_t i = 0; i < m_pages.size(); i++)
+    {
+        if (!insertToPage(m_pages[i], paddedWidth, paddedHeight, x, y))
+            continue;
+        m_pages[i].usedArea += (int64_t)width * height;
+        result = rect{i, x + m_padding, y + m_padding, width, height};
+        return true;
+    }
+
+    m_pages.push_back(page{});
+    m_pages.back().skyline.push_back(skylineNode{0, 0, m_pageSize});
+    insertToPage(m_pages.back(), paddedWidth, paddedHeight, x, y);
+    m_pages.back().usedArea += (int64_t)width * height;
+    result = rect{(uint32_t)m_pages.size() - 1, x + m_padding, y + m_padding, width, height};
+    return true;
+}
+
+int TextureAtlas::fit(const page& p, size_t node, int width, int height) const
+{
+    int x{p.skyline[node].x};
+    if (x + width > m_pageSize)
+        return -1;
+
+    // the rectangle lies on the highest of the nodes under it
+    int y{0};
+    int widthLeft{width};
+    for (size_t i = node; widthLeft > 0 && i < p.skyline.size(); i++)
+    {
+        y = std::max(y, p.skyline[i].y);
+        if (y + height > m_pageSize)
+            return -1;
+        widthLeft -= p.skyline[i].width;
+    }
+    return y;
+}
+
+bool TextureAtlas::insertToPage(page& p, int width, int height, int& x, int& y)
+{
+    int bestTop{INT_MAX};
+    int bestWidth{INT_MAX};
+    size_t bestNode{0};
+    for (size_t i = 0; i < p.skyline.size(); i++)
+    {
+        int nodeY{fit(p, i, width, height)};
+        if (nodeY < 0)
+            continue;
+        // the lowest top edge, then the narrower node so the wide gaps stay for the wide rectangles
+        if (nodeY + height < bestTop || (nodeY + height == bestTop && p.skyline[i].width < bestWidth))
+        {
+            bestTop = nodeY + height;
+            bestWidth = p.skyline[i].width;
+            bestNode = i;
+            y = nodeY;
+        }
+    }
+    if (bestTop == INT_MAX)
+        return false;
+
+    x = p.skyline[bestNode].x;
+    p.skyline.insert(p.skyline.begin() + bestNode, skylineNode{x, y + height, width});
+
+    // the nodes under the new one are cut off or removed
+    for (size_t i = bestNode + 1; i < p.skyline.size();)
+    {
+        auto& node = p.skyline[i];
+        int covered{x + width - node.x};
+        if (covered <= 0)
+            break;
+        if (covered < node.width)
+        {
+            node.x += covered;
+            node.width -= covered;
+            break;
+        }
+        p.skyline.erase(p.skyline.begin() + i);
+    }
+
+    // the neighbours on the same height become one node
+    for (size_t i = 0; i + 1 < p.skyline.size();)
+    {
+        if (p.skyline[i].y == p.skyline[i + 1].y)
+        {
+            p.skyline[i].width += p.skyline[i + 1].width;
+            p.skyline.erase(p.skyline.begin() + i + 1);
+        }
+        else
+            i++;
+    }
+
+    p.usedWidth = std::max(p.usedWidth, x + width);
+    p.usedHeight = std::max(p.usedHeight, y + height);
+    return true;
+}
+
+double TextureAtlas::occupancy(uint32_t page) const
+{
+    const auto& p = m_pages[page];
+    if (p.usedWidth == 0 || p.usedHeight == 0)
+        return 0.0;
+    return (double)p.usedArea / ((double)p.usedWidth * p.usedHeight);
+}
+
+double TextureAtlas::occupancy() const
+{
+    double used{0.0}, total{0.0};
+    for (const auto& p: m_pages)
+    {
+        used += (double)p.usedArea;
+        total += (double)p.usedWidth * p.usedHeight;
+    }
+    return total > 0.0 ? used / total : 0.0;
+}
+
+MATH::Vec4 TextureAtlas::uvRect(const rect& r) const
+{
+    float width{(float)pageWidth(r.page)};
+    float height{(float)pageHeight(r.page)};
+    return MATH::Vec4{r.x / width, r.y / height, r.width / width, r.height / height};
+}
@@ -0,0 +1,69 @@
+/// used sources from the internet:
+/// https://github.com/juj/RectangleBinPack/blob/master/RectangleBinPack.pdf
+/// https://jvernay.fr/en/blog/skyline-2d-packer/implementation/
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <vector>
+#include <cstdint>
+#include "Vector.h"
+
+// places rectangles on square pages with a skyline packer, bottom left rule: the lowest top edge wins
+// a new page is started when none of the pages has room; it only finds the places, the pixels are copied by the caller
+// every rectangle gets a border of padding around it, so the filtering at its edge does not read the neighbours
+class TextureAtlas
+{
+public:
+    struct rect
+    {
+        uint32_t page{0};
+        int x{0}; // the top left corner inside the padding
+        int y{0};
+        int width{0};
+        int height{0};
+    };
+
+    TextureAtlas(int pageSize, int padding) : m_pageSize(pageSize), m_padding(padding) {};
+
+    // false if the rectangle with its padding is larger than a page
+    bool insert(int width, int height, rect& result);
+
+    size_t pageCount() const { return m_pages.size(); };
+    int getPadding() const { return m_padding; };
+    // the pages are only as large as the rectangles on them need
+    int pageWidth(uint32_t page) const { return m_pages[page].usedWidth; };
+    int pageHeight(uint32_t page) const { return m_pages[page].usedHeight; };
+    // the pixels of the rectangles without the padding against the used size of the page, 0..1
+    double occupancy(uint32_t page) const;
+    double occupancy() const;
+    // only valid after the last insert, the used size of the page can still grow before it
+    // offset in xy and scale in zw, the texture coordinate in the page is offset + coordinate * scale
+    MATH::Vec4 uvRect(const rect& r) const;
+
+private:
+    struct skylineNode
+    {
+        int x;
+        int y;
+        int width;
+    };
+
+    struct page
+    {
+        std::vector<skylineNode> skyline;
+        int usedWidth{0};
+        int usedHeight{0};
+        int64_t usedArea{0};
+    };
+
+    const int m_pageSize;
+    const int m_padding;
+    std::vector<page> m_pages;
+
+    // the y of the rectangle if its left edge is at the node, -1 if it does not fit there
+    int fit(const page& p, size_t node, int width, int height) const;
+    bool insertToPage(page& p, int width, int height, int& x, int& y);
+};
+
+#endif
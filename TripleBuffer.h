@@ -0,0 +1,47 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// one producer writes the back buffer while one consumer reads the front buffer, they exchange through the middle one
+// publish and consume are one atomic exchange each, neither side waits for the other
+// if the producer publishes twice before the consumer takes it, the older one is dropped, the consumer always gets the newest
+template<typename T>
+class TripleBuffer
+{
+private:
+    static constexpr uint8_t INDEX_MASK{3};
+    static constexpr uint8_t NEW_BIT{4}; // the middle buffer was published and not consumed yet
+
+    std::array<T, 3> m_buffers{};
+    std::atomic<uint8_t> m_middle{1};
+    uint8_t m_back{0}; // only the producer uses it
+    uint8_t m_front{2}; // only the consumer uses it
+
+public:
+    // producer side
+    T& back() { return m_buffers[m_back]; };
+    // the back buffer becomes the newest, back() gives an older buffer to overwrite after this
+    void publish()
+    {
+        uint8_t old{m_middle.exchange(m_back | NEW_BIT, std::memory_order_acq_rel)};
+        m_back = old & INDEX_MASK;
+    };
+
+    // consumer side, false if nothing new was published since the last call
+    bool consume()
+    {
+        if (!(m_middle.load(std::memory_order_acquire) & NEW_BIT))
+            return false;
+        uint8_t old{m_middle.exchange(m_front, std::memory_order_acq_rel)};
+        m_front = old & INDEX_MASK;
+        return true;
+    };
+    const T& front() const { return m_buffers[m_front]; };
+
+    bool hasNew() const { return m_middle.load(std::memory_order_acquire) & NEW_BIT; };
+};
+
+#endif
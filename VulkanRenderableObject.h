@@ -14,11 +14,20 @@ class VulkanRenderableObject
 public:
     VulkanRenderableObject() = delete;
     VulkanRenderableObject(const std::string& name) : m_name(name) {};
-    virtual void updateUBO() = 0;
+    // every frame in flight has its own instance data, the GPU can still read the one of the previous frame
+    virtual void updateUBO(uint32_t frame) = 0;
     virtual void resetFrameVariables() = 0;
     virtual void createUboBuffer(DeviceHandler* dh) = 0;
     virtual void createPipeline(PipelineManager* pm) = 0;
-    virtual void createCommandBuffer(VkCommandBuffer& buffer) = 0;
+    virtual void createCommandBuffer(VkCommandBuffer& buffer, uint32_t frame) = 0;
+    // records only the draws from firstDraw to lastDraw, the parts can be recorded into different buffers at the same time
+    virtual void createCommandBuffer(VkCommandBuffer& buffer, uint32_t frame, size_t firstDraw, size_t lastDraw) = 0;
+    // the draw calls of the frame, the unit the recording is split by
+    virtual size_t getDrawCount() = 0;
+    // records into the primary before the render pass, the draws of the frame can depend on it
+    virtual void createComputeCommands(VkCommandBuffer& buffer, uint32_t frame) = 0;
+    // written to the GPU visible memory for the last frame
+    virtual size_t getUploadedBytes() = 0;
 
     std::string &getName() { return m_name; };
 
@@ -4,8 +4,12 @@
 #include <math.h>
 #include "Logger.h"
 #include "Shape2d.h"
+#include "LatencyTracker.h"
+#include "JobSystem.h"
 
 #include <fstream>
+#include <chrono>
+#include <algorithm>
 
 VulkanRenderer::VulkanRenderer(SDL_Window* window)
     : m_window(window)
@@ -24,16 +28,42 @@ VulkanRenderer::VulkanRenderer(SDL_Window* window)
         obj.second->createUboBuffer(m_deviceHandler);
         obj.second->createPipeline(m_pipelineManager);
     }
+    m_staticLayer = new Shape2d("shape2dStatic");
+    m_staticLayer->createUboBuffer(m_deviceHandler);
+    m_staticLayer->createPipeline(m_pipelineManager);
 
-    createPrimaryCommandBuffer(m_primaryCommandBuffer);
-    m_secondaryCommandBuffer.resize(m_renderTheseObjects.size());
-    createSecondaryCommandBuffer(m_secondaryCommandBuffer);
+    uint32_t frames{m_deviceHandler->getFramesInFlight()};
+    m_primaryCommandBuffers.resize(frames);
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        createPrimaryCommandBuffer(m_primaryCommandBuffers[i]);
+    }
+    m_staticLayerBuffers.resize(frames);
+    createSecondaryCommandBuffer(m_staticLayerBuffers);
+    m_staticLayerStale.assign(frames, true);
+    m_staticLayerSnapshots.assign(frames, UINT64_MAX);
+    m_frameOldestSnapshot.assign(frames, UINT64_MAX);
+    m_presentedInputs.resize(frames);
+
+    // one part per object until there is a job system
+    m_partPools.resize(frames);
+    m_partBuffers.resize(frames);
+    createPartPools(m_renderTheseObjects.size());
 }
 
 VulkanRenderer::~VulkanRenderer()
 {
+    stopRenderThread();
+    // the frames in flight still use the buffers of the objects
+    m_deviceHandler->waitIdle();
+    destroyRetiredResources(true);
     for (auto& obj: m_renderTheseObjects) { delete obj.second; }
     m_renderTheseObjects.clear();
+    delete m_staticLayer;
+    for (auto& pools: m_partPools)
+    {
+        for (auto& pool: pools) { m_deviceHandler->destroyCommandPool(pool); }
+    }
     delete m_pipelineManager;
     delete m_deviceHandler;
 }
@@ -48,6 +78,35 @@ void VulkanRenderer::createSecondaryCommandBuffer(std::vector<VkCommandBuffer>&
     m_deviceHandler->createCommandBuffer(buffer, VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_SECONDARY);
 }
 
+void VulkanRenderer::createPartPools(size_t partCount)
+{
+    for (uint32_t frame = 0; frame < m_partPools.size(); frame++)
+    {
+        auto& pools = m_partPools[frame];
+        auto& buffers = m_partBuffers[frame];
+        while (pools.size() < partCount)
+        {
+            // the buffers are recorded again every frame, the whole pool is reset instead of the buffers one by one
+            VkCommandPool pool{VK_NULL_HANDLE};
+            m_deviceHandler->createCommandPool(pool, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+            std::vector<VkCommandBuffer> buffer(1);
+            m_deviceHandler->createCommandBuffer(buffer, VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_SECONDARY, pool);
+            pools.push_back(pool);
+            buffers.push_back(buffer[0]);
+        }
+    }
+}
+
+void VulkanRenderer::setJobSystem(JobSystem* jobSystem)
+{
+    std::lock_guard<std::mutex> lock(m_deviceMutex);
+    m_jobSystem = jobSystem;
+    // the thread that renders records a part too
+    size_t partsPerObject{m_jobSystem ? (size_t)m_jobSystem->getWorkerCount() + 1 : 1};
+    createPartPools(partsPerObject * m_renderTheseObjects.size());
+    Logger::Instance()->logInfo("VulkanRenderer: the objects are recorded in up to " + std::to_string(partsPerObject) + " parts");
+}
+
 std::vector<MATH::Vec4> VulkanRenderer::load2dVertexFile(const std::string& pathToFile)
 {
     float x, y, tx, ty;
@@ -78,6 +137,9 @@ std::vector<uint32_t> VulkanRenderer::loadIndexFile(const std::string& pathToFil
 
 bool VulkanRenderer::createAndCopyDataToGPUSideBuffer(VkBuffer& buffer, VkBufferUsageFlags flags, VkDeviceMemory& bufferMemory, VkDeviceSize size, void* dataPointer)
 {
+    // the copy is submitted to the graphics queue
+    std::lock_guard<std::mutex> lock(m_deviceMutex);
+
     // create a temporary stagingBuffer that will be the sourceBuffer to copy from to the GPU
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingMemory;
@@ -124,27 +186,244 @@ bool VulkanRenderer::createAndCopyDataToCPUSideBuffer(VkBuffer& buffer, VkBuffer
 
 void VulkanRenderer::drawFrame()
 {
-    // update the UBOs to transfer the new data to the shaders
-    for (auto& obj: m_renderTheseObjects)
+    m_snapshots.back().frame = m_snapshotFrame++;
+
+    if (!m_renderThread.joinable())
+    {
+        m_snapshots.publish();
+        m_snapshots.back().clear();
+        m_snapshots.consume();
+        renderSnapshot(m_snapshots.front());
+        return;
+    }
+
     {
-        obj.second->updateUBO();
+        // the simulation can be one frame ahead of the rendering, not more; the FIFO present still paces both of them
+        std::unique_lock<std::mutex> lock(m_renderMutex);
+        m_renderCondition.wait(lock, [this]{ return !m_snapshots.hasNew() || !m_renderThreadRunning; });
+        m_snapshots.publish();
     }
+    m_renderCondition.notify_all();
+    m_snapshots.back().clear();
+}
+
+void VulkanRenderer::startRenderThread()
+{
+    if (m_renderThread.joinable())
+        return;
+    m_renderThreadRunning = true;
+    m_renderThread = std::thread(&VulkanRenderer::renderThreadLoop, this);
+    Logger::Instance()->logInfo("VulkanRenderer: render thread started");
+}
 
-    int i{0};
+void VulkanRenderer::stopRenderThread()
+{
+    if (!m_renderThread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_renderMutex);
+        m_renderThreadRunning = false;
+    }
+    m_renderCondition.notify_all();
+    m_renderThread.join();
+}
+
+void VulkanRenderer::renderThreadLoop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_renderMutex);
+            m_renderCondition.wait(lock, [this]{ return m_snapshots.hasNew() || !m_renderThreadRunning; });
+            if (!m_renderThreadRunning)
+                break;
+            m_snapshots.consume();
+        }
+        // the main thread can publish the next snapshot while this one is drawn
+        m_renderCondition.notify_all();
+
+        renderSnapshot(m_snapshots.front());
+    }
+}
+
+void VulkanRenderer::renderSnapshot(const RENDER::renderSnapshot& snapshot)
+{
+    std::lock_guard<std::mutex> lock(m_deviceMutex);
+    auto drawStart = std::chrono::steady_clock::now();
+    // waits only for the GPU to finish the frame that used this slot before, the other one can still be drawn
+    uint32_t frame{m_deviceHandler->beginFrame()};
+
+    // the inputs of the frame that used this slot before are on the screen now
+    if (m_latencyTracker && !m_presentedInputs[frame].empty())
+    {
+        for (auto& sample: m_presentedInputs[frame]) { sample.time[(int)LATENCY::stage::PRESENTED] = m_deviceHandler->getFrameFinishedTime(); }
+        m_latencyTracker->add(m_presentedInputs[frame]);
+    }
+    m_presentedInputs[frame].clear();
+
+    if (snapshot.staticChanged)
+    {
+        m_staticShapes = snapshot.staticShapes;
+        m_staticShapesSnapshot = snapshot.frame;
+        m_staticLayerStale.assign(m_staticLayerStale.size(), true);
+    }
+    bool staticRecorded{m_staticLayerStale[frame]};
+    if (staticRecorded)
+        recordStaticLayer(frame);
+
+    auto shape = static_cast<Shape2d*>(m_renderTheseObjects["shape2d"]);
+    shape->addShapes2dToDraw(snapshot.shapes, frame);
+
+    // update the UBOs to transfer the new data to the shaders
     for (auto& obj: m_renderTheseObjects)
     {
-        m_deviceHandler->recordRenderSecondaryCommandBufferStart(m_secondaryCommandBuffer[i]);
-        obj.second->createCommandBuffer(m_secondaryCommandBuffer[i]);
-        m_deviceHandler->recordEndCommandBuffer(m_secondaryCommandBuffer[i]);
-        i++;
+        obj.second->updateUBO(frame);
+        m_uploadedBytesSum += obj.second->getUploadedBytes();
     }
 
+    recordParts(frame);
+
+    m_executedBuffers.clear();
+    m_executedBuffers.push_back(m_staticLayerBuffers[frame]);
+    for (auto& part: m_parts) { m_executedBuffers.push_back(part.buffer); }
+
     // create the main command buffer with all of the secondary command buffers
-    m_deviceHandler->recordRenderPrimaryCommandBuffer(m_primaryCommandBuffer, m_secondaryCommandBuffer);
+    // after the acquire, so it uses the framebuffer of the acquired image
+    // the culling of the objects runs before the render pass, the static layer keeps its visible instances until it is recorded again
+    m_deviceHandler->recordRenderPrimaryCommandBuffer(m_primaryCommandBuffers[frame], m_executedBuffers, [this, frame, staticRecorded](VkCommandBuffer& buffer)
+    {
+        if (staticRecorded)
+            m_staticLayer->createComputeCommands(buffer, frame);
+        for (auto& obj: m_renderTheseObjects) { obj.second->createComputeCommands(buffer, frame); }
+    });
+    uint64_t recordedTime{SDL_GetPerformanceCounter()};
     // after we update all of the UBOs we can render the frame
-    m_deviceHandler->drawFrame(m_primaryCommandBuffer);
+    m_deviceHandler->submitFrame(m_primaryCommandBuffers[frame]);
+    m_frameOldestSnapshot[frame] = std::min(snapshot.frame, m_staticLayerSnapshots[frame]);
+    destroyRetiredResources(false);
+
+    // the present stage is stamped when the next beginFrame of this slot waited for the GPU
+    if (m_latencyTracker && !snapshot.inputs.empty())
+    {
+        m_presentedInputs[frame].assign(snapshot.inputs.begin(), snapshot.inputs.end());
+        for (auto& sample: m_presentedInputs[frame])
+        {
+            sample.time[(int)LATENCY::stage::RECORDED] = recordedTime;
+            sample.time[(int)LATENCY::stage::SUBMITTED] = m_deviceHandler->getSubmitTime();
+        }
+    }
     // reset all of the variables so we can start and handle the next frame
     for (auto& obj: m_renderTheseObjects) { obj.second->resetFrameVariables(); }
+    if (staticRecorded)
+        m_staticLayer->resetFrameVariables();
+
+    m_drawTimeSum += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drawStart).count();
+    m_fenceWaitSum += m_deviceHandler->getFenceWaitMs();
+    m_gpuTimeSum += m_deviceHandler->getGpuMs();
+    m_partsSum += (int)m_parts.size();
+    m_drawTimeFrames++;
+}
+
+void VulkanRenderer::recordParts(uint32_t frame)
+{
+    // the GPU finished the last use of the frame, every buffer of its pools can be recorded again
+    for (auto& pool: m_partPools[frame]) { m_deviceHandler->resetCommandPool(pool); }
+
+    // the parts of an object get about the same number of draws, a small object stays in one part
+    m_parts.clear();
+    size_t maxParts{m_partPools[frame].size() / m_renderTheseObjects.size()};
+    for (auto& obj: m_renderTheseObjects)
+    {
+        size_t draws{obj.second->getDrawCount()};
+        size_t parts{std::clamp<size_t>((draws + m_drawsPerPart - 1) / m_drawsPerPart, 1, maxParts)};
+        for (size_t p = 0; p < parts; p++)
+        {
+            VkCommandBuffer buffer{m_partBuffers[frame][m_parts.size()]};
+            m_parts.push_back(recordingPart{obj.second, draws * p / parts, draws * (p + 1) / parts, buffer});
+        }
+    }
+
+    // the first part is recorded here, the thread would only wait for the workers otherwise
+    // the wait runs the parts not started yet on this thread too, the render thread is a helper of the job system
+    JobSystem::counter done{0};
+    for (size_t p = 1; p < m_parts.size(); p++)
+    {
+        if (m_jobSystem)
+            m_jobSystem->run([this, p, frame]() { recordPart(m_parts[p], frame); }, &done);
+        else
+            recordPart(m_parts[p], frame);
+    }
+    recordPart(m_parts[0], frame);
+    if (m_jobSystem)
+        m_jobSystem->wait(done);
+}
+
+void VulkanRenderer::recordPart(const recordingPart& part, uint32_t frame)
+{
+    VkCommandBuffer buffer{part.buffer};
+    m_deviceHandler->recordRenderSecondaryCommandBufferStart(buffer);
+    part.object->createCommandBuffer(buffer, frame, part.firstDraw, part.lastDraw);
+    m_deviceHandler->recordEndCommandBuffer(buffer);
+}
+
+void VulkanRenderer::destroyRetiredResources(bool destroyAll)
+{
+    // the frames before them finished, the published snapshots are newer than the one being drawn
+    uint64_t oldestUsed{*std::min_element(m_frameOldestSnapshot.begin(), m_frameOldestSnapshot.end())};
+    std::lock_guard<std::mutex> lock(m_retiredMutex);
+    auto it = std::remove_if(m_retiredBuffers.begin(), m_retiredBuffers.end(), [this, oldestUsed, destroyAll](retiredBuffer& retired)
+    {
+        if (!destroyAll && retired.snapshot > oldestUsed)
+            return false;
+        m_deviceHandler->destroyBuffer(retired.buffer, retired.memory);
+        return true;
+    });
+    m_retiredBuffers.erase(it, m_retiredBuffers.end());
+
+    auto imageIt = std::remove_if(m_retiredImages.begin(), m_retiredImages.end(), [this, oldestUsed, destroyAll](retiredImage& retired)
+    {
+        if (!destroyAll && retired.snapshot > oldestUsed)
+            return false;
+        m_deviceHandler->destroyImageView(retired.view);
+        m_deviceHandler->destroyImage(retired.image, retired.memory);
+        if (retired.arrayIndex != UINT32_MAX)
+            m_pipelineManager->releaseTextureFromArray(retired.arrayIndex);
+        return true;
+    });
+    m_retiredImages.erase(imageIt, m_retiredImages.end());
+}
+
+void VulkanRenderer::recordStaticLayer(uint32_t frame)
+{
+    // the frame in flight finished with its region of the instances and its command buffer, they can be written
+    m_staticLayer->addShapes2dToDraw(m_staticShapes, frame);
+    m_staticLayer->updateUBO(frame);
+    m_uploadedBytesSum += m_staticLayer->getUploadedBytes();
+
+    VkCommandBuffer& buffer = m_staticLayerBuffers[frame];
+    m_deviceHandler->recordRenderSecondaryCommandBufferStart(buffer);
+    m_staticLayer->createCommandBuffer(buffer, frame);
+    m_deviceHandler->recordEndCommandBuffer(buffer);
+
+    m_staticLayerStale[frame] = false;
+    m_staticLayerSnapshots[frame] = m_staticShapesSnapshot;
+    m_staticLayerRecords++;
+}
+
+void VulkanRenderer::beginStaticLayer()
+{
+    m_snapshots.back().staticShapes.clear();
+    m_snapshots.back().staticChanged = true;
+    m_staticLayerDirty = false;
+    m_addingStaticShapes = true;
+}
+
+void VulkanRenderer::addShape(const RENDER::shape2dInstance& instance)
+{
+    if (m_addingStaticShapes)
+        m_snapshots.back().staticShapes.push_back(instance);
+    else
+        m_snapshots.back().shapes.push_back(instance);
 }
 
 void VulkanRenderer::vulkanRenderRect(const MATH::Vec2& position, const MATH::Vec2& size, const MATH::Vec4& color)
@@ -152,46 +431,110 @@ void VulkanRenderer::vulkanRenderRect(const MATH::Vec2& position, const MATH::Ve
     //TODO: use the shape2d for rendering rectangle
 }
 
-void VulkanRenderer::vulkanRenderShape2d(const std::string& nameVertex, const std::string &nameIndex, const MATH::Vec2& position, const MATH::Vec2& size, MATH::Vec4& color, VkBuffer& vertexBuffer, VkBuffer& indexBuffer, int indexCount)
+void VulkanRenderer::vulkanRenderShape2d(uint64_t sortKey, const MATH::Vec2& position, const MATH::Vec2& size, const MATH::Vec4& color, VkBuffer vertexBuffer, VkBuffer indexBuffer, int indexCount)
 {
-    auto shape = static_cast<Shape2d*>(m_renderTheseObjects["shape2d"]);
-    MATH::Vec4 positionAndSize{position.x /m_windowX - 1, position.y /m_windowY - 1, size.x/(float)m_windowX, size.y/(float)m_windowY};
-    shape->addShape2dToDraw(nameVertex, nameIndex, positionAndSize, color, vertexBuffer, indexBuffer, indexCount);
-    if(shape->m_shapeCount < 9999)//hardcoded max number of shapes; also in the uboSturct; TODO: change it to be variable
-        shape->m_shapeCount += 1;
+    RENDER::shape2dInstance instance{};
+    instance.sortKey = sortKey;
+    instance.positionAndSize = MATH::Vec4{position.x /m_windowX - 1, position.y /m_windowY - 1, size.x/(float)m_windowX, size.y/(float)m_windowY};
+    instance.color = color;
+    instance.vertexBuffer = vertexBuffer;
+    instance.indexBuffer = indexBuffer;
+    instance.indexCount = indexCount;
+    addShape(instance);
 }
 
-void VulkanRenderer::vulkanRenderShape2dWithTexture(const std::string &nameVertex, const std::string &nameIndex, const std::string &nameTexture, const MATH::Vec2 &position, const MATH::Vec2 &size, VkDescriptorSet &set, VkBuffer &vertexBuffer, VkBuffer &indexBuffer, int indexCount)
+void VulkanRenderer::vulkanRenderShape2dWithTexture(uint64_t sortKey, const MATH::Vec2& position, const MATH::Vec2& size, const TEXTURE::textureData& texture, VkBuffer vertexBuffer, VkBuffer indexBuffer, int indexCount)
 {
-    auto shape = static_cast<Shape2d*>(m_renderTheseObjects["shape2d"]);
-    MATH::Vec4 positionAndSize{position.x /m_windowX - 1, position.y /m_windowY - 1, size.x/(float)m_windowX, size.y/(float)m_windowY};
-    shape->addShape2dToDraw(nameVertex, nameIndex, nameTexture, positionAndSize, set, vertexBuffer, indexBuffer, indexCount);
-    if(shape->m_shapeCount < 9999)//hardcoded max number of shapes; also in the uboSturct; TODO: change it to be variable
-        shape->m_shapeCount += 1;
+    // the color is not used by the texture shaders, the array one reads the texture index from it
+    RENDER::shape2dInstance instance{};
+    instance.sortKey = sortKey;
+    instance.positionAndSize = MATH::Vec4{position.x /m_windowX - 1, position.y /m_windowY - 1, size.x/(float)m_windowX, size.y/(float)m_windowY};
+    instance.color = MATH::Vec4{0,0,0,1};
+    instance.vertexBuffer = vertexBuffer;
+    instance.indexBuffer = indexBuffer;
+    instance.indexCount = indexCount;
+    instance.textureSet = texture.set;
+    instance.uvRect = texture.uvRect;
+    if (texture.arrayIndex != UINT32_MAX)
+    {
+        instance.sortKey = RENDER::sortKeyForTextureArray(sortKey);
+        instance.color.x = (float)texture.arrayIndex;
+        instance.textureSet = m_pipelineManager->getTextureArraySet();
+    }
+    addShape(instance);
 }
 
-bool VulkanRenderer::load2dVertexBuffer(const std::string& pathToFile, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+double VulkanRenderer::getAverageDrawTime()
+{
+    std::lock_guard<std::mutex> lock(m_deviceMutex);
+    return m_drawTimeFrames ? m_drawTimeSum / m_drawTimeFrames : 0.0;
+}
+
+VulkanRenderer::frameTimes VulkanRenderer::getAverageFrameTimes()
+{
+    std::lock_guard<std::mutex> lock(m_deviceMutex);
+    if (m_drawTimeFrames == 0)
+        return {};
+    return {m_drawTimeSum / m_drawTimeFrames, m_fenceWaitSum / m_drawTimeFrames, m_gpuTimeSum / m_drawTimeFrames, m_uploadedBytesSum / m_drawTimeFrames,
+        (double)m_staticLayerRecords / m_drawTimeFrames, (double)m_partsSum / m_drawTimeFrames};
+}
+
+void VulkanRenderer::resetDrawTime()
 {
-    auto vertices = load2dVertexFile(pathToFile);
+    std::lock_guard<std::mutex> lock(m_deviceMutex);
+    m_drawTimeSum = 0.0;
+    m_fenceWaitSum = 0.0;
+    m_gpuTimeSum = 0.0;
+    m_uploadedBytesSum = 0.0;
+    m_staticLayerRecords = 0;
+    m_partsSum = 0;
+    m_drawTimeFrames = 0;
+}
 
-    return createAndCopyDataToGPUSideBuffer(buffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, bufferMemory, sizeof(vertices[0]) * vertices.size(), vertices.data());
+bool VulkanRenderer::load2dVertexBuffer(const std::string& pathToFile, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+    return create2dVertexBuffer(load2dVertexFile(pathToFile), buffer, bufferMemory);
 }
 
 bool VulkanRenderer::loadIndexBuffer(const std::string& pathToFile, VkBuffer& buffer, VkDeviceMemory& bufferMemory, int& size)
 {
-    auto vertices = loadIndexFile(pathToFile);
-    size = vertices.size();
+    return createIndexBuffer(loadIndexFile(pathToFile), buffer, bufferMemory, size);
+}
+
+bool VulkanRenderer::create2dVertexBuffer(const std::vector<MATH::Vec4>& vertices, VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool hostVisible)
+{
+    if (vertices.empty())
+        return false;
+
+    if (hostVisible)
+        return createAndCopyDataToCPUSideBuffer(buffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, bufferMemory, sizeof(vertices[0]) * vertices.size(), (void*)vertices.data());
+    return createAndCopyDataToGPUSideBuffer(buffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, bufferMemory, sizeof(vertices[0]) * vertices.size(), (void*)vertices.data());
+}
+
+bool VulkanRenderer::createIndexBuffer(const std::vector<uint32_t>& indices, VkBuffer& buffer, VkDeviceMemory& bufferMemory, int& size, bool hostVisible)
+{
+    if (indices.empty())
+        return false;
+    size = indices.size();
 
-    return createAndCopyDataToGPUSideBuffer(buffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, bufferMemory, sizeof(vertices[0]) * vertices.size(), vertices.data());
+    if (hostVisible)
+        return createAndCopyDataToCPUSideBuffer(buffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, bufferMemory, sizeof(indices[0]) * indices.size(), (void*)indices.data());
+    return createAndCopyDataToGPUSideBuffer(buffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, bufferMemory, sizeof(indices[0]) * indices.size(), (void*)indices.data());
 }
 
 void VulkanRenderer::freeBuffer(VkBuffer &buffer, VkDeviceMemory &bufferMemory)
 {
-    m_deviceHandler->destroyBuffer(buffer, bufferMemory);
+    // the snapshot filled now gets the new buffer, the ones before it and the cached static layer can still use this one
+    invalidateStaticLayer();
+    std::lock_guard<std::mutex> lock(m_retiredMutex);
+    m_retiredBuffers.push_back(retiredBuffer{m_snapshotFrame, buffer, bufferMemory});
+    buffer = VK_NULL_HANDLE;
+    bufferMemory = VK_NULL_HANDLE;
 }
 
 void VulkanRenderer::loadTexture(textureData& textureData, void* pixelData, int size, uint32_t w, uint32_t h)
 {
+    std::lock_guard<std::mutex> lock(m_deviceMutex);
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingMemory;
     m_deviceHandler->createBuffer(
@@ -244,11 +587,19 @@ void VulkanRenderer::loadTexture(textureData& textureData, void* pixelData, int
 
     m_deviceHandler->createImageView(textureData.imageView, textureData.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
 
-    m_pipelineManager->createSamplerDescriptorSet(textureData.set, textureData.imageView);
+    // the set of its own is only needed when the texture does not fit in the array, or there is no array
+    textureData.arrayIndex = m_pipelineManager->addTextureToArray(textureData.imageView);
+    if (textureData.arrayIndex == UINT32_MAX)
+        m_pipelineManager->createSamplerDescriptorSet(textureData.set, textureData.imageView);
 }
 
-void VulkanRenderer::destroyImage(VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView)
+void VulkanRenderer::destroyImage(VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView, uint32_t arrayIndex)
 {
-    m_deviceHandler->destroyImageView(imageView);
-    m_deviceHandler->destroyImage(image, imageMemory);
+    // retired like the buffers, the frames in flight keep drawing with it
+    invalidateStaticLayer();
+    std::lock_guard<std::mutex> lock(m_retiredMutex);
+    m_retiredImages.push_back(retiredImage{m_snapshotFrame, image, imageMemory, imageView, arrayIndex});
+    image = VK_NULL_HANDLE;
+    imageMemory = VK_NULL_HANDLE;
+    imageView = VK_NULL_HANDLE;
 }
@@ -14,7 +14,11 @@
 #include "Vector.h"
 #include <memory>
 #include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "Structs.h"
+#include "TripleBuffer.h"
 
 using textureData = TEXTURE::textureData;
 
@@ -22,6 +26,9 @@ class DeviceHandler;
 class PipelineManager;
 class Entity;
 class VulkanRenderableObject;
+class Shape2d;
+class LatencyTracker;
+class JobSystem;
 
 class VulkanRenderer
 {
@@ -36,8 +43,99 @@ private:
     // we store the renderable objects in a vector maybe
     std::map<std::string, VulkanRenderableObject*> m_renderTheseObjects;
 
-    VkCommandBuffer m_primaryCommandBuffer;
-    std::vector<VkCommandBuffer> m_secondaryCommandBuffer;
+    // one primary for every frame in flight, it executes the static layer first and then the parts of the objects
+    // the secondary of the static layer is only recorded again when the layer changed
+    std::vector<VkCommandBuffer> m_primaryCommandBuffers;
+    std::vector<VkCommandBuffer> m_staticLayerBuffers;
+    std::vector<VkCommandBuffer> m_executedBuffers; // only used by the thread that renders
+
+    // the draws of an object are split into parts, the parts are recorded into their own secondaries at the same time
+    // on the job system; every part has a command pool for every frame in flight, reset when the frame comes again
+    struct recordingPart
+    {
+        VulkanRenderableObject* object{nullptr};
+        size_t firstDraw{0};
+        size_t lastDraw{0};
+        VkCommandBuffer buffer{VK_NULL_HANDLE};
+    };
+    JobSystem* m_jobSystem{nullptr};
+    const size_t m_drawsPerPart{256}; // fewer draws are recorded faster than a job is started
+    std::vector<std::vector<VkCommandPool>> m_partPools; // [frame][part]
+    std::vector<std::vector<VkCommandBuffer>> m_partBuffers;
+    std::vector<recordingPart> m_parts;
+    int m_partsSum{0};
+
+    // the static layer: the shapes that rarely change are drawn under the others from cached command buffers
+    // its instances stay in the buffer of the frame in flight, every frame in flight is recorded once after a change
+    Shape2d* m_staticLayer{nullptr};
+    std::vector<RENDER::shape2dInstance> m_staticShapes; // the ones below are only used by the thread that renders
+    std::vector<bool> m_staticLayerStale;
+    bool m_staticLayerDirty{true}; // these two only on the main thread
+    bool m_addingStaticShapes{false};
+    int m_staticLayerRecords{0};
+
+    // cpu side time of the drawFrame calls (waiting for the frame slot + recording + submit), in milliseconds
+    // with the frames in flight the gpu time is mostly not waited for, the cpu and the gpu work at the same time
+    double m_drawTimeSum{0.0};
+    double m_fenceWaitSum{0.0};
+    double m_gpuTimeSum{0.0};
+    double m_uploadedBytesSum{0.0};
+    int m_drawTimeFrames{0};
+
+    // the scene fills the back snapshot, drawFrame publishes it and the rendering reads the front one
+    TripleBuffer<RENDER::renderSnapshot> m_snapshots{};
+    uint64_t m_snapshotFrame{0};
+
+    // optional render thread: it records and submits a snapshot while the main thread simulates the next frame
+    std::thread m_renderThread;
+    bool m_renderThreadRunning{false}; // guarded by m_renderMutex
+    std::mutex m_renderMutex;
+    std::condition_variable m_renderCondition;
+    // the queue and the command pool can be used by one thread at a time: the uploads and the rendering take turns
+    std::mutex m_deviceMutex;
+
+    // a freed buffer or image can still be used by a published snapshot, a frame in flight or the cached static layer
+    // it is only destroyed by the thread that renders when no frame uses anything older than its snapshot anymore
+    struct retiredBuffer
+    {
+        uint64_t snapshot{0}; // the first snapshot that does not use it
+        VkBuffer buffer{VK_NULL_HANDLE};
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+    };
+    struct retiredImage
+    {
+        uint64_t snapshot{0};
+        VkImage image{VK_NULL_HANDLE};
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};
+        uint32_t arrayIndex{UINT32_MAX}; // its element in the texture array is written again only after it is destroyed
+    };
+    std::vector<retiredBuffer> m_retiredBuffers;
+    std::vector<retiredImage> m_retiredImages;
+    std::mutex m_retiredMutex;
+    // the oldest snapshot the commands of each frame in flight use, with the static layer; only used by the thread that renders
+    std::vector<uint64_t> m_frameOldestSnapshot;
+    std::vector<uint64_t> m_staticLayerSnapshots; // the snapshot the static layer of each frame was recorded from
+    uint64_t m_staticShapesSnapshot{UINT64_MAX};
+
+    // gets the inputs of each frame after the GPU finished it, only used by the thread that renders
+    LatencyTracker* m_latencyTracker{nullptr};
+    std::vector<std::vector<LATENCY::sample>> m_presentedInputs; // per frame in flight, until its fence is waited on again
+
+    void renderSnapshot(const RENDER::renderSnapshot& snapshot);
+    void renderThreadLoop();
+
+    // to the static layer between beginStaticLayer and endStaticLayer, otherwise to the shapes of the frame
+    void addShape(const RENDER::shape2dInstance& instance);
+    // its frame variables are reset after the primary is recorded, the culling of the layer is recorded into it
+    void recordStaticLayer(uint32_t frame);
+    // only grows, a part can be recorded with its pool while another thread records the others
+    void createPartPools(size_t partCount);
+    void recordParts(uint32_t frame);
+    void recordPart(const recordingPart& part, uint32_t frame);
+    // destroys the retired buffers and images that no frame in flight can use anymore, everything with destroyAll after the device is idle
+    // under the device mutex, it releases the texture array elements too
+    void destroyRetiredResources(bool destroyAll);
 
     void createPrimaryCommandBuffer(VkCommandBuffer& buffer);
     void createSecondaryCommandBuffer(std::vector<VkCommandBuffer>& buffer);
@@ -57,27 +155,56 @@ public:
     VulkanRenderer(SDL_Window* window);
     ~VulkanRenderer();
 
+    // publishes the shapes added since the last call, and draws them here or on the render thread
     void drawFrame();
+    void startRenderThread();
+    void stopRenderThread();
+    bool hasRenderThread() { return m_renderThread.joinable(); };
+    // the inputs added to the current frame are stamped while it is recorded and submitted, and when the GPU finished it, then go to the tracker
+    void setLatencyTracker(LatencyTracker* tracker) { m_latencyTracker = tracker; };
+    // the large draw lists are recorded in parts on its workers, without it everything is recorded by the thread that renders
+    void setJobSystem(JobSystem* jobSystem);
+    void addInputLatency(const LATENCY::sample& sample) { m_snapshots.back().inputs.push_back(sample); };
+
+    // the static shapes are sent once and drawn from cached command buffers until the layer is invalidated, e.g.
+    // after one of them changed; freeing a buffer or an image invalidates it too, the cached commands may use them
+    bool isStaticLayerDirty() { return m_staticLayerDirty; };
+    void invalidateStaticLayer() { m_staticLayerDirty = true; };
+    // the shapes added between the two calls replace the static layer
+    void beginStaticLayer();
+    void endStaticLayer() { m_addingStaticShapes = false; };
+
     void vulkanRenderRect(const MATH::Vec2& position, const MATH::Vec2& size, const MATH::Vec4& color);//this will just update the command buffer with the new commands
-    void vulkanRenderShape2d(const std::string& nameVertex, const std::string &nameIndex, const MATH::Vec2& position, const MATH::Vec2& size, MATH::Vec4& color, VkBuffer& vertexBuffer, VkBuffer& indexBuffer, int indexCount);
-    void vulkanRenderShape2dWithTexture(
-        const std::string& nameVertex,
-        const std::string &nameIndex,
-        const std::string &nameTexture,
-        const MATH::Vec2& position,
-        const MATH::Vec2& size,
-        VkDescriptorSet& set,
-        VkBuffer& vertexBuffer,
-        VkBuffer& indexBuffer,
-        int indexCount
-        );
+    // the sort key decides the order, the batches split on the key and on the buffers, see RENDER::shape2dSortKey
+    void vulkanRenderShape2d(uint64_t sortKey, const MATH::Vec2& position, const MATH::Vec2& size, const MATH::Vec4& color, VkBuffer vertexBuffer, VkBuffer indexBuffer, int indexCount);
+    // the textures in the texture array are drawn with the others of the same mesh and layer, the rest with their own set
+    void vulkanRenderShape2dWithTexture(uint64_t sortKey, const MATH::Vec2& position, const MATH::Vec2& size, const TEXTURE::textureData& texture, VkBuffer vertexBuffer, VkBuffer indexBuffer, int indexCount);
 
     bool load2dVertexBuffer(const std::string& pathToFile, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
     bool loadIndexBuffer(const std::string& pathToFile, VkBuffer& buffer, VkDeviceMemory& bufferMemory, int& size);
+    // hostVisible: written directly without a copy on the queue, for the meshes that are replaced often
+    bool create2dVertexBuffer(const std::vector<MATH::Vec4>& vertices, VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool hostVisible = false);
+    bool createIndexBuffer(const std::vector<uint32_t>& indices, VkBuffer& buffer, VkDeviceMemory& bufferMemory, int& size, bool hostVisible = false);
+    // only on the main thread, the buffer is destroyed later when the frames using it finished
     void freeBuffer(VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 
     void loadTexture(textureData& textureData, void* pixelData, int size, uint32_t w, uint32_t h);
-    void destroyImage(VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView);
+    // only on the main thread, like freeBuffer; the element in the texture array is reused after the image is destroyed
+    void destroyImage(VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView, uint32_t arrayIndex);
+
+    struct frameTimes
+    {
+        double draw{0.0}; // cpu, from the start of the frame to the present
+        double fenceWait{0.0}; // the part of draw waiting for the gpu to finish the frame slot
+        double gpu{0.0}; // from the timestamps, 0 if the queue has none
+        double uploadedBytes{0.0}; // instance data that changed and was written to the GPU
+        double staticRecords{0.0}; // how often the static layer was recorded again, per frame
+        double parts{0.0}; // the secondaries the objects were recorded into
+    };
+
+    double getAverageDrawTime();
+    frameTimes getAverageFrameTimes();
+    void resetDrawTime();
 };
 
 #endif
\ No newline at end of file
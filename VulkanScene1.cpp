@@ -3,18 +3,22 @@
 #include "EntityManager.h"
 #include "Logger.h"
 #include "Grid.h"
+#include "AssetManager.h"
+#include "VulkanRenderer.h"
 
 void VulkanScene1::init()
 {
-    registerAction(SDL_SCANCODE_W, "UP");
-    registerAction(SDL_SCANCODE_S, "DOWN");
-    registerAction(SDL_SCANCODE_A, "LEFT");
-    registerAction(SDL_SCANCODE_D, "RIGHT");
-    registerAction(SDL_SCANCODE_R, "FINDPATH");
-    registerAction(SDL_SCANCODE_F, "GENERATEMAZE");
-    registerAction(SDL_BUTTON_LEFT, "MOUSECLICK");
+    registerAction(SDL_SCANCODE_W, ACTION::id::UP);
+    registerAction(SDL_SCANCODE_S, ACTION::id::DOWN);
+    registerAction(SDL_SCANCODE_A, ACTION::id::LEFT);
+    registerAction(SDL_SCANCODE_D, ACTION::id::RIGHT);
+    registerAction(SDL_SCANCODE_R, ACTION::id::FINDPATH);
+    registerAction(SDL_SCANCODE_F, ACTION::id::GENERATEMAZE);
+    registerAction(SDL_SCANCODE_B, ACTION::id::BAKEDWALLS);
+    registerAction(SDL_SCANCODE_V, ACTION::id::FOGOFWAR);
+    registerMouseAction(SDL_BUTTON_LEFT, ACTION::id::MOUSECLICK);
 
-    SDL_GetWindowSize(m_ge->window(), &windowX, &windowY);
+    m_ge->getWindowSize(windowX, windowY);
 
     m_map = m_em->addEntity("map");
     m_map->addComponent<CTransform>(MATH::Vec2{windowX/2, windowY/2});
@@ -22,6 +26,7 @@ void VulkanScene1::init()
     m_map->addComponent<CAABB>(windowX, windowY);
 
     m_grid = std::make_shared<Grid>("grid1", mazeX, mazeY, windowX, windowY);//1736 block
+    m_grid->setSeed(m_ge->nextSeed());
     m_grid->createGrid(m_em);
     m_grid->setTargetEntity(mazeX - 1, mazeY - 1);
 
@@ -31,10 +36,20 @@ void VulkanScene1::init()
     m_player->addComponent<CTransform>(m_grid->getEntityAt(0, 0)->getComponent<CTransform>().pos, MATH::Vec2(0.f, 0.f), 0, 90, 150);
     m_player->addComponent<CRectBody>(playerWidth, playerHeight, MATH::Vec4{1.f, 0.f, 1.f, 0.f});
     m_player->addComponent<CState>();
+    m_player->getComponent<CState>().fast = true;
     m_player->addComponent<CAABB>(playerWidth, playerHeight);
     m_player->addComponent<CShape2d>("rectangleVertex", "triangleIndex");
 
     m_grid->generateMaze();
+    m_wallCollision.build(*m_grid);
+
+    // one entity for the walls of the whole maze, it covers the grid and draws the baked mesh
+    m_mazeWalls = m_em->addEntity("mazeWalls");
+    m_mazeWalls->addComponent<CTransform>(MATH::Vec2{windowX/2, windowY/2});
+    m_mazeWalls->addComponent<CRectBody>(windowX, windowY, MATH::Vec4{0,0,0,0});
+    m_mazeWalls->addComponent<CState>();
+    resetVisibility();
+    bakeMazeWalls();
 
 }
 
@@ -50,10 +65,11 @@ void VulkanScene1::update()
     { checkEntityLifetime(entity); }
     m_em->update();
     playerPhysicsUpdate();
+    // the border turns the enemies around first, the broadphase and the sweeps see the velocities they move with
     reactToMapBorder();
-    checkWalls();
+    sBroadphase();
     sMovement();
-    sRender();
+    sVisibility();
     m_currentFrame++;
 }
 
@@ -64,32 +80,34 @@ void VulkanScene1::sDoAction(const Action& action)
     auto& transform = m_player->getComponent<CTransform>();
     auto& state = m_player->getComponent<CState>();
 
-    if (action.name() == "UP")
+    if (action.name() == ACTION::id::UP)
     {
-        transform.vel.y = (action.type() == "START") ? -1.f : 0.f;
+        transform.vel.y = (action.isStart()) ? -1.f : 0.f;
     }
-    else if (action.name() == "DOWN")
+    else if (action.name() == ACTION::id::DOWN)
     {
-        transform.vel.y = (action.type() == "START") ? 1.f : 0.f;
+        transform.vel.y = (action.isStart()) ? 1.f : 0.f;
     }
-    else if (action.name() == "LEFT")
+    else if (action.name() == ACTION::id::LEFT)
     {
-        transform.vel.x = (action.type() == "START") ? -1.f : 0.f;
+        transform.vel.x = (action.isStart()) ? -1.f : 0.f;
     }
-    else if (action.name() == "RIGHT")
+    else if (action.name() == ACTION::id::RIGHT)
     {
-        transform.vel.x = (action.type() == "START") ? 1.f : 0.f;
+        transform.vel.x = (action.isStart()) ? 1.f : 0.f;
     }
-    else if (action.name() == "MOUSECLICK" && action.event().type == SDL_MOUSEBUTTONDOWN)
+    else if (action.name() == ACTION::id::MOUSECLICK && action.isStart())
     {
-        spawnEnemy(action.event().button.x, action.event().button.y);
+        spawnEnemy(action.x(), action.y());
     }
-    else if (action.type() == "START" && action.name() == "FINDPATH")
+    else if (action.isStart() && action.name() == ACTION::id::FINDPATH)
     {
         std::vector<int> path{};
-        m_grid->calculateAStar(m_grid->getEntityAt(m_player->getComponent<CTransform>().pos)[0], m_grid->getTargetEntity(), path);
+        auto& playerPos = m_player->getComponent<CTransform>().pos;
+        m_grid->calculateAStar(m_grid->getEntityAt(playerPos.x, playerPos.y), m_grid->getTargetEntity(), path);
 
-        int lifetime{120};
+        // 2 seconds, the lifetime is counted in simulation steps
+        int lifetime{(int)(2.0 / m_ge->getSimulationStep())};
         for (int i = 1; i < path.size() - 1; i++)
         {
             std::string markerName{};
@@ -107,10 +125,36 @@ void VulkanScene1::sDoAction(const Action& action)
             lifetime +=1;
         }
     }
-    else if (action.type() == "START" && action.name() == "GENERATEMAZE")
+    else if (action.isStart() && action.name() == ACTION::id::GENERATEMAZE)
     {
         generateMaze();
     }
+    else if (action.isStart() && action.name() == ACTION::id::BAKEDWALLS)
+    {
+        if (m_ge->vulkanRenderer())
+        {
+            auto times = m_ge->vulkanRenderer()->getAverageFrameTimes();
+            Logger::Instance()->logInfo(
+                std::string("VulkanScene1: ") + (m_bakedWalls ? "baked walls" : "per cell walls")
+                + " average draw time: " + std::to_string(times.draw) + " ms, waiting for the gpu: "
+                + std::to_string(times.fenceWait) + " ms, gpu: " + std::to_string(times.gpu) + " ms, uploaded: "
+                + std::to_string(times.uploadedBytes) + " bytes, static layer recorded in "
+                + std::to_string(times.staticRecords * 100.0) + "% of the frames");
+        }
+        m_bakedWalls = !m_bakedWalls;
+        bakeMazeWalls();
+    }
+    else if (action.isStart() && action.name() == ACTION::id::FOGOFWAR)
+    {
+        m_fogOfWar = !m_fogOfWar;
+        if (m_fogOfWar)
+            m_grid->hideUnseenCells(m_fieldOfView);
+        else
+            m_grid->showAllCells();
+        invalidateStaticLayer();
+        if (m_bakedWalls)
+            uploadMazeMesh();
+    }
 
     state.moving = (MATH::VMath::mag(transform.vel) != 0) ? true : false;
 }
@@ -125,23 +169,79 @@ void VulkanScene1::sMovement()
             auto& state = entity->getComponent<CState>();
 
             if (state.moving)
-                transform.pos = transform.pos + transform.vel * transform.moveSpeed;
+            {
+                MATH::Vec2 delta{stepDelta(entity)};
+                if (entity->hasComponent<CAABB>())
+                {
+                    bool blockedX{false}, blockedY{false};
+                    // fast entities stop at the first enemy on the way, the walls are checked from there
+                    if (state.fast)
+                    {
+                        std::shared_ptr<Entity> hitEntity{nullptr};
+                        auto hit = sweepEntities(entity, delta, "Enemy", hitEntity);
+                        if (hit.hit)
+                        {
+                            delta = delta * hit.time + hit.normal * m_contactSkin;
+                            blockedX = hit.normal.x != 0.f;
+                            blockedY = hit.normal.y != 0.f;
+                        }
+                    }
+
+                    auto& aabb = entity->getComponent<CAABB>();
+                    auto res = m_wallCollision.sweep(transform.pos, MATH::Vec2(aabb.halfWidth(), aabb.halfHeight()), delta);
+                    delta = res.delta;
+                    blockedX = blockedX || res.blockedX;
+                    blockedY = blockedY || res.blockedY;
+                    // the player stops at the walls, everything else bounces back
+                    if (entity != m_player)
+                    {
+                        if (blockedX)
+                            transform.vel.x *= -1;
+                        if (blockedY)
+                            transform.vel.y *= -1;
+                    }
+                }
+                transform.pos = transform.pos + delta;
+                // the sweeps of the entities after it use this movement, not its velocity that may be turned around now
+                m_stepDeltas[entity->id()] = delta;
+            }
 
             if (state.turning)
-                transform.angle = fmod(transform.angle + transform.turnDirection * transform.turnSpeed, 360);
+                transform.angle = fmod(transform.angle + transform.turnDirection * transform.turnSpeed * m_ge->getSimulationStep(), 360);
 
         }
     }
 }
 
+void VulkanScene1::sVisibility()
+{
+    // the shadowcasting only runs when the player steps into another cell
+    int playerCell{m_grid->getCellIdx(m_player->getComponent<CTransform>().pos)};
+    if (m_fieldOfView.update(playerCell % mazeX, playerCell / mazeX) && m_fogOfWar)
+    {
+        m_grid->hideUnseenCells(m_fieldOfView);
+        invalidateStaticLayer();
+        if (m_bakedWalls && m_fieldOfView.exploredChanged())
+            m_mazeMeshStale = true;
+    }
+    if (m_mazeMeshStale && m_currentFrame - m_lastMazeBake >= (int)(m_mazeBakeInterval / m_ge->getSimulationStep()))
+        uploadMazeMesh();
+
+    for (auto& enemy: m_em->getEntities("Enemy"))
+    {
+        int enemyCell{m_grid->getCellIdx(enemy->getComponent<CTransform>().pos)};
+        enemy->getComponent<CState>().hidden = m_fogOfWar && !m_fieldOfView.isVisible(enemyCell);
+    }
+}
+
 void VulkanScene1::playerPhysicsUpdate()
 {
     if (m_player->hasComponent<CTransform>())
     {
         auto& transform = m_player->getComponent<CTransform>();
 
-        transform.moveSpeed = (float)transform.maxMoveSpeed / m_ge->getFPS();
-        transform.turnSpeed = transform.maxTurnSpeed / m_ge->getFPS();
+        transform.moveSpeed = transform.maxMoveSpeed;
+        transform.turnSpeed = transform.maxTurnSpeed;
 
         auto currentRad = atan2f(transform.vel.y, transform.vel.x);
         auto currentDeg = currentRad * 180 / M_PI;
@@ -169,77 +269,26 @@ void VulkanScene1::reactToMapBorder()
         m_player->getComponent<CTransform>().vel.y = 0;
 }
 
-void VulkanScene1::checkWalls()
-{
-    if(!m_player->getComponent<CState>().moving)
-        return;
-
-    auto playerMovespeed = m_player->getComponent<CTransform>().moveSpeed;
-    auto playerPos = m_player->getComponent<CTransform>().pos;
-    auto playerVel = m_player->getComponent<CTransform>().vel * playerMovespeed;
-    auto playerHW = m_player->getComponent<CAABB>().halfWidth();
-    auto playerHH = m_player->getComponent<CAABB>().halfHeight();
-    auto nodEntity = m_grid->getEntityAt(m_player->getComponent<CTransform>().pos);
-    auto nodePos = nodEntity[0]->getComponent<CTransform>().pos;
-    auto nodeHW = nodEntity[0]->getComponent<CAABB>().halfWidth();
-    auto nodeHH = nodEntity[0]->getComponent<CAABB>().halfHeight();
-    auto& nodeWalls = nodEntity[0]->getComponent<CWalls>();
-    std::vector<std::shared_ptr<Entity>> eastNeighborEntities(5, nullptr);
-    if (nodEntity[1])
-        eastNeighborEntities = m_grid->getEntityAt(nodEntity[1]->getComponent<CTransform>().pos);
-    std::vector<std::shared_ptr<Entity>> southNeighborEntities(5, nullptr);
-    if (nodEntity[2])
-        southNeighborEntities = m_grid->getEntityAt(nodEntity[2]->getComponent<CTransform>().pos);
-    auto directNeighborEntities = m_grid->getEntityAt(nodePos);
-
-    MATH::Vec2 relPos{playerPos - nodePos};
-    if  ((playerVel.x > 0
-        && relPos.x + playerHW + playerVel.x > nodeHW
-        && (abs(relPos.y - playerHH) > nodeHH && (nodEntity[1] && nodEntity[1]->getComponent<CWalls>().north || eastNeighborEntities[4]->getComponent<CWalls>().west) // missing one check, the east -> north node's west wall
-        || relPos.y + playerHH > nodeHH && eastNeighborEntities[2] && (eastNeighborEntities[2]->getComponent<CWalls>().north || eastNeighborEntities[2]->getComponent<CWalls>().west)
-        || nodEntity[1] && nodEntity[1]->getComponent<CWalls>().west)
-        ) || (
-        playerVel.x < 0
-        && abs(relPos.x - playerHW + playerVel.x) > nodeHW
-        && (abs(relPos.y - playerHH) > nodeHH && (directNeighborEntities[4] && directNeighborEntities[4]->getComponent<CWalls>().west || directNeighborEntities[3] && directNeighborEntities[3]->getComponent<CWalls>().north)
-        || relPos.y + playerHH > nodeHH && (directNeighborEntities[2] && directNeighborEntities[2]->getComponent<CWalls>().west || southNeighborEntities[3] && southNeighborEntities[3]->getComponent<CWalls>().north)
-        || nodeWalls.west)
-        ))
-    { m_player->getComponent<CTransform>().vel.x = 0; }
-    else if ((playerVel.y > 0
-        && relPos.y + playerHH + playerVel.y > nodeHH
-        && (relPos.x + playerHW > nodeHW && southNeighborEntities[1] && (southNeighborEntities[1]->getComponent<CWalls>().north || southNeighborEntities[1]->getComponent<CWalls>().west)
-        || abs(relPos.x - playerHW) > nodeHW && (southNeighborEntities[0] && southNeighborEntities[0]->getComponent<CWalls>().west || southNeighborEntities[3] && southNeighborEntities[3]->getComponent<CWalls>().north)
-        || southNeighborEntities[0] && southNeighborEntities[0]->getComponent<CWalls>().north)
-    ) || (
-        playerVel.y < 0
-        && abs(relPos.y - playerHH + playerVel.y) > nodeHH
-        && (relPos.x + playerHW > nodeHW && (eastNeighborEntities[4] && eastNeighborEntities[4]->getComponent<CWalls>().west || eastNeighborEntities[0] && eastNeighborEntities[0]->getComponent<CWalls>().north)
-        || abs(relPos.x - playerHW) > nodeHW && (directNeighborEntities[4] && directNeighborEntities[4]->getComponent<CWalls>().west || directNeighborEntities[3] && directNeighborEntities[3]->getComponent<CWalls>().north)
-        || nodeWalls.north)
-    ))
-    { m_player->getComponent<CTransform>().vel.y = 0; }
-}
-
 void VulkanScene1::spawnEnemy(const float& x, const float& y)
 {
     auto enemy = m_em->addEntity("Enemy");
-    enemy->addComponent<CTransform>(MATH::Vec2{x, y}, MATH::Vec2(0.f, 0.f), 0, 90, 5);
+    // 5 pixels per 60 Hz frame like before the fixed step
+    enemy->addComponent<CTransform>(MATH::Vec2{x, y}, MATH::Vec2(0.f, 0.f), 0, 90, 300);
     enemy->addComponent<CRectBody>(25, 25);
     enemy->addComponent<CState>(false, false);
     enemy->addComponent<CAABB>(25, 25);
     enemy->addComponent<CShape2d>("rectangleVertex", "rectangleIndex");
     enemy->addComponent<CTexture>("plane");
-    enemy->addComponent<CLifetime>(120, m_currentFrame);
+    enemy->addComponent<CLifetime>((int)(2.0 / m_ge->getSimulationStep()), m_currentFrame);
 }
 
 void VulkanScene1::spawnMarker(float x, float y, int lifetime, std::string markerName)
 {
     auto marker = m_em->addEntity("Marker");
-    marker->addComponent<CTransform>(MATH::Vec2{x, y}, MATH::Vec2(0.f, 0.f), 0, 90, 5);
+    marker->addComponent<CTransform>(MATH::Vec2{x, y}, MATH::Vec2(0.f, 0.f), 0, 90, 300);
     marker->addComponent<CRectBody>(25, 25, MATH::Vec4{0,0,1,0});
     marker->addComponent<CState>();
-    marker->addComponent<CShape2d>("xarrowVertex", markerName);
+    marker->addComponent<CShape2d>("xarrowVertex", markerName, 2); // over the walls
     marker->addComponent<CLifetime>(lifetime, m_currentFrame);
 }
 
@@ -255,14 +304,78 @@ void VulkanScene1::generateMaze()
     }
     m_grid.reset();
     m_grid = std::make_shared<Grid>("grid1", mazeX, mazeY, windowX, windowY);
+    m_grid->setSeed(m_ge->nextSeed());
     m_grid->createGrid(m_em);
     m_grid->generateMaze();
-    m_player->getComponent<CTransform>().pos = m_grid->getEntityAt(0, 0)->getComponent<CTransform>().pos;
+    m_wallCollision.build(*m_grid);
+    m_player->getComponent<CTransform>().teleport(m_grid->getEntityAt(0, 0)->getComponent<CTransform>().pos);
     m_grid->setTargetEntity(mazeX - 1, mazeY - 1);
+    resetVisibility();
+    bakeMazeWalls();
+}
+
+void VulkanScene1::resetVisibility()
+{
+    // new maze, nothing is explored yet
+    m_fieldOfView.build(m_grid->getWallMask(), m_grid->getRowNumber(), m_grid->getColumnNumber());
+    int playerCell{m_grid->getCellIdx(m_player->getComponent<CTransform>().pos)};
+    m_fieldOfView.update(playerCell % mazeX, playerCell / mazeX);
+    if (m_fogOfWar)
+        m_grid->hideUnseenCells(m_fieldOfView);
+    invalidateStaticLayer();
+}
+
+void VulkanScene1::bakeMazeWalls()
+{
+    m_grid->showCellWalls(!m_bakedWalls);
+    invalidateStaticLayer();
+    if (m_ge->vulkanRenderer())
+        m_ge->vulkanRenderer()->resetDrawTime();
+
+    if (!m_bakedWalls)
+    {
+        m_mazeWalls->removeComponent<CShape2d>();
+        Logger::Instance()->logInfo("VulkanScene1: per cell walls: " + std::to_string(MazeMesh::perCellTriangleCount(m_grid->getWallMask()))
+            + " triangles in " + std::to_string(mazeX * mazeY) + " instances");
+        return;
+    }
+
+    uploadMazeMesh();
+
+    Logger::Instance()->logInfo("VulkanScene1: baked walls: " + std::to_string(m_mazeMesh.getTriangleCount())
+        + " triangles, " + std::to_string(m_mazeMesh.getVertices().size()) + " vertices in 1 instance (per cell: "
+        + std::to_string(MazeMesh::perCellTriangleCount(m_grid->getWallMask())) + " triangles)");
+}
+
+void VulkanScene1::uploadMazeMesh()
+{
+    const std::vector<uint8_t>* walls{&m_grid->getWallMask()};
+    if (m_fogOfWar)
+    {
+        // only the walls of the explored cells get into the mesh, it is baked again when the player finds new cells
+        m_fieldOfView.exploredWalls(*walls, m_exploredWalls);
+        walls = &m_exploredWalls;
+    }
+
+    invalidateStaticLayer();
+    m_mazeMeshStale = false;
+    m_lastMazeBake = m_currentFrame;
+    m_mazeMesh.bake(*walls, m_grid->getRowNumber(), m_grid->getColumnNumber(), m_grid->getCellWidth(), m_grid->getCellHeight());
+    if (m_mazeMesh.getTriangleCount() == 0)
+    {
+        m_mazeWalls->removeComponent<CShape2d>();
+        return;
+    }
+    // the old buffers stay until the frames drawing them finished, the new ones are written without a copy on the queue
+    m_ge->assetManager()->SetVertexBuffer("wallsMeshVertex", m_mazeMesh.getVertices(), true);
+    m_ge->assetManager()->SetIndexBuffer("wallsMeshIndex", m_mazeMesh.getIndices(), true);
+    // on layer 1 of the static layer, over the bricks
+    m_mazeWalls->addComponent<CShape2d>("wallsMeshVertex", "wallsMeshIndex", 1, true);
 }
 
 void VulkanScene1::checkEndMap()
 {
-    if (m_grid->getEntityAt(m_player->getComponent<CTransform>().pos)[0]->getComponent<CNode>().id == mazeX * mazeY - 1)
+    auto& playerPos = m_player->getComponent<CTransform>().pos;
+    if (m_grid->getEntityAt(playerPos.x, playerPos.y)->getComponent<CNode>().id == mazeX * mazeY - 1)
         m_ge->changeScene("VulkanSceneMenu");
 }
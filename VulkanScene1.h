@@ -4,6 +4,9 @@
 #include "Scene.h"
 #include <memory>
 #include "Vector.h"
+#include "WallCollision.h"
+#include "MazeMesh.h"
+#include "FieldOfView.h"
 
 class Grid;
 
@@ -15,6 +18,18 @@ private:
     int windowX{0}, windowY{0};
     int mazeX{40}, mazeY{20};
     std::shared_ptr<Grid> m_grid{nullptr};
+    WallCollision m_wallCollision{};
+    MazeMesh m_mazeMesh{};
+    std::shared_ptr<Entity> m_mazeWalls{nullptr};
+    bool m_bakedWalls{true};
+    FieldOfView m_fieldOfView{};
+    bool m_fogOfWar{true};
+    std::vector<uint8_t> m_exploredWalls{}; // the walls seen from the explored cells, this is baked with fog of war
+    // while the player explores, the walls are baked again at most this often; the old mesh is drawn meanwhile
+    const double m_mazeBakeInterval{0.1}; // seconds
+    bool m_mazeMeshStale{false};
+    int m_lastMazeBake{0}; // the step of the last bake
+    const float m_contactSkin{0.01f}; // the distance kept from the entity hit by a sweep
 
     void init() override;
     void endScene() override;
@@ -23,13 +38,16 @@ private:
     void sDoAction(const Action& action) override;
 
     void sMovement();
+    void sVisibility();
     void playerPhysicsUpdate();
     void reactToMapBorder();
-    void checkWalls();
 
     void spawnEnemy(const float& x, const float& y);
     void spawnMarker(float x, float y, int lifetime, std::string markerName);
     void generateMaze();
+    void bakeMazeWalls();
+    void uploadMazeMesh();
+    void resetVisibility();
     void checkEndMap();
 
 public:
@@ -2,18 +2,22 @@
 #include "Entity.h"
 #include "EntityManager.h"
 #include "AssetManager.h"
+#include "AABBTree.h"
 
 void VulkanSceneMenu::update()
 {
     m_em->update();
-    sRender();
+    sBroadphase();
     m_currentFrame++;
 }
 
 void VulkanSceneMenu::init()
 {
-    registerAction(SDL_BUTTON_LEFT, "MOUSECLICK");
-    registerAction(SDL_MOUSEMOTION, "MOUSEMOTION");
+    registerMouseAction(SDL_BUTTON_LEFT, ACTION::id::MOUSECLICK);
+    registerMouseMotionAction(ACTION::id::MOUSEMOTION);
+
+    // the background is as big as the window, the buttons are scaled, the tree works with any size
+    m_broadphase = std::make_unique<AABBTree>();
 
     m_ge->getWindowSize(m_windowX, m_windowY);
 
@@ -22,7 +26,7 @@ void VulkanSceneMenu::init()
     m_bg->addComponent<CRectBody>(m_windowX, m_windowY);
     m_bg->addComponent<CState>();
     m_bg->addComponent<CAABB>(m_windowX, m_windowY);
-    m_bg->addComponent<CShape2d>("rectangleVertex", "rectangleIndex");
+    m_bg->addComponent<CShape2d>("rectangleVertex", "rectangleIndex", 0, true);
     m_bg->addComponent<CTexture>("brick");
 
     int buttonWidth{0}, buttonHeight{0};
@@ -58,13 +62,17 @@ void VulkanSceneMenu::endScene()
 
 void VulkanSceneMenu::sDoAction(const Action &action)
 {
-    if (action.type() != "START")
+    if (!action.isStart())
         return;
-    if (action.name() == "MOUSECLICK")
+    if (action.name() == ACTION::id::MOUSECLICK)
     {
-        MATH::Vec2 mouseLocation{action.event().button.x, action.event().button.y};
-        for (auto& entity: m_em->getEntities("button"))
+        MATH::Vec2 mouseLocation{action.x(), action.y()};
+        m_entitiesAtMouse.clear();
+        getEntitiesAtPoint(mouseLocation, m_entitiesAtMouse);
+        for (auto& entity: m_entitiesAtMouse)
         {
+            if (entity->tag() != "button")
+                continue;
             auto res = checkPointInsideEntity(mouseLocation, entity);
             if (res.first && res.second)
             {
@@ -75,8 +83,8 @@ void VulkanSceneMenu::sDoAction(const Action &action)
             }
         }
     }
-    else if (action.name() == "MOUSEMOTION")
+    else if (action.name() == ACTION::id::MOUSEMOTION)
     {
-        MATH::Vec2 mouseLocation{action.event().button.x, action.event().button.y};
+        MATH::Vec2 mouseLocation{action.x(), action.y()};
     }
 }
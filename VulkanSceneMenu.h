@@ -3,6 +3,7 @@
 
 #include "Scene.h"
 #include <memory>
+#include <vector>
 
 class VulkanSceneMenu : public Scene
 {
@@ -17,6 +18,7 @@ private:
     std::shared_ptr<Entity> m_newGameButton{nullptr};
     std::shared_ptr<Entity> m_exitGameButton{nullptr};
     int m_windowX, m_windowY;
+    std::vector<std::shared_ptr<Entity>> m_entitiesAtMouse;
 
     void init() override;
     void endScene() override;
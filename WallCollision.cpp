@@ -0,0 +1,152 @@
+#include "WallCollision.h"
+#include "Grid.h"
+#include <algorithm>
+#include <cmath>
+
+uint8_t WallCollision::wallsAt(int x, int y) const
+{
+    if (x < 0 || y < 0)
+        return 0;
+    if (x < m_rowNumber && y < m_columnNumber)
+        return m_walls[x + y * m_rowNumber];
+    // the grid has no east and south walls, the cells outside of the grid close it instead
+    if (x == m_rowNumber && y < m_columnNumber)
+        return Grid::WALL_WEST;
+    if (y == m_columnNumber && x < m_rowNumber)
+        return Grid::WALL_NORTH;
+    return 0;
+}
+
+void WallCollision::cellRange(const COLLISION::aabb& box, int& minX, int& minY, int& maxX, int& maxY) const
+{
+    minX = std::clamp((int)std::floor(box.min.x / m_cellWidth), 0, m_rowNumber);
+    maxX = std::clamp((int)std::floor(box.max.x / m_cellWidth), 0, m_rowNumber);
+    minY = std::clamp((int)std::floor(box.min.y / m_cellHeight), 0, m_columnNumber);
+    maxY = std::clamp((int)std::floor(box.max.y / m_cellHeight), 0, m_columnNumber);
+}
+
+COLLISION::aabb WallCollision::northWall(int x, int y) const
+{
+    // same place as the wall in the wallsVertex mesh: inside the cell, along the top edge
+    return COLLISION::aabb{
+        MATH::Vec2{x * m_cellWidth, y * m_cellHeight},
+        MATH::Vec2{(x + 1) * m_cellWidth, y * m_cellHeight + m_thickness}
+        };
+}
+
+COLLISION::aabb WallCollision::westWall(int x, int y) const
+{
+    return COLLISION::aabb{
+        MATH::Vec2{x * m_cellWidth, y * m_cellHeight},
+        MATH::Vec2{x * m_cellWidth + m_thickness, (y + 1) * m_cellHeight}
+        };
+}
+
+void WallCollision::build(Grid& grid)
+{
+    build(grid.getWallMask(), grid.getRowNumber(), grid.getColumnNumber(), grid.getCellWidth(), grid.getCellHeight());
+}
+
+void WallCollision::build(const std::vector<uint8_t>& walls, int rowNumber, int columnNumber, float cellWidth, float cellHeight)
+{
+    m_walls = walls;
+    m_rowNumber = rowNumber;
+    m_columnNumber = columnNumber;
+    m_cellWidth = cellWidth;
+    m_cellHeight = cellHeight;
+    // the wall mesh is 0.1 wide in the [-1, 1] space of the cell
+    m_thickness = std::min(cellWidth, cellHeight) * 0.05f;
+}
+
+WallCollision::sweepResult WallCollision::sweep(const MATH::Vec2& pos, const MATH::Vec2& halfSize, const MATH::Vec2& delta) const
+{
+    sweepResult res{};
+    if (!isBuilt())
+    {
+        res.delta = delta;
+        return res;
+    }
+
+    MATH::Vec2 current{pos};
+    MATH::Vec2 remaining{delta};
+
+    for (int i = 0; i < m_maxIterations; i++)
+    {
+        if (remaining.x == 0.f && remaining.y == 0.f)
+            break;
+
+        COLLISION::aabb box{COLLISION::makeAABB(current, halfSize)};
+        COLLISION::aabb swept{
+            MATH::Vec2{std::min(box.min.x, box.min.x + remaining.x), std::min(box.min.y, box.min.y + remaining.y)},
+            MATH::Vec2{std::max(box.max.x, box.max.x + remaining.x), std::max(box.max.y, box.max.y + remaining.y)}
+            };
+
+        int minX, minY, maxX, maxY;
+        cellRange(swept, minX, minY, maxX, maxY);
+
+        COLLISION::sweepHit first{};
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = minX; x <= maxX; x++)
+            {
+                uint8_t walls{wallsAt(x, y)};
+                if (walls & Grid::WALL_NORTH)
+                {
+                    COLLISION::sweepHit hit{COLLISION::sweep(box, remaining, northWall(x, y))};
+                    if (hit.hit && hit.time < first.time)
+                        first = hit;
+                }
+                if (walls & Grid::WALL_WEST)
+                {
+                    COLLISION::sweepHit hit{COLLISION::sweep(box, remaining, westWall(x, y))};
+                    if (hit.hit && hit.time < first.time)
+                        first = hit;
+                }
+            }
+        }
+
+        if (!first.hit)
+        {
+            current = current + remaining;
+            break;
+        }
+
+        // move until the contact, step back a bit and slide along the wall with the rest of the movement
+        current = current + remaining * first.time + first.normal * m_skin;
+        remaining = remaining * (1.f - first.time);
+        if (first.normal.x != 0.f)
+        {
+            remaining.x = 0.f;
+            res.blockedX = true;
+        }
+        else
+        {
+            remaining.y = 0.f;
+            res.blockedY = true;
+        }
+    }
+
+    res.delta = current - pos;
+    return res;
+}
+
+bool WallCollision::overlaps(const COLLISION::aabb& box) const
+{
+    if (!isBuilt())
+        return false;
+
+    int minX, minY, maxX, maxY;
+    cellRange(box, minX, minY, maxX, maxY);
+    for (int y = minY; y <= maxY; y++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            uint8_t walls{wallsAt(x, y)};
+            if ((walls & Grid::WALL_NORTH) && COLLISION::overlap(box, northWall(x, y)))
+                return true;
+            if ((walls & Grid::WALL_WEST) && COLLISION::overlap(box, westWall(x, y)))
+                return true;
+        }
+    }
+    return false;
+}
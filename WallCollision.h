@@ -0,0 +1,53 @@
+#ifndef WALLCOLLISION_H
+#define WALLCOLLISION_H
+
+#include <vector>
+#include <cstdint>
+#include "Vector.h"
+#include "Collision.h"
+
+class Grid;
+
+// swept AABB collision against the walls of a maze grid
+// the walls are stored as a bitmask per cell (north, west), the east and south border of the grid are walls too
+// the queries are only visiting the cells around the swept box, there is no allocation during the movement
+class WallCollision
+{
+public:
+    struct sweepResult
+    {
+        MATH::Vec2 delta{0.f, 0.f}; // the movement that can be done without going into a wall
+        bool blockedX{false};
+        bool blockedY{false};
+    };
+
+private:
+    std::vector<uint8_t> m_walls;
+    int m_rowNumber{0}; // cells on the x axis, same naming as in the Grid
+    int m_columnNumber{0}; // cells on the y axis
+    float m_cellWidth{0.f};
+    float m_cellHeight{0.f};
+    float m_thickness{0.f};
+
+    const int m_maxIterations{3}; // one hit and slide per axis plus one for the corners
+    const float m_skin{0.01f}; // stay this far from the walls so floating point errors can not push the box in
+
+    uint8_t wallsAt(int x, int y) const;
+    void cellRange(const COLLISION::aabb& box, int& minX, int& minY, int& maxX, int& maxY) const;
+    COLLISION::aabb northWall(int x, int y) const;
+    COLLISION::aabb westWall(int x, int y) const;
+
+public:
+    WallCollision() {};
+
+    void build(Grid& grid);
+    void build(const std::vector<uint8_t>& walls, int rowNumber, int columnNumber, float cellWidth, float cellHeight);
+    bool isBuilt() const { return !m_walls.empty(); };
+
+    sweepResult sweep(const MATH::Vec2& pos, const MATH::Vec2& halfSize, const MATH::Vec2& delta) const;
+    // true if the box is inside a wall, e.g. to check that nothing went through one
+    bool overlaps(const COLLISION::aabb& box) const;
+
+};
+
+#endif
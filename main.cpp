@@ -1,10 +1,52 @@
 #include "GameEngine.h"
+#include "Benchmarks.h"
+#include "VulkanRenderer.h"
+#include "LatencyTracker.h"
+#include <string>
+#include <cstdlib>
 
 int main(int argc, char* args[])
 {
-    GameEngine ge{};
+    if (argc > 1 && std::string(args[1]) == "--benchmark")
+    {
+        BENCHMARK::run();
+        return 0;
+    }
+
+    // --headless 100000: the maze without a window and a GPU for that many steps, 0 is no limit
+    bool headless{false};
+    uint64_t steps{0};
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(args[i]) == "--headless")
+        {
+            headless = true;
+            if (i + 1 < argc)
+                steps = std::strtoull(args[i + 1], nullptr, 10);
+        }
+    }
+
+    GameEngine ge{headless};
+    ge.setStepLimit(steps);
+    for (int i = 1; i < argc; i++)
+    {
+        // --fps 144, 0 is no limit
+        if (std::string(args[i]) == "--fps" && i + 1 < argc)
+            ge.setTargetFps(std::atof(args[i + 1]));
+        // record and submit the frames on their own thread
+        if (std::string(args[i]) == "--renderthread" && ge.vulkanRenderer())
+            ge.vulkanRenderer()->startRenderThread();
+        // --record session.rply, --replay session.rply
+        if (std::string(args[i]) == "--record" && i + 1 < argc)
+            ge.recordReplay(args[i + 1]);
+        if (std::string(args[i]) == "--replay" && i + 1 < argc)
+            ge.playReplay(args[i + 1]);
+        // --latencycsv latency.csv, one line for every input with the ms until each stage
+        if (std::string(args[i]) == "--latencycsv" && i + 1 < argc)
+            ge.latencyTracker()->openCsv(args[i + 1]);
+    }
 
     ge.run();
 
     return 0;
-}
\ No newline at end of file
+}
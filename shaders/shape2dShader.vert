@@ -4,16 +4,21 @@ layout(location = 0) in vec2 inPosition;
 
 layout(location = 0) out vec3 fragColor;
 
-layout(binding = 0) uniform uboData {
-    vec4 positionAndSize[2048];
-    vec4 color[2048];
-} ubo;
+struct shape2dInstance {
+    vec4 positionAndSize;
+    vec4 color;
+    vec4 uvRect;
+};
+
+layout(std430, binding = 0) readonly buffer instanceData {
+    shape2dInstance instances[];
+};
 
 void main() {
     gl_Position = vec4(
-        ubo.positionAndSize[gl_InstanceIndex].x + inPosition.x * ubo.positionAndSize[gl_InstanceIndex].z,
-        ubo.positionAndSize[gl_InstanceIndex].y + inPosition.y * ubo.positionAndSize[gl_InstanceIndex].w,
+        instances[gl_InstanceIndex].positionAndSize.x + inPosition.x * instances[gl_InstanceIndex].positionAndSize.z,
+        instances[gl_InstanceIndex].positionAndSize.y + inPosition.y * instances[gl_InstanceIndex].positionAndSize.w,
         0.0,
         1.0);
-    fragColor = ubo.color[gl_InstanceIndex].xyz;
+    fragColor = instances[gl_InstanceIndex].color.xyz;
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 fragTexPos;
+layout(location = 1) flat in uint fragTextureIndex;
+
+layout(set = 1, binding = 1) uniform sampler2D texSamplers[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // the instances of one draw can use different textures
+    outColor = texture(texSamplers[nonuniformEXT(fragTextureIndex)], fragTexPos);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 texPos;
+
+layout(location = 0) out vec2 fragTexPos;
+layout(location = 1) flat out uint fragTextureIndex;
+
+struct shape2dInstance {
+    vec4 positionAndSize;
+    vec4 color;
+    vec4 uvRect;
+};
+
+layout(std430, binding = 0) readonly buffer instanceData {
+    shape2dInstance instances[];
+};
+
+void main() {
+    // the atlas textures are only a part of the page
+    fragTexPos = instances[gl_InstanceIndex].uvRect.xy + texPos * instances[gl_InstanceIndex].uvRect.zw;
+    // the textured instances have no color, the first component is the index in the texture array
+    fragTextureIndex = uint(instances[gl_InstanceIndex].color.x);
+    gl_Position = vec4(
+        instances[gl_InstanceIndex].positionAndSize.x + inPosition.x * instances[gl_InstanceIndex].positionAndSize.z,
+        instances[gl_InstanceIndex].positionAndSize.y + inPosition.y * instances[gl_InstanceIndex].positionAndSize.w,
+        0.0,
+        1.0);
+}
\ No newline at end of file
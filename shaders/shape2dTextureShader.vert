@@ -5,16 +5,22 @@ layout(location = 1) in vec2 texPos;
 
 layout(location = 0) out vec2 fragTexPos;
 
-layout(binding = 0) uniform uboData {
-    vec4 positionAndSize[2048];
-    vec4 color[2048];
-} ubo;
+struct shape2dInstance {
+    vec4 positionAndSize;
+    vec4 color;
+    vec4 uvRect;
+};
+
+layout(std430, binding = 0) readonly buffer instanceData {
+    shape2dInstance instances[];
+};
 
 void main() {
-    fragTexPos = texPos;
+    // the atlas textures are only a part of the page
+    fragTexPos = instances[gl_InstanceIndex].uvRect.xy + texPos * instances[gl_InstanceIndex].uvRect.zw;
     gl_Position = vec4(
-        ubo.positionAndSize[gl_InstanceIndex].x + inPosition.x * ubo.positionAndSize[gl_InstanceIndex].z,
-        ubo.positionAndSize[gl_InstanceIndex].y + inPosition.y * ubo.positionAndSize[gl_InstanceIndex].w,
+        instances[gl_InstanceIndex].positionAndSize.x + inPosition.x * instances[gl_InstanceIndex].positionAndSize.z,
+        instances[gl_InstanceIndex].positionAndSize.y + inPosition.y * instances[gl_InstanceIndex].positionAndSize.w,
         0.0,
         1.0);
 }
\ No newline at end of file